@@ -1,5 +1,8 @@
 OS="Ubuntu" #"Mac"
-if [ $OS = "Mac" ]; then
+# GLSLC overrides the SDK path, it is also the default compiler of --watch-shaders
+if [ -n "$GLSLC" ]; then
+    COMPILER="$GLSLC"
+elif [ $OS = "Mac" ]; then
     COMPILER="/Users/toyotariku/VulkanSDK/1.2.198.1/macOS/bin/glslc"
 else
     COMPILER="/home/honolulu/programs/downloaded-libraries/vulkan1.3.204.0/x86_64/bin/glslc"
@@ -8,4 +11,7 @@ SHADERDIR="./src/shader"
 mkdir -p spv
 OUTPUTDIR="./spv"
 $COMPILER $SHADERDIR/shader.vert -o $OUTPUTDIR/vert.spv
-$COMPILER $SHADERDIR/shader.frag -o $OUTPUTDIR/frag.spv
\ No newline at end of file
+# fallback of the devices whose push constants cannot hold the per-draw data
+$COMPILER -DDRAW_DATA_UNIFORM $SHADERDIR/shader.vert -o $OUTPUTDIR/vert_draw_uniform.spv
+$COMPILER $SHADERDIR/shader.frag -o $OUTPUTDIR/frag.spv
+$COMPILER $SHADERDIR/cull.comp -o $OUTPUTDIR/cull.spv
\ No newline at end of file
@@ -4,6 +4,11 @@
 #include <GLFW/glfw3.h>
 #include <memory>
 #include <functional>
+#include <string>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <mutex>
 #include <VkDebugger.hpp>
 #include <VkDeviceManager.hpp>
 #include <VKSwapChainManager.hpp>
@@ -13,6 +18,19 @@
 #include <VkCommandManager.hpp>
 #include <VkRenderer.hpp>
 #include <VkVertexManager.hpp>
+#include <VkMemoryAllocator.hpp>
+#include <VkPipelineCacheManager.hpp>
+#include <VkLayoutCacheManager.hpp>
+#include <VkDescriptorAllocator.hpp>
+#include <VkUploadManager.hpp>
+#include <VkRetireQueue.hpp>
+#include <VkPresentProfile.hpp>
+#include <VkCullingManager.hpp>
+#include <VkUniformManager.hpp>
+#include <ThreadPool.hpp>
+#include <ShaderWatcher.hpp>
+#include <VkProfiler.hpp>
+#include <Benchmark.hpp>
 
 class Application
 {
@@ -25,15 +43,24 @@ class Application
         SURFACE,
         PHYSICAL_DEVICE,
         LOGICAL_DEVICE,
+        MEMORY_ALLOCATOR,
+        PIPELINE_CACHE,
+        LAYOUT_CACHE,
+        DESCRIPTOR_ALLOCATOR,
+        UPLOAD_MANAGER,
         SWAP_CHAIN,
         IMAGE_VIEWS,
         RENDER_PASS,
         VERTEX_FACTORY,
         GRAPHICS_PIPELINE,
+        UNIFORM_BUFFER,
+        DEPTH_BUFFER,
         FRAME_BUFFERS,
         COMMAND_POOL,
         VERTEX_BUFFER,
+        CULLING,
         COMMAND_BUFFER,
+        PROFILER,
         RENDERER
     };
     struct VkStageFunc
@@ -43,48 +70,226 @@ class Application
         VkStageFunc(VkStage stage, std::function<void(void)>func)
             :stage_m(stage), func_m(func) {}
     };
+    // edges of the stage graph, a stage is created after these and destroyed before them
+    struct VkStageNode
+    {
+        // the stage is built from their objects, so it is recreated whenever one of them is
+        std::vector<VkStage> dependencies_m;
+        // only read at creation, what is read survives their recreation or is refreshed separately
+        std::vector<VkStage> reads_m;
+        // glfw restricts some of its functions to the main thread
+        bool mainThread_m = false;
+    };
+    // matches the Camera block of shader.vert
+    struct CameraUniforms
+    {
+        glm::mat4 viewProjection_m;
+    };
+    // matches the DrawData block of shader.vert
+    struct DrawData
+    {
+        // applied on top of the model matrices of the instances
+        glm::mat4 transform_m;
+        glm::vec4 tint_m;
+    };
     //struct VkDestroyFunc;
 public:
-    Application();
+    // options given from the command line
+    struct Settings
+    {
+        // render into offscreen images without a window, a surface and a swap chain
+        bool headless_m = false;
+        // headless mode has no window to close, so it renders a fixed number of frames
+        uint32_t frameCount_m = 1000;
+        // frames rendered before the measurement starts in headless mode
+        uint32_t warmupFrameCount_m = 0;
+        // headless results are compared with this file, empty disables the check
+        std::string baselinePath_m;
+        // allowed relative regression against the baseline
+        double regressionThreshold_m = 0.10;
+        // headless results are written here, empty disables it
+        std::string benchOutputPath_m;
+        // size of the device memory blocks which resources are sub-allocated from
+        VkDeviceSize memoryBlockSize_m = VkMemoryAllocator::DEFAULT_BLOCK_SIZE;
+        // file the pipeline cache is loaded from and saved to, empty disables it
+        std::string pipelineCachePath_m = "pipeline_cache.bin";
+        // size of the staging ring and bytes uploaded per frame at most
+        VkDeviceSize stagingRingSize_m = VkUploadManager::DEFAULT_RING_SIZE;
+        VkDeviceSize uploadBudget_m = VkUploadManager::DEFAULT_FRAME_BUDGET;
+        // threads recording secondary command buffers
+        uint32_t recordThreadCount_m = 1;
+        // the instances are split across this many draw calls to give the threads something to record
+        uint32_t drawCount_m = 1;
+        // mesh file written by tools/obj2mesh, empty draws the built-in triangle
+        std::string meshPath_m;
+        // encode float vertices into 16-bit positions and 8-bit colors on load
+        bool quantizeVertices_m = false;
+        // copies of the mesh laid out in a grid, each with its own transform and color
+        uint32_t instanceCount_m = 1;
+        // cull the instances with a compute shader and draw the visible ones with indirect draws
+        // the shader appends the visible ones in no particular order, so the draws are not depth sorted
+        bool gpuCulling_m = false;
+        // blend mode of the pipeline variant drawn at start, it can be switched at runtime with B
+        // opaque draws are sorted front to back for the early depth test, the default so benchmarks measure it
+        VkGraphicsPipelineFactory::BlendMode blendMode_m = VkGraphicsPipelineFactory::BlendMode::OPAQUE;
+        // recompile the shaders when their sources change and swap the pipelines in without a restart
+        bool watchShaders_m = false;
+        // glslc used by the shader watcher
+        std::string shaderCompilerPath_m = "glslc";
+        // per frame CPU and GPU times are written here on exit, empty disables it
+        std::string profileCsvPath_m;
+        // index into VkPresentProfile::getProfiles(), it can be switched at runtime with the number keys
+        size_t presentProfile_m = 0;
+    };
+    Application(const Settings& settings);
     void run();
 private:
     // functions
     void initWindow();
     void initVulkan();
     // for initializing vulkan
+    void initStageGraph();
     void initCreateFunctions();
     void initDestroyFunctions();
-    void execFunctionsSequence
-        (const std::vector<VkStageFunc>& targetFuncs, const std::vector<VkStage>& stages = {});
+    // create stages, all of them when empty, each one once the stages it needs are created
+    // the independent ones run in parallel on threadPool, one after the other without it
+    void createStages(const std::vector<VkStage>& stages = {}, ThreadPool* threadPool = nullptr);
+    // destroy stages, all of them when empty, each one before the stages it needs
+    // the stages which can be replaced while frames are in flight are retired instead when retire is set
+    void destroyStages(const std::vector<VkStage>& stages = {}, bool retire = false);
+    static const VkStageFunc* findStageFunc(const std::vector<VkStageFunc>& targetFuncs, VkStage stage);
+    // stages in creation order, every stage which has a create function when empty
+    std::vector<VkStage> sortStages(const std::vector<VkStage>& stages) const;
+    // the stages and every stage built from them, directly or not
+    std::vector<VkStage> getDependentStages(const std::vector<VkStage>& stages) const;
     void mainLoop();
+    // record and submit a frame, false if the swap chain has to be recreated
+    bool drawFrame();
+    void createDrawCalls();
+    // place settings_m.instanceCount_m instances in a grid covering the viewport
+    void createInstances();
+    // rotate every instance around its center
+    void updateInstances();
+    // write the instances for the current frame, in the order of instanceOrder_m
+    void writeInstances();
+    // keep the aspect ratio of the scene whatever the size of the swap chain is
+    glm::mat4 computeViewProjection() const;
+    // order the instances of each draw call, then the draw calls and their data, front to back,
+    // so the opaque ones hide each other in the early depth test instead of shading every layer
+    void sortDrawCalls(const glm::mat4& viewProjection);
+    // watch src/shader and rebuild the pipelines of the changed shaders in the background
+    void startShaderWatcher();
+    // on the watcher thread, outputs are the SPIR-V files which have been rewritten
+    void rebuildPipelines(const std::vector<std::string>& outputs);
+    // between frames, use the pipelines rebuilt since the last frame
+    void swapReloadedPipelines();
+    // render the warm-up frames and settings_m.frameCount_m measured frames,
+    // report the results and compare them with the baseline
+    void runHeadlessFrames();
     void cleanup();
     void checkingForExtensionSupport();
     bool checkValidationLayerSupport();
     void createInstance();
+    // replace the swap chain without waiting for the device to be idle
     void recreateSwapChain();
     // handle framebuffer resizes
     static void framebufferResizeCallback(GLFWwindow* window, int width, int height);
+    // number keys select a present profile
+    static void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
+    // change the frames in flight and recreate the swap chain with the present mode of the profile
+    void switchPresentProfile(size_t profileIndex);
+    // throughput and latency measured with each profile that has been used
+    void printPresentStatistics() const;
     // message callback
     std::vector<const char*> getRequiredExtensions();
     // up's communication
     const VkDeviceManager& getDeviceManagerRef() const;
     const VkSwapChainManager& getSwapChainManagerRef() const;
     // variables
-    GLFWwindow* window_m;
+    Settings settings_m;
+    GLFWwindow* window_m = nullptr;
+    // workers recording command buffers
+    ThreadPool threadPool_m;
     VkInstance instance_m;
     std::vector<const char*> validationLayers_m;
     bool enableValidationLayers_m;
+    // what each stage needs, stages missing from it need nothing
+    std::map<VkStage, VkStageNode> stageGraph_m;
     // createXX functions
     std::vector<VkStageFunc> createFunctions_m;
     // destroyXX functions
     std::vector<VkStageFunc> destroyFunctions_m;
+    // hand the objects of a stage over to retireQueue_m instead of destroying them
+    std::vector<VkStageFunc> retireFunctions_m;
     // original debugger
     VkDebugger debugger_m;
     VkDeviceManager deviceManager_m;
+    VkMemoryAllocator memoryAllocator_m;
+    VkPipelineCacheManager pipelineCacheManager_m;
+    // pipeline and descriptor set layouts shared by the pipelines
+    VkLayoutCacheManager layoutCacheManager_m;
+    // descriptor sets of every manager, written through the set layouts of the layout cache
+    VkDescriptorAllocator descriptorAllocator_m;
+    VkUploadManager uploadManager_m;
     VkSwapChainManager swapChainManager_m;
     VkGraphicsPipelineFactory graphicsPipeline_m;
+    // selected with the keyboard, compiled on first use unless declared at creation
+    VkGraphicsPipelineFactory::PipelineVariant pipelineVariant_m;
     VkFramebufferFactory framebufferFactory_m;
     VkCommandManager commandManager_m;
     VkRenderer renderer_m;
     VkVertexManager vertexManager_m;
+    VkProfiler profiler_m;
+    VkCullingManager cullingManager_m;
+    // per-frame uniforms of the graphics pipelines
+    VkUniformManager uniformManager_m;
+    // per-draw data which does not fit in the push constants, only created then
+    VkUniformManager drawUniformManager_m;
+    bool drawDataInUniform_m = false;
+    // swap chain resources and pipelines replaced while frames were still in flight
+    VkRetireQueue retireQueue_m;
+    ShaderWatcher shaderWatcher_m;
+    // held while pipelines are built, by the watcher thread or a render pass recreation
+    std::mutex pipelineBuildMutex_m;
+    // guards the rebuilt pipelines waiting for the next frame, never held while building
+    std::mutex reloadMutex_m;
+    // empty when no rebuilt graphics pipeline is waiting
+    VkGraphicsPipelineFactory::PipelineSet reloadedGraphicsPipelines_m;
+    VkPipeline reloadedComputePipeline_m = VK_NULL_HANDLE;
+    // a resize or a suboptimal swap chain is waiting for the size to settle
+    bool resizePending_m = false;
+    std::chrono::steady_clock::time_point lastResizeTime_m;
+    // time from run() until the first frame can be drawn
+    double startupMs_m = 0.0;
+    // false when the headless results regressed against the baseline
+    bool benchmarkPassed_m = true;
+    // what has been measured while a present profile was in use
+    struct PresentStatistics
+    {
+        uint64_t frameCount_m = 0;
+        double elapsedSec_m = 0.0;
+        // last VkProfiler::ROLLING_WINDOW frames
+        std::deque<double> latencyMs_m;
+    };
+    size_t presentProfile_m = 0;
+    // set by the key callback, applied between frames
+    size_t requestedPresentProfile_m = 0;
+    // indexed by profile
+    std::vector<PresentStatistics> presentStatistics_m;
+    std::chrono::steady_clock::time_point presentProfileStartTime_m;
+    // draw list recorded every frame
+    std::vector<VkCommandManager::DrawCall> drawCalls_m;
+    // one per draw call
+    std::vector<DrawData> drawData_m;
+    // per-instance data, animated every frame
+    std::vector<VkVertexManager::Instance> instances_m;
+    // instance written to each slot of the instance buffer, the draw calls take ranges of slots
+    std::vector<uint32_t> instanceOrder_m;
+    // instances_m in the order of instanceOrder_m, written to the instance buffer every frame
+    std::vector<VkVertexManager::Instance> orderedInstances_m;
+    // grid cell and depth of each instance, the rotation is applied on top of it
+    std::vector<glm::vec3> instanceCenters_m;
+    float instanceScale_m = 1.0f;
+    // frames drawn, drives the animation so that headless runs are reproducible
+    uint64_t animationFrame_m = 0;
 };
\ No newline at end of file
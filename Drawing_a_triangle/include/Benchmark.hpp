@@ -0,0 +1,33 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+
+// results of a headless run and the comparison with a baseline file
+// the file has one "name value" pair per line, lines starting with '#' are comments
+class Benchmark
+{
+public:
+    void setStartupTime(double startupMs);
+    // frameTimesMs : time of every measured frame
+    void setFrameTimes(const std::vector<double>& frameTimesMs, double elapsedSeconds);
+    // read the peak resident set size of the process
+    void measurePeakMemory();
+    void printResults() const;
+    void writeResults(const std::string& path) const;
+    // false if a metric is worse than the baseline by more than threshold (0.1 = 10%)
+    // metrics missing from the baseline are only reported
+    bool compareWithBaseline(const std::string& path, double threshold) const;
+private:
+    struct Metric
+    {
+        double value_m;
+        // frames per second is better when higher, times and memory when lower
+        bool higherIsBetter_m;
+    };
+    void setMetric(const std::string& name, double value, bool higherIsBetter);
+    static std::map<std::string, double> readBaseline(const std::string& path);
+    // kept in insertion order for printing
+    std::vector<std::string> names_m;
+    std::map<std::string, Metric> metrics_m;
+};
@@ -0,0 +1,11 @@
+#pragma once
+#include <vector>
+#include <string>
+
+// file helpers shared by the modules loading SPIR-V
+class FileUtils
+{
+public:
+    // whole content of a binary file, throw if it cannot be opened
+    static std::vector<char> readFile(const std::string& filename);
+};
@@ -0,0 +1,74 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// binary mesh container, read through a read only memory mapping
+// layout : Header, attributeCount Attribute, then the vertex and the index blobs,
+// each starting at a multiple of ALIGNMENT from the beginning of the file
+// the blobs are stored exactly as the GPU reads them, so they are copied from the page cache
+// into the staging ring without being parsed
+class MeshFile
+{
+public:
+    struct Header
+    {
+        char magic_m[4];
+        uint32_t version_m;
+        uint32_t vertexStride_m;
+        uint32_t attributeCount_m;
+        uint64_t vertexCount_m;
+        uint64_t indexCount_m;
+        // bytes per index, 2 or 4
+        uint32_t indexSize_m;
+        uint32_t reserved_m;
+        // from the beginning of the file
+        uint64_t vertexOffset_m;
+        uint64_t indexOffset_m;
+        // space of the stored positions, xyz center and w radius
+        float boundingSphere_m[4];
+        // model space position = stored position * positionScale_m + positionOffset_m
+        // 1 and 0 unless the positions are quantized
+        float positionScale_m;
+        float positionOffset_m[3];
+    };
+    // one vertex input attribute
+    struct Attribute
+    {
+        uint32_t location_m;
+        // VkFormat value
+        uint32_t format_m;
+        // from the beginning of the vertex
+        uint32_t offset_m;
+        uint32_t reserved_m;
+    };
+    MeshFile() = default;
+    MeshFile(const MeshFile&) = delete;
+    MeshFile& operator=(const MeshFile&) = delete;
+    ~MeshFile();
+    // map the file and validate the header and the indices, throw when it is not a mesh file
+    void open(const std::string& path);
+    // the blobs are invalid afterwards
+    void close();
+    bool isOpen() const;
+    const Header& getHeader() const;
+    const Attribute* getAttributes() const;
+    const void* getVertexData() const;
+    size_t getVertexDataSize() const;
+    const void* getIndexData() const;
+    size_t getIndexDataSize() const;
+    // write a mesh file, used by the offline converter
+    static void write(const std::string& path, uint32_t vertexStride, const std::vector<Attribute>& attributes,
+        const void* vertices, uint64_t vertexCount, const void* indices, uint64_t indexCount, uint32_t indexSize,
+        const float boundingSphere[4], float positionScale = 1.0f, const float positionOffset[3] = nullptr);
+
+    static constexpr char MAGIC[4] = {'V', 'M', 'S', 'H'};
+    static constexpr uint32_t VERSION = 2;
+    static constexpr uint64_t ALIGNMENT = 64;
+private:
+    // largest index of the index blob, 0 without indices
+    uint64_t findMaxIndex() const;
+    void* mapping_m = nullptr;
+    size_t mappingSize_m = 0;
+};
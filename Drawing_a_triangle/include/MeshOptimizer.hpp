@@ -0,0 +1,28 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// index buffer generation and reordering for triangle lists
+// vertices are handled as opaque byte blocks, so any vertex layout works
+class MeshOptimizer
+{
+public:
+    // remap[i] : new index of vertex i, bitwise identical vertices share one index
+    // returns the number of unique vertices
+    static size_t generateVertexRemap(const void* vertices, size_t vertexCount, size_t vertexSize,
+        std::vector<uint32_t>& remap);
+    // dst[remap[i]] = src[i], dst holds as many vertices as remap has distinct values
+    static void remapVertices(void* dst, const void* src, size_t vertexCount, size_t vertexSize,
+        const std::vector<uint32_t>& remap);
+    // reorder the triangles so that vertices are reused while they are still in the post-transform cache
+    // Tom Forsyth's linear-speed vertex cache optimization
+    static void optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount);
+    // number the vertices in the order the indices first use them, so vertex fetch reads memory linearly
+    // indices are rewritten, unused vertices are dropped, returns the number of used vertices
+    static size_t generateVertexFetchRemap(std::vector<uint32_t>& indices, size_t vertexCount,
+        std::vector<uint32_t>& remap);
+    // average cache miss ratio : transformed vertices per triangle with a FIFO cache of cacheSize entries
+    // 3.0 without any reuse, 0.5 is the best a regular grid can do
+    static double computeAcmr(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize = 16);
+};
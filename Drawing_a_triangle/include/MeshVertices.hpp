@@ -0,0 +1,104 @@
+#pragma once
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include <array>
+#include <cstdint>
+#include <MeshFile.hpp>
+#include <VertexQuantizer.hpp>
+#include <VertexLayout.hpp>
+
+// vertex formats of the meshes and the processing which produces them
+// shared by VkVertexManager and tools/obj2mesh, so a mesh file is always written with the layout
+// and the encoding the renderer reads
+struct MeshVertex
+{
+    glm::vec2 position_m;
+    glm::vec3 color_m;
+};
+
+// the shader reads the same inputs as with MeshVertex, the formats convert them to floats
+struct QuantizedMeshVertex
+{
+    // R16G16_SNORM, relative to the bounds of the mesh, see VertexQuantizer::Dequantization
+    int16_t position_m[2];
+    // R8G8B8A8_UNORM, alpha is ignored by the shader
+    uint8_t color_m[4];
+};
+
+template <>
+struct VertexLayout<MeshVertex>
+{
+    static constexpr VkVertexInputRate INPUT_RATE = VK_VERTEX_INPUT_RATE_VERTEX;
+    static constexpr std::array<VertexMember, 2> MEMBERS =
+    {
+        VERTEX_MEMBER(MeshVertex, position_m),
+        VERTEX_MEMBER(MeshVertex, color_m)
+    };
+};
+
+// normalized formats are converted to floats in [-1, 1] and [0, 1] by the vertex fetch
+template <>
+struct VertexLayout<QuantizedMeshVertex>
+{
+    static constexpr VkVertexInputRate INPUT_RATE = VK_VERTEX_INPUT_RATE_VERTEX;
+    static constexpr std::array<VertexMember, 2> MEMBERS =
+    {
+        VERTEX_MEMBER_AS(QuantizedMeshVertex, position_m, VK_FORMAT_R16G16_SNORM),
+        // the shader input is a vec3, the fourth component is dropped
+        VERTEX_MEMBER_AS(QuantizedMeshVertex, color_m, VK_FORMAT_R8G8B8A8_UNORM)
+    };
+};
+
+class MeshVertices
+{
+public:
+    // average cache miss ratios of optimize, see MeshOptimizer::computeAcmr
+    struct OptimizeStatistics
+    {
+        size_t inputVertexCount_m = 0;
+        double acmrBefore_m = 0.0;
+        double acmrAfter_m = 0.0;
+    };
+    // replace the unindexed triangle list in vertices by unique vertices and indices
+    // ordered for the post-transform cache and then for vertex fetch
+    static OptimizeStatistics optimize(std::vector<MeshVertex>& vertices, std::vector<uint32_t>& indices);
+    // center of the bounding box, close enough to the smallest sphere for culling
+    // xyz center and w radius
+    static glm::vec4 computeBoundingSphere(const std::vector<MeshVertex>& vertices);
+    // encode vertexCount vertices into quantizedVertices, return how to get their positions back
+    static VertexQuantizer::Dequantization quantize(const MeshVertex* vertices, size_t vertexCount,
+        std::vector<QuantizedMeshVertex>& quantizedVertices);
+    // sphere around float positions moved to the space of their quantized positions
+    static glm::vec4 quantizeBoundingSphere(const glm::vec4& boundingSphere,
+        const VertexQuantizer::Dequantization& dequantization);
+    // attributes of a mesh file storing Vertex, generated from its VertexLayout
+    template <class Vertex>
+    static std::vector<MeshFile::Attribute> getFileAttributes()
+    {
+        constexpr auto attributeDescriptions = VertexInput<Vertex>::getAttributeDescriptions();
+        std::vector<MeshFile::Attribute> attributes;
+        for (const auto& attributeDescription : attributeDescriptions)
+            // location, format, offset
+            attributes.push_back(MeshFile::Attribute{attributeDescription.location,
+                static_cast<uint32_t>(attributeDescription.format), attributeDescription.offset, 0});
+        return attributes;
+    }
+    // the vertices of meshFile are stored as Vertex
+    template <class Vertex>
+    static bool matchesFileAttributes(const MeshFile& meshFile)
+    {
+        auto attributes = getFileAttributes<Vertex>();
+        const auto& header = meshFile.getHeader();
+        if (header.vertexStride_m != sizeof(Vertex) || header.attributeCount_m != attributes.size())
+            return false;
+        for (size_t i = 0; i < attributes.size(); i++) {
+            const auto& attribute = meshFile.getAttributes()[i];
+            if (attribute.location_m != attributes[i].location_m || attribute.format_m != attributes[i].format_m
+                || attribute.offset_m != attributes[i].offset_m)
+                return false;
+        }
+        return true;
+    }
+};
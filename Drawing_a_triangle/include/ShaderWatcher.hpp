@@ -0,0 +1,54 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+#include <filesystem>
+
+// recompile GLSL sources into SPIR-V when they change, on a background thread
+// the output is written next to its final path and renamed over it, so a reader
+// never sees a partially written file and a failed compilation keeps the previous one
+class ShaderWatcher
+{
+public:
+    struct Shader
+    {
+        std::string sourcePath_m;
+        std::string outputPath_m;
+        // given to the compiler before the source, like -D definitions
+        std::string options_m;
+    };
+    ShaderWatcher() = default;
+    ShaderWatcher(const ShaderWatcher&) = delete;
+    ShaderWatcher& operator=(const ShaderWatcher&) = delete;
+    ~ShaderWatcher();
+    // poll the sources every interval and compile the changed ones with compilerPath (glslc)
+    // onCompiled receives the outputs rewritten by one poll, it runs on the watcher thread
+    void start(const std::vector<Shader>& shaders, const std::string& compilerPath,
+        std::function<void(const std::vector<std::string>&)> onCompiled,
+        std::chrono::milliseconds interval = DEFAULT_POLL_INTERVAL);
+    // wait for the compilation and the callback in progress
+    void stop();
+    bool isRunning() const;
+
+    static constexpr std::chrono::milliseconds DEFAULT_POLL_INTERVAL{250};
+private:
+    void watchLoop();
+    bool compile(const Shader& shader) const;
+    static std::filesystem::file_time_type getWriteTime(const std::string& path);
+
+    std::vector<Shader> shaders_m;
+    // last seen modification time of each source
+    std::vector<std::filesystem::file_time_type> writeTimes_m;
+    std::string compilerPath_m;
+    std::function<void(const std::vector<std::string>&)> onCompiled_m;
+    std::chrono::milliseconds interval_m = DEFAULT_POLL_INTERVAL;
+    std::thread thread_m;
+    std::mutex mutex_m;
+    // wakes the thread up early when stopping
+    std::condition_variable stopRequested_m;
+    bool stopping_m = false;
+};
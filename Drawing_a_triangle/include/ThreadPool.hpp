@@ -0,0 +1,36 @@
+#pragma once
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+
+// fixed number of worker threads consuming a queue of tasks
+class ThreadPool
+{
+public:
+    explicit ThreadPool(uint32_t threadCount);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    void submit(std::function<void(void)> task);
+    // block until every submitted task has finished
+    // rethrow the first exception thrown by a task
+    void wait();
+    uint32_t getThreadCount() const;
+private:
+    void workerLoop();
+    std::vector<std::thread> workers_m;
+    std::queue<std::function<void(void)>> tasks_m;
+    std::mutex mutex_m;
+    // a task was queued or the pool is stopping
+    std::condition_variable taskAvailable_m;
+    // every task has finished
+    std::condition_variable tasksFinished_m;
+    // queued and running tasks
+    size_t pendingCount_m = 0;
+    std::exception_ptr exception_m;
+    bool stopping_m = false;
+};
@@ -2,16 +2,28 @@
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 #include <vector>
+#include <VkMemoryAllocator.hpp>
+#include <VkRetireQueue.hpp>
+#include <VkPresentProfile.hpp>
 
 class VkSwapChainManager
 {
 public: 
-    VkSwapChainManager(const class VkDeviceManager& dm, GLFWwindow* wdw)
-        : deviceManagerRef_m(const_cast<VkDeviceManager&>(dm)), windowRef_m(wdw){}
+    // keep a reference to the window handle, because it is created after this manager
+    VkSwapChainManager(const class VkDeviceManager& dm, GLFWwindow*& wdw, VkMemoryAllocator& allocator)
+        : deviceManagerRef_m(const_cast<VkDeviceManager&>(dm)), windowRef_m(wdw), memoryAllocatorRef_m(allocator){}
+    // the current swap chain, if any, is passed as oldSwapchain and must have been retired
     void createSwapChain(const uint32_t width, const uint32_t height);
     void createImageViews();
     void destroyImageViews();
     void destroySwapChain();
+    // hand the image views and the swap chain over to retireQueue, they are destroyed
+    // once the frames of fences have finished, the next createSwapChain replaces them
+    void retireSwapChain(VkRetireQueue& retireQueue, const std::vector<VkFence>& fences);
+    // used by the next createSwapChain to choose the present mode and the image count
+    void setPresentProfile(const VkPresentProfile& profile);
+    // the image format the next createSwapChain will use
+    VkFormat chooseImageFormat();
 
     // getter
     const VkExtent2D& getSwapChainExtentRef() const;
@@ -19,7 +31,14 @@ public:
     const std::vector<VkImageView>& getSwapChainImageViewsRef() const;
     const VkSwapchainKHR& getSwapChainRef() const;
     const size_t getSwapChainImagesNum() const;
+    // layout which the render pass should leave the images in
+    VkImageLayout getImageFinalLayout() const;
+    VkPresentModeKHR getPresentMode() const;
 private:
+    // headless mode renders into offscreen images instead of a swap chain
+    void createOffscreenImages(const uint32_t width, const uint32_t height);
+    void destroyOffscreenImages();
+    VkFormat chooseOffscreenImageFormat();
     // choosing the right settings for the swap chain
     VkSurfaceFormatKHR chooseSwapSurfaceFormat(const
         std::vector<VkSurfaceFormatKHR>& availableFormats);
@@ -30,11 +49,16 @@ private:
     VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities);
 
     class VkDeviceManager& deviceManagerRef_m;
-    GLFWwindow* windowRef_m;
-    VkSwapchainKHR swapChain_m;
+    GLFWwindow*& windowRef_m;
+    VkMemoryAllocator& memoryAllocatorRef_m;
+    VkSwapchainKHR swapChain_m = VK_NULL_HANDLE;
     // handles of VkImages in a swap chain
     std::vector<VkImage> swapChainImages_m;
     VkFormat swapChainImageFormat_m;
     VkExtent2D swapChainExtent_m;
+    VkPresentModeKHR presentMode_m = VK_PRESENT_MODE_FIFO_KHR;
+    VkPresentProfile presentProfile_m = VkPresentProfile::getProfiles().front();
     std::vector<VkImageView> swapChainImageViews_m;
+    // memory backing the offscreen images (headless mode only)
+    std::vector<VkMemoryAllocator::Allocation> offscreenImageAllocations_m;
 };
\ No newline at end of file
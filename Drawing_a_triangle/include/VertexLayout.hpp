@@ -0,0 +1,160 @@
+#pragma once
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// compile time description of vertex streams
+// a vertex type lists its members once in a VertexLayout specialization, and the binding and
+// attribute descriptions of any combination of streams are generated from it as constants :
+//
+//     template <>
+//     struct VertexLayout<MyVertex>
+//     {
+//         static constexpr VkVertexInputRate INPUT_RATE = VK_VERTEX_INPUT_RATE_VERTEX;
+//         static constexpr std::array<VertexMember, 2> MEMBERS =
+//         {
+//             VERTEX_MEMBER(MyVertex, position_m),
+//             VERTEX_MEMBER_AS(MyVertex, color_m, VK_FORMAT_R8G8B8A8_UNORM)
+//         };
+//     };
+//     constexpr auto attributes = VertexInput<MyVertex, MyInstance>::getAttributeDescriptions();
+//
+// stream i is read from binding i, and the locations are numbered in member order across the streams
+
+// format of a member type, only the types used by the vertex structs are mapped
+template <class T>
+struct VertexMemberFormat;
+template <>
+struct VertexMemberFormat<float>
+    { static constexpr VkFormat FORMAT = VK_FORMAT_R32_SFLOAT; static constexpr uint32_t LOCATIONS = 1; };
+template <>
+struct VertexMemberFormat<glm::vec2>
+    { static constexpr VkFormat FORMAT = VK_FORMAT_R32G32_SFLOAT; static constexpr uint32_t LOCATIONS = 1; };
+template <>
+struct VertexMemberFormat<glm::vec3>
+    { static constexpr VkFormat FORMAT = VK_FORMAT_R32G32B32_SFLOAT; static constexpr uint32_t LOCATIONS = 1; };
+template <>
+struct VertexMemberFormat<glm::vec4>
+    { static constexpr VkFormat FORMAT = VK_FORMAT_R32G32B32A32_SFLOAT; static constexpr uint32_t LOCATIONS = 1; };
+// a matrix takes one location per column
+template <>
+struct VertexMemberFormat<glm::mat4>
+    { static constexpr VkFormat FORMAT = VK_FORMAT_R32G32B32A32_SFLOAT; static constexpr uint32_t LOCATIONS = 4; };
+
+// bytes of one element of format, 0 for the formats no vertex struct uses
+constexpr uint32_t getVertexFormatSize(VkFormat format)
+{
+    switch (format) {
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SNORM:
+    case VK_FORMAT_R16G16_SNORM:
+    case VK_FORMAT_R16G16_UNORM:
+    case VK_FORMAT_R16G16_SFLOAT:
+    case VK_FORMAT_R32_SFLOAT:
+    case VK_FORMAT_R32_UINT:
+        return 4;
+    case VK_FORMAT_R16G16B16A16_SNORM:
+    case VK_FORMAT_R16G16B16A16_SFLOAT:
+    case VK_FORMAT_R32G32_SFLOAT:
+        return 8;
+    case VK_FORMAT_R32G32B32_SFLOAT:
+        return 12;
+    case VK_FORMAT_R32G32B32A32_SFLOAT:
+        return 16;
+    default:
+        return 0;
+    }
+}
+
+struct VertexMember
+{
+    uint32_t offset_m;
+    uint32_t size_m;
+    VkFormat format_m;
+    uint32_t locationCount_m;
+};
+
+constexpr VertexMember makeVertexMember(size_t offset, size_t size, VkFormat format, uint32_t locationCount)
+{
+    return VertexMember{static_cast<uint32_t>(offset), static_cast<uint32_t>(size), format, locationCount};
+}
+
+// the format follows from the type of the member
+#define VERTEX_MEMBER(Type, member) makeVertexMember(offsetof(Type, member), sizeof(Type::member), \
+    VertexMemberFormat<decltype(Type::member)>::FORMAT, VertexMemberFormat<decltype(Type::member)>::LOCATIONS)
+// packed members, like normalized integers, give their format
+#define VERTEX_MEMBER_AS(Type, member, format) makeVertexMember(offsetof(Type, member), sizeof(Type::member), \
+    format, 1)
+
+// specialized for every vertex type, see the top of this file
+template <class Vertex>
+struct VertexLayout;
+
+// number of locations read from a stream
+template <class Stream>
+constexpr uint32_t getVertexLocationCount()
+{
+    uint32_t locationCount = 0;
+    for (const auto& member : VertexLayout<Stream>::MEMBERS)
+        locationCount += member.locationCount_m;
+    return locationCount;
+}
+
+// every member of a stream has a known format which covers exactly its bytes
+template <class Stream>
+constexpr bool isValidVertexLayout()
+{
+    for (const auto& member : VertexLayout<Stream>::MEMBERS) {
+        auto formatSize = getVertexFormatSize(member.format_m);
+        if (formatSize == 0 || formatSize * member.locationCount_m != member.size_m
+            || member.offset_m + member.size_m > sizeof(Stream))
+            return false;
+    }
+    return true;
+}
+
+template <class... Streams>
+class VertexInput
+{
+    static_assert((isValidVertexLayout<Streams>() && ...), "a vertex member does not match its format");
+public:
+    static constexpr uint32_t BINDING_COUNT = sizeof...(Streams);
+    static constexpr uint32_t ATTRIBUTE_COUNT = (getVertexLocationCount<Streams>() + ...);
+
+    static constexpr std::array<VkVertexInputBindingDescription, BINDING_COUNT> getBindingDescriptions()
+    {
+        std::array<VkVertexInputBindingDescription, BINDING_COUNT> bindingDescriptions{};
+        uint32_t binding = 0;
+        // binding, stride, inputRate
+        ((bindingDescriptions[binding] = VkVertexInputBindingDescription{binding,
+            static_cast<uint32_t>(sizeof(Streams)), VertexLayout<Streams>::INPUT_RATE}, binding++), ...);
+        return bindingDescriptions;
+    }
+
+    static constexpr std::array<VkVertexInputAttributeDescription, ATTRIBUTE_COUNT> getAttributeDescriptions()
+    {
+        std::array<VkVertexInputAttributeDescription, ATTRIBUTE_COUNT> attributeDescriptions{};
+        uint32_t binding = 0;
+        uint32_t location = 0;
+        size_t index = 0;
+        (addAttributeDescriptions<Streams>(attributeDescriptions, binding++, location, index), ...);
+        return attributeDescriptions;
+    }
+private:
+    template <class Stream>
+    static constexpr void addAttributeDescriptions(
+        std::array<VkVertexInputAttributeDescription, ATTRIBUTE_COUNT>& attributeDescriptions,
+        uint32_t binding, uint32_t& location, size_t& index)
+    {
+        for (const auto& member : VertexLayout<Stream>::MEMBERS) {
+            for (uint32_t i = 0; i < member.locationCount_m; i++) {
+                // location, binding, format, offset
+                attributeDescriptions[index++] = VkVertexInputAttributeDescription{location++, binding,
+                    member.format_m, member.offset_m + i * getVertexFormatSize(member.format_m)};
+            }
+        }
+    }
+};
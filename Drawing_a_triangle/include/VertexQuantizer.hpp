@@ -0,0 +1,28 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+// encoding of vertex attributes into normalized integers
+// positions are stored relative to the bounds of the mesh, the scale and offset to
+// get them back are folded into the model matrix instead of being applied by the shader
+class VertexQuantizer
+{
+public:
+    // position = snorm * scale_m + offset_m
+    // the scale is the same on every axis, so spheres stay spheres in the quantized space
+    struct Dequantization
+    {
+        float scale_m = 1.0f;
+        float offset_m[3] = {0.0f, 0.0f, 0.0f};
+    };
+    // bounds of count 2D float positions, stride bytes apart
+    static Dequantization computeDequantization(const void* positions, size_t count, size_t stride);
+    // value in [-1, 1] to a signed normalized 16-bit integer (VK_FORMAT_R16_SNORM)
+    static int16_t encodeSnorm16(float value);
+    // value in [0, 1] to an unsigned normalized 8-bit integer (VK_FORMAT_R8_UNORM)
+    static uint8_t encodeUnorm8(float value);
+    // the position stored for position
+    static int16_t quantizePosition(float position, const Dequantization& dequantization, int axis);
+    // largest distance between a position and its dequantized value, in quantized units
+    static constexpr float SNORM16_ERROR = 0.5f / 32767.0f;
+};
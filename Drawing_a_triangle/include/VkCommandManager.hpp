@@ -2,25 +2,127 @@
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 #include <VkDeviceManager.hpp>
+#include <ThreadPool.hpp>
+#include <VkProfiler.hpp>
+#include <VkCullingManager.hpp>
+#include <VkUniformManager.hpp>
 #include <vector>
 
 class VkCommandManager
 {
 public:
+    // parameters of a single vkCmdDrawIndexed
+    struct DrawCall
+    {
+        uint32_t indexCount_m;
+        uint32_t instanceCount_m;
+        uint32_t firstIndex_m;
+        int32_t vertexOffset_m;
+        uint32_t firstInstance_m;
+    };
+    // buffers bound for every draw call of a frame
+    struct GeometryBuffers
+    {
+        VkBuffer vertexBuffer_m;
+        VkBuffer indexBuffer_m;
+        VkIndexType indexType_m;
+        // per-instance attributes, bound at binding 1
+        VkBuffer instanceBuffer_m;
+        // region of the instance buffer written for this frame
+        VkDeviceSize instanceOffset_m;
+        // per-frame uniforms bound at VkGraphicsPipelineFactory::FRAME_SET, nothing is bound when null
+        VkPipelineLayout pipelineLayout_m = VK_NULL_HANDLE;
+        VkDescriptorSet uniformSet_m = VK_NULL_HANDLE;
+        // one per dynamic uniform buffer of the set, in binding order
+        std::vector<uint32_t> dynamicOffsets_m;
+        // per-draw data, drawDataSize_m bytes for each draw call, nothing is pushed when null
+        const char* drawData_m = nullptr;
+        uint32_t drawDataSize_m = 0;
+        // the push constant range of the pipeline layout
+        VkPushConstantRange pushConstantRange_m{};
+        // when set, the draw data is written into this ring instead of being pushed,
+        // and drawSet_m is bound at VkGraphicsPipelineFactory::DRAW_SET with its offset
+        VkUniformManager* drawRing_m = nullptr;
+        VkDescriptorSet drawSet_m = VK_NULL_HANDLE;
+        // drawData[i] belongs to the draw call i, the indirect draws of culling use drawData[0]
+        template <class T>
+        void setDrawData(const std::vector<T>& drawData)
+        {
+            drawData_m = reinterpret_cast<const char*>(drawData.data());
+            drawDataSize_m = sizeof(T);
+        }
+    };
+    // record the per-draw data of one command buffer with push constants, or through the uniform ring
+    // of geometry when set, a value equal to the previous one is not recorded again
+    class DrawDataRecorder
+    {
+    public:
+        DrawDataRecorder(const VkCommandBuffer& commandBuffer, const GeometryBuffers& geometry);
+        template <class T>
+        void push(const T& data)
+            { push(&data, sizeof(T)); }
+        // throw when size exceeds the push constant range
+        void push(const void* data, uint32_t size);
+        uint64_t getPushCount() const;
+        uint64_t getSkippedCount() const;
+    private:
+        VkCommandBuffer commandBuffer_m;
+        const GeometryBuffers& geometry_m;
+        // what the command buffer holds, empty before the first push
+        std::vector<char> current_m;
+        uint64_t pushCount_m = 0;
+        uint64_t skippedCount_m = 0;
+    };
     VkCommandManager(){}
-    // Command pools manage the memory that is used to store the buffers 
+    // Command pools manage the memory that is used to store the buffers
     // and com- mand buffers are allocated from them.
     void createCommandPool(const VkDeviceManager& deviceManager);
-    void createCommandBuffers(const VkDevice& device, const VkRenderPass& renderPass, const std::vector<VkFramebuffer>& swapChainFramebuffers, 
-        const VkPipeline& graphicsPipeline, const VkExtent2D& swapChainExtent, const VkBuffer& vertexBuffer, size_t verticesCount);
+    // one primary command buffer per frame in flight, and one command pool and
+    // secondary command buffer per frame in flight and recording thread
+    void createCommandBuffers(const VkDeviceManager& deviceManager, size_t framesInFlight, uint32_t threadCount);
     void destroyCommandPool(const VkDevice& device);
     void destroyCommandBuffers(const VkDevice& device);
-    const std::vector<VkCommandBuffer>& getCommandBufferRef() const;
+    // record the draw list of a frame, split across the threads of threadPool
+    // the fence of frameIndex must have been waited on
+    // the frame and the render pass are surrounded by timestamps of profiler
+    // with culling, the draw list is built on the GPU and drawCalls is ignored
+    const VkCommandBuffer& recordCommandBuffer(const VkDevice& device, ThreadPool& threadPool, VkProfiler& profiler,
+        size_t frameIndex, const VkRenderPass& renderPass, const VkFramebuffer& framebuffer,
+        const VkPipeline& graphicsPipeline, const VkExtent2D& extent, const GeometryBuffers& geometry,
+        const std::vector<DrawCall>& drawCalls, const VkCullingManager* culling = nullptr);
+    // average recording time of each thread
+    void printRecordingStatistics() const;
     VkCommandPool& getCommandPoolRef();
 private:
-    void executeCommandFunctions(const VkRenderPass& renderPass, const VkExtent2D& swapChainExtent, 
-        const std::vector<VkFramebuffer>& swapChainFramebuffers, const VkPipeline& graphicsPipeline,
-        const VkBuffer& vertexBuffer, size_t verticesCount);
+    struct FrameCommands
+    {
+        VkCommandPool primaryPool_m;
+        VkCommandBuffer primaryBuffer_m;
+        // indexed by recording thread
+        std::vector<VkCommandPool> threadPools_m;
+        std::vector<VkCommandBuffer> secondaryBuffers_m;
+    };
+    struct RecordingStatistics
+    {
+        double totalMs_m = 0.0;
+        uint64_t drawCount_m = 0;
+        // per-draw data recorded and skipped because it was already set
+        uint64_t pushCount_m = 0;
+        uint64_t skippedPushCount_m = 0;
+    };
+    // record drawCalls[first, last) into a secondary command buffer which continues the render pass
+    // or the indirect draws of culling for frameIndex when it is not null
+    // the pushes of the draw data are counted in statistics
+    void recordSecondaryCommandBuffer(const VkCommandBuffer& commandBuffer,
+        const VkRenderPass& renderPass, const VkFramebuffer& framebuffer, const VkPipeline& graphicsPipeline,
+        const VkExtent2D& extent, const GeometryBuffers& geometry, const std::vector<DrawCall>& drawCalls,
+        size_t first, size_t last, RecordingStatistics& statistics,
+        const VkCullingManager* culling = nullptr, size_t frameIndex = 0);
+    void createFramePool(const VkDevice& device, uint32_t queueFamilyIndex, VkCommandPool& pool);
+    // used for one time commands like buffer copies
     VkCommandPool commandPool_m;
-    std::vector<VkCommandBuffer> commandBuffers_m;
-};
\ No newline at end of file
+    std::vector<FrameCommands> frames_m;
+    // indexed by recording thread, the last entry is the primary command buffer on the main thread
+    std::vector<RecordingStatistics> recordingStatistics_m;
+    uint64_t recordedFrameCount_m = 0;
+};
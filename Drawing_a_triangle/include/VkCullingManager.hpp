@@ -0,0 +1,97 @@
+#pragma once
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include <VkDeviceManager.hpp>
+#include <VkMemoryAllocator.hpp>
+#include <VkUploadManager.hpp>
+#include <VkLayoutCacheManager.hpp>
+#include <VkDescriptorAllocator.hpp>
+#include <VkRetireQueue.hpp>
+
+// GPU driven rendering : a compute shader tests the bounds of every object against the view volume
+// and compacts the visible ones into indirect draw commands, so the CPU records the same few
+// commands whatever the number of objects is
+class VkCullingManager
+{
+public:
+    // an object is one instance of a mesh, read by the compute shader (std430 layout of cull.comp)
+    struct Object
+    {
+        // bounding sphere of the mesh in model space, xyz center and w radius
+        glm::vec4 boundingSphere_m;
+        uint32_t indexCount_m;
+        uint32_t firstIndex_m;
+        int32_t vertexOffset_m;
+        // the model matrix is read from this instance, it is also the firstInstance of the draw
+        uint32_t instanceIndex_m;
+    };
+    // objects are copied by the upload manager, flush it before the first frame
+    // instanceBuffer holds framesInFlight regions of instanceRegionSize VkVertexManager::Instance
+    // the layouts are reflected from cull.comp and shared through layoutCache
+    void createCullingManager(const VkDeviceManager& deviceManager, VkMemoryAllocator& memoryAllocator,
+        VkUploadManager& uploadManager, const VkPipelineCache& pipelineCache, VkLayoutCacheManager& layoutCache,
+        const std::vector<Object>& objects, size_t instanceRegionSize, size_t framesInFlight);
+    void destroyCullingManager(const VkDevice& device, VkMemoryAllocator& memoryAllocator);
+    // write the descriptor set of frameIndex with the instance buffer the frame reads, the set is a
+    // FRAME one of descriptorAllocator, call it after descriptorAllocator.beginFrame(frameIndex)
+    void beginFrame(VkDescriptorAllocator& descriptorAllocator, const VkBuffer& instanceBuffer, size_t frameIndex);
+    // camera of the frames recorded from now on, the view volume is its clip space
+    void setViewProjection(const glm::mat4& viewProjection);
+    // outside of a render pass, after the instances of frameIndex have been written
+    void recordCulling(const VkCommandBuffer& commandBuffer, size_t frameIndex) const;
+    // inside the render pass, with the graphics pipeline and the geometry bound
+    void recordDraws(const VkCommandBuffer& commandBuffer, size_t frameIndex) const;
+    size_t getObjectCount() const;
+    // compile the culling pipeline from the current cull.spv without touching the one in use
+    // throw when the shader fails to load or its interface changed
+    VkPipeline buildComputePipeline(const VkDevice& device, const VkPipelineCache& pipelineCache,
+        VkLayoutCacheManager& layoutCache) const;
+    // dispatch pipeline from the next recorded frame, the previous one is destroyed
+    // once the frames of fences have finished
+    void replaceComputePipeline(const VkDevice& device, const VkPipeline& pipeline, VkRetireQueue& retireQueue,
+        const std::vector<VkFence>& fences);
+
+    // invocations per workgroup, local_size_x of cull.comp
+    static constexpr uint32_t WORKGROUP_SIZE = 64;
+private:
+    // matches the push constant block of cull.comp
+    struct PushConstants
+    {
+        glm::mat4 viewProjection_m;
+        uint32_t objectCount_m;
+        // first instance of the region of the frame
+        uint32_t instanceBase_m;
+        // first draw command and counter of the frame
+        uint32_t drawBase_m;
+        uint32_t counterIndex_m;
+    };
+    void createComputePipeline(const VkDevice& device, const VkPipelineCache& pipelineCache,
+        VkLayoutCacheManager& layoutCache);
+
+    std::vector<Object> objects_m;
+    glm::mat4 viewProjection_m = glm::mat4(1.0f);
+    size_t instanceRegionSize_m = 0;
+    // drawCount of vkCmdDrawIndexedIndirect may be greater than 1
+    bool multiDrawIndirect_m = false;
+    uint32_t maxDrawIndirectCount_m = 1;
+    // bounds and draw parameters of every object
+    VkBuffer objectBuffer_m = VK_NULL_HANDLE;
+    VkMemoryAllocator::Allocation objectBufferAllocation_m;
+    // one region of VkDrawIndexedIndirectCommand per frame in flight
+    VkBuffer drawBuffer_m = VK_NULL_HANDLE;
+    VkMemoryAllocator::Allocation drawBufferAllocation_m;
+    // one atomic counter of visible objects per frame in flight
+    VkBuffer counterBuffer_m = VK_NULL_HANDLE;
+    VkMemoryAllocator::Allocation counterBufferAllocation_m;
+    // reflected from cull.comp
+    std::vector<VkDescriptorSetLayoutBinding> bindings_m;
+    // the layouts are owned by the layout cache
+    VkDescriptorSetLayout descriptorSetLayout_m = VK_NULL_HANDLE;
+    // indexed by frame in flight, released when the FRAME chain of the frame is reset
+    // the regions of the frame are selected with push constants
+    std::vector<VkDescriptorSet> frameDescriptorSets_m;
+    VkPipelineLayout pipelineLayout_m = VK_NULL_HANDLE;
+    VkPipeline computePipeline_m = VK_NULL_HANDLE;
+};
@@ -0,0 +1,94 @@
+#pragma once
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <VkDeviceManager.hpp>
+#include <VkLayoutCacheManager.hpp>
+
+// descriptor sets allocated from chains of pools which grow on demand, one chain per lifetime
+// and per frame in flight, so an allocation never fails because a single pool is exhausted
+// the sets are never freed one by one, a whole chain is reset at once
+// the sets are written through a descriptor update template per set layout
+class VkDescriptorAllocator
+{
+public:
+    // PERSISTENT : sets which live as long as the allocator
+    // FRAME      : sets used by a single frame, reset when the frame in flight comes around again
+    enum class Lifetime
+    {
+        PERSISTENT,
+        FRAME
+    };
+    // one descriptor, the member matching the descriptor type of its binding is read
+    union DescriptorInfo
+    {
+        VkDescriptorBufferInfo buffer_m;
+        VkDescriptorImageInfo image_m;
+        VkBufferView texelBufferView_m;
+    };
+    struct Statistics
+    {
+        size_t poolCount_m = 0;
+        // since the creation of the allocator
+        uint64_t allocatedSetCount_m = 0;
+        uint64_t writtenSetCount_m = 0;
+        uint64_t poolResetCount_m = 0;
+    };
+    // the set layouts come from layoutCache, which knows their bindings
+    // setsPerPool is the size of the first pool of a chain, the next ones double up to MAX_SETS_PER_POOL
+    void createDescriptorAllocator(const VkDeviceManager& deviceManager, VkLayoutCacheManager& layoutCache,
+        size_t framesInFlight, uint32_t setsPerPool = DEFAULT_SETS_PER_POOL);
+    // the sets of every lifetime are released with their pools
+    void destroyDescriptorAllocator();
+    // reset the FRAME chain of frameIndex, the fence of frameIndex must have been waited on
+    void beginFrame(size_t frameIndex);
+    // may be called from several threads, frameIndex is ignored for PERSISTENT sets
+    VkDescriptorSet allocate(const VkDescriptorSetLayout& setLayout, Lifetime lifetime, size_t frameIndex = 0);
+    // set of a pipeline layout returned by VkGraphicsPipelineFactory::createPipelineLayout
+    VkDescriptorSet allocate(const VkPipelineLayout& pipelineLayout, uint32_t set, Lifetime lifetime,
+        size_t frameIndex = 0);
+    // write every descriptor of a set allocated with setLayout, infos holds the descriptors of
+    // each binding in binding order, descriptorCount of them per binding
+    void write(const VkDescriptorSet& descriptorSet, const VkDescriptorSetLayout& setLayout,
+        const std::vector<DescriptorInfo>& infos);
+
+    Statistics getStatistics() const;
+    void printStatistics() const;
+
+    static constexpr uint32_t DEFAULT_SETS_PER_POOL = 64;
+    static constexpr uint32_t MAX_SETS_PER_POOL = 4096;
+private:
+    struct PoolChain
+    {
+        std::vector<VkDescriptorPool> pools_m;
+        // pools before this one are full until the chain is reset
+        size_t current_m = 0;
+    };
+    struct UpdateTemplate
+    {
+        // VK_NULL_HANDLE without VK_KHR_descriptor_update_template, vkUpdateDescriptorSets is used instead
+        VkDescriptorUpdateTemplate template_m = VK_NULL_HANDLE;
+        std::vector<VkDescriptorSetLayoutBinding> bindings_m;
+        // number of DescriptorInfo the template reads
+        uint32_t descriptorCount_m = 0;
+    };
+    VkDescriptorPool createPool(uint32_t maxSets);
+    void resetChain(PoolChain& chain);
+    const UpdateTemplate& getUpdateTemplate(const VkDescriptorSetLayout& setLayout);
+
+    VkDevice device_m = VK_NULL_HANDLE;
+    VkLayoutCacheManager* layoutCache_m = nullptr;
+    uint32_t setsPerPool_m = DEFAULT_SETS_PER_POOL;
+    PoolChain persistentChain_m;
+    // indexed by frame in flight
+    std::vector<PoolChain> frameChains_m;
+    std::map<VkDescriptorSetLayout, UpdateTemplate> updateTemplates_m;
+    PFN_vkCreateDescriptorUpdateTemplateKHR createUpdateTemplate_m = nullptr;
+    PFN_vkDestroyDescriptorUpdateTemplateKHR destroyUpdateTemplate_m = nullptr;
+    PFN_vkUpdateDescriptorSetWithTemplateKHR updateWithTemplate_m = nullptr;
+    Statistics statistics_m;
+    // the recording threads may allocate and write sets
+    mutable std::mutex mutex_m;
+};
@@ -18,10 +18,15 @@ class VkDeviceManager
     {
         std::optional<uint32_t> graphicsFamily_m;
         std::optional<uint32_t> presentFamily_m;
-        inline bool isComplete();
+        // a transfer only family when the device has one, the graphics family otherwise
+        std::optional<uint32_t> transferFamily_m;
+        // a present queue is unnecessary without a surface
+        inline bool isComplete(bool headless);
     };
 
 public:
+    // headless device manager works without a surface or a swap chain
+    VkDeviceManager(bool headless = false);
     // relevant to physicaldevice
     void pickPhysicalDevice(VkInstance& instance);
     // relevant to logical device
@@ -36,7 +41,17 @@ public:
     const VkPhysicalDevice& getPhysicalDevice() const;
     const VkQueue& getGraphicsQueueRef() const;
     const VkQueue& getPresentQueueRef() const;
+    // same queue as the graphics queue when there is no dedicated transfer family
+    const VkQueue& getTransferQueueRef() const;
+    bool isHeadless() const;
+    // drawCount of vkCmdDrawIndexedIndirect may be greater than 1
+    bool isMultiDrawIndirectEnabled() const;
+    // VK_KHR_descriptor_update_template has been enabled
+    bool isDescriptorUpdateTemplateEnabled() const;
     QueueFamilyIndices findQueueFamilies(const VkPhysicalDevice& device);
+    // find a memory type which is allowed by typeFilter and has all the properties
+    static uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties,
+        const VkPhysicalDevice& physicalDevice);
     
 private:
     bool isDeviceSuitable(const VkPhysicalDevice& device);
@@ -51,10 +66,15 @@ private:
     // window surface
     VkSurfaceKHR surface_m;
     VkQueue presentQueue_m;
+    VkQueue transferQueue_m;
+    bool headless_m;
+    bool multiDrawIndirect_m = false;
+    bool descriptorUpdateTemplate_m = false;
     // requied extensions name
     std::vector<const char*> deviceExtensions_m =
     {
         VK_KHR_SWAPCHAIN_EXTENSION_NAME
     };
     friend void VkSwapChainManager::createSwapChain(const uint32_t width, const uint32_t height);
+    friend VkFormat VkSwapChainManager::chooseImageFormat();
 };
\ No newline at end of file
@@ -4,15 +4,33 @@
 #include <vector>
 #include <VkDeviceManager.hpp>
 #include <VKSwapChainManager.hpp>
+#include <VkMemoryAllocator.hpp>
+#include <VkRetireQueue.hpp>
 
 class VkFramebufferFactory
 {
 public:
     VkFramebufferFactory(){}
+    // every framebuffer shares the depth buffer, it must be created before
     void createFramebuffers(const VkDevice& device, 
         const VkSwapChainManager& swapChainManager, const VkRenderPass& renderPass);
     void destroyFramebuffers(const VkDeviceManager& deviceManager);
+    // destroy the framebuffers once the frames of fences have finished
+    void retireFramebuffers(const VkDevice& device, VkRetireQueue& retireQueue, const std::vector<VkFence>& fences);
     std::vector<VkFramebuffer>& getSwapChainFrameBuffersRef();
+    // depth attachment format supported by the device, the render pass is created with it
+    static VkFormat chooseDepthFormat(const VkPhysicalDevice& physicalDevice);
+    // a single depth image of the size of the swap chain, the render pass orders
+    // the depth writes of the frames in flight, so they can share it
+    void createDepthBuffer(const VkDeviceManager& deviceManager, VkMemoryAllocator& memoryAllocator,
+        const VkExtent2D& extent);
+    void destroyDepthBuffer(const VkDevice& device, VkMemoryAllocator& memoryAllocator);
+    // destroy the depth buffer once the frames of fences have finished
+    void retireDepthBuffer(const VkDevice& device, VkMemoryAllocator& memoryAllocator,
+        VkRetireQueue& retireQueue, const std::vector<VkFence>& fences);
 private:
     std::vector<VkFramebuffer> swapChainFramebuffers_m;
+    VkImage depthImage_m = VK_NULL_HANDLE;
+    VkMemoryAllocator::Allocation depthImageAllocation_m;
+    VkImageView depthImageView_m = VK_NULL_HANDLE;
 };
\ No newline at end of file
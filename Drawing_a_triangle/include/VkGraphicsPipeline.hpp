@@ -2,50 +2,151 @@
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 #include <memory>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <string>
 #include <VkDeviceManager.hpp>
 #include <VkRenderPass.hpp>
+#include <VkLayoutCacheManager.hpp>
+#include <VkShaderReflection.hpp>
+#include <VkRetireQueue.hpp>
+#include <ThreadPool.hpp>
 
+// pipeline library : one pipeline per variant of the fixed function state, sharing the shaders and the layout
+// the declared variants are compiled in parallel at creation, any other one on first use
 class VkGraphicsPipelineFactory
 {
 public:
-    void createGraphicsPipeline(const VkDevice& device, const VkExtent2D& swapChainExtent);
-    void createRenderPass(const VkDevice& device, const VkFormat& swapChainImageFormat);
+    enum class BlendMode
+    {
+        OPAQUE,
+        // source alpha over the framebuffer, the default
+        ALPHA,
+        ADDITIVE
+    };
+    // the state which differs between the pipelines of the library
+    struct PipelineVariant
+    {
+        VkPrimitiveTopology topology_m = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+        BlendMode blendMode_m = BlendMode::ALPHA;
+        VkCullModeFlags cullMode_m = VK_CULL_MODE_BACK_BIT;
+        bool operator<(const PipelineVariant& other) const;
+        std::string getName() const;
+    };
+    struct CompiledVariant
+    {
+        VkPipeline pipeline_m = VK_NULL_HANDLE;
+        // duration of the vkCreateGraphicsPipelines call which built it
+        double compileMs_m = 0.0;
+        // pipelines created by that call
+        uint32_t batchSize_m = 1;
+        // compiled on first use instead of at creation
+        bool lazy_m = false;
+    };
+    // pipelines rebuilt from new shaders, with the code they were built from
+    struct PipelineSet
+    {
+        std::vector<char> vertShaderCode_m;
+        std::vector<char> fragShaderCode_m;
+        std::map<PipelineVariant, CompiledVariant> variants_m;
+    };
+    // pipelineCache may be VK_NULL_HANDLE
+    // viewport and scissor are dynamic state, so the pipeline does not depend on the extent
+    // the vertex input follows the vertex format of the mesh
+    // the pipeline layout is reflected from the shaders and shared through layoutCache
+    // when the push constants of vert.spv exceed maxPushConstantsSize, the per-draw data is read from
+    // the uniform ring at DRAW_SET instead, with the vertex shader compiled for it
+    // variants, with the default one always added, are compiled by the workers of threadPool,
+    // each worker creating its share of them with a single vkCreateGraphicsPipelines call
+    void createGraphicsPipeline(const VkDevice& device, const VkPipelineCache& pipelineCache,
+        VkLayoutCacheManager& layoutCache, uint32_t maxPushConstantsSize,
+        const std::vector<VkVertexInputBindingDescription>& bindingDescriptions,
+        const std::vector<VkVertexInputAttributeDescription>& attributeDescriptions,
+        ThreadPool& threadPool, const std::vector<PipelineVariant>& variants = {});
+
+    // set of the per frame uniforms, its uniform buffers are bound with dynamic offsets
+    static constexpr uint32_t FRAME_SET = 0;
+    // set of the per-draw data when it does not fit in the push constants, bound with a dynamic offset per draw
+    static constexpr uint32_t DRAW_SET = 1;
+    // compile every variant compiled so far from the current SPIR-V files without touching the ones in use,
+    // so it can run on another thread than the one recording with them
+    // throw when the shaders fail to load or their interface needs another pipeline layout
+    PipelineSet buildGraphicsPipelines() const;
+    // use pipelines from the next recorded frame, the previous ones are destroyed
+    // once the frames of fences have finished, the variants missing from pipelines are recompiled on use
+    void replaceGraphicsPipelines(PipelineSet& pipelines, VkRetireQueue& retireQueue,
+        const std::vector<VkFence>& fences);
+    // a set which will not be used
+    static void destroyPipelineSet(const VkDevice& device, PipelineSet& pipelines);
+    void createRenderPass(const VkDevice& device, const VkFormat& swapChainImageFormat,
+        const VkImageLayout& finalLayout, const VkFormat& depthFormat);
     void destroyGraphicsPipeline(const VkDevice& device);
     void destroyRenderPass(const VkDevice& device);
     const VkRenderPass& getRenderPassRef();
-    const VkPipeline& getGraphicsPipelineRef();
+    // a variant which has not been compiled yet is compiled now, blocking the caller
+    const VkPipeline& getGraphicsPipelineRef(const PipelineVariant& variant);
+    const VkPipelineLayout& getPipelineLayoutRef();
+    // descriptors and push constants of the shaders, as the pipeline layout was created from them
+    const VkShaderReflection::ShaderInterface& getShaderInterfaceRef();
+    // vert.spv, or the SPIR-V of the uniform fallback of the per-draw data
+    const std::string& getVertShaderPathRef();
+    // compile time of every variant
+    void printStatistics() const;
 private:
+    // compile variants from the shader code with pipelineLayout_m, in the same order
+    // split into one batch per worker of threadPool, or a single batch on the caller thread without one
+    std::vector<CompiledVariant> compileVariants(const std::vector<char>& vertShaderCode,
+        const std::vector<char>& fragShaderCode, const std::vector<PipelineVariant>& variants,
+        ThreadPool* threadPool) const;
     // wrap the shader code in a VkShaderModule object
-    VkShaderModule createShaderModule
+    static VkShaderModule createShaderModule
         (const std::vector<char>& code, const VkDevice& device);
-    VkPipelineShaderStageCreateInfo         createVertexShaderStageInfo();
-    VkPipelineShaderStageCreateInfo         createFragmentShaderStageInfo();
-    VkPipelineVertexInputStateCreateInfo    createVertexInputInfo();
-    VkPipelineInputAssemblyStateCreateInfo  createInputAssemblyInfo();
-    // viewport and scissor
-    VkViewport  createViewport(const VkExtent2D& extent);
-    VkRect2D    createScissor(const VkExtent2D& extent);
-    VkPipelineViewportStateCreateInfo createViewportInfo
-        (const VkViewport& viewport, const VkRect2D& scissor);
+    static VkPipelineShaderStageCreateInfo         createVertexShaderStageInfo(const VkShaderModule& module);
+    static VkPipelineShaderStageCreateInfo         createFragmentShaderStageInfo(const VkShaderModule& module);
+    static VkPipelineVertexInputStateCreateInfo    createVertexInputInfo();
+    static VkPipelineInputAssemblyStateCreateInfo  createInputAssemblyInfo(VkPrimitiveTopology topology);
+    // viewport and scissor counts, they are set at command recording time
+    static VkPipelineViewportStateCreateInfo createViewportInfo();
     // rasterizer
-    VkPipelineRasterizationStateCreateInfo createRasterizer();
+    static VkPipelineRasterizationStateCreateInfo createRasterizer(VkCullModeFlags cullMode);
     // multisampling used for anti-aliasing
-    VkPipelineMultisampleStateCreateInfo createMultisampleState();
-    // color blending for alpha blending
-    VkPipelineColorBlendAttachmentState createColorBlendingAttachment();
-    VkPipelineColorBlendStateCreateInfo createColorBlendingState
+    static VkPipelineMultisampleStateCreateInfo createMultisampleState();
+    // depth test, the opaque variants write depth and the blended ones only test against it
+    static VkPipelineDepthStencilStateCreateInfo createDepthStencilState(BlendMode blendMode);
+    // color blending of the variant
+    static VkPipelineColorBlendAttachmentState createColorBlendingAttachment(BlendMode blendMode);
+    static VkPipelineColorBlendStateCreateInfo createColorBlendingState
         (VkPipelineColorBlendAttachmentState& colorBlendingAttachment);
     // dynamic state
-    VkPipelineDynamicStateCreateInfo createDynamicState();
-    // create uniform values (globals that can be changed at drawing time 
-    // to alter the behavior of the shaders)
-    void createPipelineLayout(const VkDevice& device);
-    
-    VkShaderModule vertShaderModule_m;
-    VkShaderModule fragShaderModule_m;
-    VkPipelineLayout pipelineLayout_m;
+    static VkPipelineDynamicStateCreateInfo createDynamicState();
+    // the interface of both shaders, throw when the vertex input does not feed the vertex shader
+    static VkShaderReflection::ShaderInterface reflectInterface(const std::vector<char>& vertShaderCode,
+        const std::vector<char>& fragShaderCode,
+        const std::vector<VkVertexInputAttributeDescription>& attributeDescriptions);
+    // uniform values (globals that can be changed at drawing time to alter the behavior of the shaders)
+    // as declared by the shaders, the descriptor types of interface are adjusted to the layout
+    // the push constant range of the shaders is declared as is, throw when it exceeds maxPushConstantsSize
+    static VkPipelineLayout createPipelineLayout(VkLayoutCacheManager& layoutCache,
+        VkShaderReflection::ShaderInterface& interface, uint32_t maxPushConstantsSize);
+
+    // what the variants are built with, kept for the ones compiled on first use
+    VkDevice device_m = VK_NULL_HANDLE;
+    VkPipelineCache pipelineCache_m = VK_NULL_HANDLE;
+    VkLayoutCacheManager* layoutCache_m = nullptr;
+    uint32_t maxPushConstantsSize_m = 0;
+    std::vector<VkVertexInputBindingDescription> bindingDescriptions_m;
+    std::vector<VkVertexInputAttributeDescription> attributeDescriptions_m;
+    std::string vertShaderPath_m = "./spv/vert.spv";
+    std::vector<char> vertShaderCode_m;
+    std::vector<char> fragShaderCode_m;
+    VkShaderReflection::ShaderInterface interface_m;
+    // owned by the layout cache
+    VkPipelineLayout pipelineLayout_m = VK_NULL_HANDLE;
     // to save the attachments and subpasses refrence
     VkRenderPassFactory renderPassFactory_m;
     VkRenderPass renderPass_m;
-    VkPipeline graphicsPipeline_m;
+    // the variants are compiled on the render thread and rebuilt on the shader watcher thread
+    mutable std::mutex variantsMutex_m;
+    std::map<PipelineVariant, CompiledVariant> variants_m;
 };
\ No newline at end of file
@@ -0,0 +1,37 @@
+#pragma once
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <map>
+#include <mutex>
+#include <vector>
+#include <VkShaderReflection.hpp>
+
+// descriptor set layouts and pipeline layouts built from reflected shader interfaces
+// identical layouts are created once and shared, so pipelines with the same interface
+// are layout compatible and the descriptor sets bound for one stay valid for the other
+// the layouts are owned by the cache, the pipelines only borrow them
+// pipelines may be built on several threads, so the lookups are synchronized
+class VkLayoutCacheManager
+{
+public:
+    void createLayoutCache(const VkDevice& device);
+    void destroyLayoutCache();
+    const VkDescriptorSetLayout& getDescriptorSetLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings);
+    // one set layout per set up to the highest one used, the unused sets get an empty layout
+    const VkPipelineLayout& getPipelineLayout(const VkShaderReflection::ShaderInterface& interface);
+    // the set layouts of a pipeline layout returned by getPipelineLayout
+    const std::vector<VkDescriptorSetLayout>& getSetLayouts(const VkPipelineLayout& pipelineLayout) const;
+    // the bindings a set layout returned by getDescriptorSetLayout was created with, sorted by binding
+    const std::vector<VkDescriptorSetLayoutBinding>& getSetLayoutBindings(
+        const VkDescriptorSetLayout& descriptorSetLayout) const;
+private:
+    // the create infos flattened into words, handles included
+    using LayoutKey = std::vector<uint64_t>;
+    VkDevice device_m = VK_NULL_HANDLE;
+    // getPipelineLayout looks up set layouts while holding it
+    mutable std::recursive_mutex mutex_m;
+    std::map<LayoutKey, VkDescriptorSetLayout> descriptorSetLayouts_m;
+    std::map<LayoutKey, VkPipelineLayout> pipelineLayouts_m;
+    std::map<VkPipelineLayout, std::vector<VkDescriptorSetLayout>> pipelineSetLayouts_m;
+    std::map<VkDescriptorSetLayout, std::vector<VkDescriptorSetLayoutBinding>> setLayoutBindings_m;
+};
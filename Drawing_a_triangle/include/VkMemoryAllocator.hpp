@@ -0,0 +1,130 @@
+#pragma once
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <vector>
+#include <set>
+#include <mutex>
+
+class VkDeviceManager;
+
+// grab large VkDeviceMemory blocks per memory type and sub-allocate buffers and images from them
+// instead of calling vkAllocateMemory for every resource
+class VkMemoryAllocator
+{
+public:
+    // PERSISTENT : long-lived resources, sub-allocated by a buddy allocator
+    // TRANSIENT  : short-lived resources like staging buffers, bump allocated
+    //              and the block is rewound when all of them are freed
+    enum class Lifetime
+    {
+        PERSISTENT,
+        TRANSIENT
+    };
+    struct Allocation
+    {
+        VkDeviceMemory memory_m = VK_NULL_HANDLE;
+        VkDeviceSize offset_m = 0;
+        // requested size
+        VkDeviceSize size_m = 0;
+        // host address of offset_m (nullptr if the memory is not host visible)
+        void* mapped_m = nullptr;
+        // where the allocation came from
+        uint32_t poolIndex_m = 0;
+        uint32_t blockIndex_m = 0;
+        // buddy level of the node (0 is the whole block)
+        uint32_t level_m = 0;
+    };
+    struct Statistics
+    {
+        // VkDeviceMemory objects owned by the allocator
+        size_t blockCount_m = 0;
+        size_t allocationCount_m = 0;
+        VkDeviceSize blockBytes_m = 0;
+        // bytes requested by the live allocations
+        VkDeviceSize usedBytes_m = 0;
+        // bytes neither allocated nor lost to padding
+        VkDeviceSize freeBytes_m = 0;
+        VkDeviceSize largestFreeRange_m = 0;
+        // 0 : all free memory is in one range, close to 1 : free memory is scattered
+        float fragmentation_m = 0.0f;
+    };
+
+    // blockSize is rounded up to a power of two
+    void createAllocator(const VkDeviceManager& deviceManager, VkDeviceSize blockSize = DEFAULT_BLOCK_SIZE);
+    void destroyAllocator();
+    // linearResource : buffers and linear images. they are kept apart from optimal images
+    // when bufferImageGranularity requires it
+    Allocation allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties,
+        Lifetime lifetime, bool linearResource = true);
+    void free(Allocation& allocation);
+    // create a resource and bind sub-allocated memory to it
+    void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+        Lifetime lifetime, VkBuffer& buffer, Allocation& allocation);
+    void destroyBuffer(VkBuffer& buffer, Allocation& allocation);
+    // persistently mapped buffer written by the CPU in place, released with destroyBuffer
+    // preferDeviceLocal : try the device local and host visible heap first, and fall back
+    // to system memory when the device has none or it is full
+    void createHostVisibleBuffer(VkDeviceSize size, VkBufferUsageFlags usage, Lifetime lifetime,
+        VkBuffer& buffer, Allocation& allocation, bool preferDeviceLocal = true);
+    void createImage(const VkImageCreateInfo& imageInfo, VkMemoryPropertyFlags properties,
+        VkImage& image, Allocation& allocation);
+    void destroyImage(VkImage& image, Allocation& allocation);
+
+    Statistics getStatistics() const;
+    void printStatistics() const;
+
+    static constexpr VkDeviceSize DEFAULT_BLOCK_SIZE = 64 * 1024 * 1024;
+private:
+    struct Block
+    {
+        VkDeviceMemory memory_m = VK_NULL_HANDLE;
+        VkDeviceSize size_m = 0;
+        void* mapped_m = nullptr;
+        // offsets of the free buddy nodes per level, level 0 is the whole block
+        std::vector<std::set<VkDeviceSize>> freeNodes_m;
+        // bump pointer of transient blocks
+        VkDeviceSize linearOffset_m = 0;
+        size_t allocationCount_m = 0;
+        VkDeviceSize usedBytes_m = 0;
+        // holds a single resource larger than the block size
+        bool dedicated_m = false;
+    };
+    struct Pool
+    {
+        uint32_t memoryType_m;
+        Lifetime lifetime_m;
+        // released blocks leave an empty slot so that block indices stay valid
+        std::vector<Block> blocks_m;
+    };
+    enum PoolKind
+    {
+        PERSISTENT_LINEAR,
+        PERSISTENT_OPTIMAL,
+        TRANSIENT_POOL,
+        POOL_KIND_COUNT
+    };
+    uint32_t getPoolIndex(uint32_t memoryType, Lifetime lifetime, bool linearResource) const;
+    // return the index of a block slot in the pool
+    uint32_t createBlock(Pool& pool, VkDeviceSize size, bool dedicated);
+    void destroyBlock(Block& block);
+    // buddy allocation of a node of size blockSize_m >> level, false if there is no room
+    bool allocateNode(Block& block, uint32_t level, VkDeviceSize& offset);
+    void freeNode(Block& block, uint32_t level, VkDeviceSize offset);
+    // bump allocation, false if there is no room
+    bool allocateLinear(Block& block, const VkMemoryRequirements& requirements, VkDeviceSize& offset);
+    Allocation allocatePersistent(Pool& pool, uint32_t poolIndex, const VkMemoryRequirements& requirements);
+    Allocation allocateTransient(Pool& pool, uint32_t poolIndex, const VkMemoryRequirements& requirements);
+
+    const VkDeviceManager* deviceManager_m = nullptr;
+    VkPhysicalDeviceMemoryProperties memoryProperties_m{};
+    VkDeviceSize blockSize_m = DEFAULT_BLOCK_SIZE;
+    // number of buddy levels in a block
+    uint32_t levelCount_m = 1;
+    VkDeviceSize bufferImageGranularity_m = 1;
+    uint32_t maxMemoryAllocationCount_m = 0;
+    // vkAllocateMemory calls alive
+    uint32_t deviceAllocationCount_m = 0;
+    std::vector<Pool> pools_m;
+    // allocation may happen from several threads
+    mutable std::mutex mutex_m;
+};
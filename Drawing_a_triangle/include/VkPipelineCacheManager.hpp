@@ -0,0 +1,43 @@
+#pragma once
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <string>
+#include <vector>
+#include <VkDeviceManager.hpp>
+
+// keep a VkPipelineCache alive for the whole application and persist it on disk
+// so that pipelines are not recompiled from SPIR-V at every launch
+class VkPipelineCacheManager
+{
+public:
+    // load the cache file if it was written by the same device and driver
+    void createPipelineCache(const VkDeviceManager& deviceManager, const std::string& path);
+    // write the cache back to disk and destroy it
+    void destroyPipelineCache(const VkDevice& device);
+    void savePipelineCache(const VkDevice& device);
+    const VkPipelineCache& getPipelineCacheRef() const;
+private:
+    // prepended to the data returned by vkGetPipelineCacheData
+    // because its own header has no driver version
+    struct FileHeader
+    {
+        uint32_t magic_m;
+        uint32_t fileVersion_m;
+        uint32_t vendorID_m;
+        uint32_t deviceID_m;
+        uint32_t driverVersion_m;
+        uint8_t pipelineCacheUUID_m[VK_UUID_SIZE];
+        uint64_t dataSize_m;
+        uint64_t checksum_m;
+    };
+    // return the cache data of the file, empty if it is missing or stale
+    std::vector<char> loadCacheData() const;
+    FileHeader createFileHeader() const;
+    static uint64_t computeChecksum(const std::vector<char>& data);
+
+    static constexpr uint32_t CACHE_FILE_MAGIC = 0x50434B56; // "VKCP"
+    static constexpr uint32_t CACHE_FILE_VERSION = 1;
+    VkPipelineCache pipelineCache_m = VK_NULL_HANDLE;
+    VkPhysicalDeviceProperties properties_m{};
+    std::string path_m;
+};
@@ -0,0 +1,20 @@
+#pragma once
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <vector>
+#include <string>
+
+// trade-off between input latency and throughput, selected at startup or at runtime
+struct VkPresentProfile
+{
+    const char* name_m;
+    // frames the CPU may record ahead of the GPU
+    uint32_t framesInFlight_m;
+    // the first supported mode is used, FIFO is always supported
+    std::vector<VkPresentModeKHR> presentModes_m;
+
+    // the first profile is the default one
+    static const std::vector<VkPresentProfile>& getProfiles();
+    // index of the profile called name
+    static size_t findProfile(const std::string& name);
+};
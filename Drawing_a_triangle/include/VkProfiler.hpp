@@ -0,0 +1,87 @@
+#pragma once
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <vector>
+#include <deque>
+#include <string>
+#include <chrono>
+#include <VkDeviceManager.hpp>
+
+// measure CPU frame time and GPU time with timestamp queries
+// results of a frame are read back when its frame in flight is reused, so it never stalls
+class VkProfiler
+{
+public:
+    // timestamps written into every frame
+    enum Query
+    {
+        FRAME_BEGIN,
+        RENDER_PASS_BEGIN,
+        RENDER_PASS_END,
+        FRAME_END,
+        QUERY_COUNT
+    };
+    // in milliseconds, over the last ROLLING_WINDOW frames
+    struct Statistics
+    {
+        size_t sampleCount_m = 0;
+        double min_m = 0.0;
+        double avg_m = 0.0;
+        double p50_m = 0.0;
+        double p95_m = 0.0;
+        double p99_m = 0.0;
+        double max_m = 0.0;
+    };
+    void createProfiler(const VkDeviceManager& deviceManager, size_t framesInFlight, const std::string& csvPath);
+    // read back the pending results and write the CSV file
+    void destroyProfiler(const VkDevice& device);
+    // collect the results of the previous use of frameIndex and reset its queries
+    // the fence of frameIndex must have been waited on
+    void beginFrame(const VkDevice& device, const VkCommandBuffer& commandBuffer, size_t frameIndex);
+    void writeTimestamp(const VkCommandBuffer& commandBuffer, size_t frameIndex, Query query);
+    // read back the results of every frame in flight in frame order
+    // the fences of all frames in flight must have been waited on
+    void collectPendingResults(const VkDevice& device);
+    Statistics getCpuFrameStatistics() const;
+    Statistics getGpuFrameStatistics() const;
+    Statistics getGpuRenderPassStatistics() const;
+    void printStatistics() const;
+    // one line per frame
+    void writeCsv(const std::string& path) const;
+    // min/avg/percentiles of values in milliseconds
+    static Statistics computeStatistics(std::vector<double> values);
+    // one indented line
+    static void printStatistics(const char* name, const Statistics& statistics);
+
+    static constexpr size_t ROLLING_WINDOW = 1024;
+private:
+    struct FrameSample
+    {
+        uint64_t frameNumber_m = 0;
+        double cpuFrameMs_m = 0.0;
+        // negative when the GPU times are unavailable
+        double gpuFrameMs_m = -1.0;
+        double gpuRenderPassMs_m = -1.0;
+    };
+    struct PendingFrame
+    {
+        bool pending_m = false;
+        FrameSample sample_m;
+    };
+    // move the results of a frame in flight into samples_m
+    void collectResults(const VkDevice& device, size_t frameIndex);
+
+    VkQueryPool queryPool_m = VK_NULL_HANDLE;
+    // nanoseconds per timestamp tick
+    double timestampPeriod_m = 1.0;
+    uint64_t timestampMask_m = ~0ull;
+    // false when the graphics queue does not support timestamps
+    bool timestampsSupported_m = false;
+    std::vector<PendingFrame> pendingFrames_m;
+    // every frame for the CSV file, only the rolling window without it
+    std::deque<FrameSample> samples_m;
+    uint64_t frameNumber_m = 0;
+    bool hasPreviousFrame_m = false;
+    std::chrono::steady_clock::time_point previousFrameTime_m;
+    std::string csvPath_m;
+};
@@ -9,14 +9,19 @@
 class VkRenderPassFactory
 {
 public:
-    void createRenderPass(const VkDevice& device, 
-        const VkFormat& swapChainImageFormat, VkRenderPass* pRenderPass);
+    // finalLayout : layout of the color attachment after the render pass
+    // depthFormat : format of the depth attachment, see VkFramebufferFactory::chooseDepthFormat
+    void createRenderPass(const VkDevice& device, const VkFormat& swapChainImageFormat,
+        const VkImageLayout& finalLayout, const VkFormat& depthFormat, VkRenderPass* pRenderPass);
 private:
-    void createAttachmentDescription(const VkFormat& swapChainImageFormat);
+    void createAttachmentDescription(const VkFormat& swapChainImageFormat, const VkImageLayout& finalLayout,
+        const VkFormat& depthFormat);
     void createSubPass();
     VkSubpassDependency createSubpassDependency();
 
     VkAttachmentDescription colorAttachment_m{};
     VkAttachmentReference colorAttachmentRef_m{};
+    VkAttachmentDescription depthAttachment_m{};
+    VkAttachmentReference depthAttachmentRef_m{};
     VkSubpassDescription subpass_m{};
 };
\ No newline at end of file
@@ -2,26 +2,60 @@
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 #include <VkDeviceManager.hpp>
+#include <chrono>
 
 class VkRenderer
 {
 public:
-    void createSyncObjects(const VkDevice& device, size_t imagesNum);
+    // sync objects are created for MAX_FRAMES_IN_FLIGHT, framesInFlight of them are used
+    void createSyncObjects(const VkDevice& device, size_t imagesNum, size_t framesInFlight);
     void destroyRenderer(const VkDevice& device);
-    bool drawFrame(const VkDeviceManager& deviceManager, const VkSwapchainKHR& swapChain,
-        const std::vector<VkCommandBuffer>& commandBuffer);
-
-    // handle resizes explicitly
-    bool framebufferResized = false;
+    // wait for the current frame in flight and acquire the image to render to
+    // false : the swap chain is out of date
+    bool beginFrame(const VkDeviceManager& deviceManager, const VkSwapchainKHR& swapChain,
+        uint32_t& imageIndex);
+    // submit the command buffer recorded for the image and present it
+    // false : the swap chain is out of date
+    bool endFrame(const VkDeviceManager& deviceManager, const VkSwapchainKHR& swapChain,
+        const VkCommandBuffer& commandBuffer);
+    // frame in flight whose resources can be reused after beginFrame
+    size_t getCurrentFrame() const;
+    // fences of the frames in flight, for resources which must outlive them
+    const std::vector<VkFence>& getInFlightFencesRef() const;
+    // the swap chain can still be presented to, but should be recreated when convenient
+    bool isSuboptimal() const;
+    // forget which frames used the images of the previous swap chain
+    void resetImagesInFlight(size_t imagesNum);
+    // wait for every frame in flight and continue with framesInFlight frames
+    void setFramesInFlight(const VkDevice& device, size_t framesInFlight);
+    size_t getFramesInFlight() const;
+    // time from beginFrame until the GPU had finished that frame, for the frame whose fence
+    // the last beginFrame waited on, negative if there was none
+    double getLastLatencyMs() const;
+    // upper bound of the frames processed concurrently, per frame resources are created for all of them
+    static constexpr size_t MAX_FRAMES_IN_FLIGHT = 3;
 private:
+    // submit without acquiring or presenting in headless mode
+    bool endFrameOffscreen(const VkDeviceManager& deviceManager, const VkCommandBuffer& commandBuffer);
+    // the image acquired by beginFrame
+    uint32_t imageIndex_m = 0;
     // an image has been acquired and is ready for rendering
     std::vector<VkSemaphore> imageAvailableSemaphores_m;
     // rendering has finished and presentation can happen
     std::vector<VkSemaphore> renderFinishedSemaphores_m;
     // to use the right pair of semaphores every time
     size_t currentFrame_m = 0;
+    size_t framesInFlight_m = 2;
+    // when beginFrame was called for each frame in flight and whether it was submitted since
+    std::vector<std::chrono::steady_clock::time_point> frameStartTimes_m;
+    std::vector<bool> framesPending_m;
+    double lastLatencyMs_m = -1.0;
     // for CPU-GPU synchronization
     std::vector<VkFence> inFlightFences_m;
     // wait on before a new frame can use that image
     std::vector<VkFence> imagesInFlight_m;
+    // the last acquire or present returned VK_SUBOPTIMAL_KHR
+    bool suboptimal_m = false;
+    // next offscreen image to render to (headless mode only)
+    uint32_t offscreenImageIndex_m = 0;
 };
\ No newline at end of file
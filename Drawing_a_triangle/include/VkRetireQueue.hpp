@@ -0,0 +1,30 @@
+#pragma once
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <vector>
+#include <deque>
+#include <functional>
+
+// defer the destruction of objects which may still be used by frames in flight
+// an object is destroyed once every fence given when it was retired has been seen signaled,
+// so nothing has to wait for the device to be idle
+class VkRetireQueue
+{
+public:
+    // fences : the fences of the frames which may use the object
+    void retire(const std::vector<VkFence>& fences, std::function<void(void)> destroy);
+    // destroy the objects which are no longer in use, never blocks
+    // call it while the retired fences are still alive
+    void collect(const VkDevice& device);
+    // destroy everything, the device must be idle
+    void flush();
+    size_t size() const;
+private:
+    struct Retired
+    {
+        // fences which have not been seen signaled yet
+        std::vector<VkFence> fences_m;
+        std::function<void(void)> destroy_m;
+    };
+    std::deque<Retired> retired_m;
+};
@@ -0,0 +1,58 @@
+#pragma once
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <vector>
+#include <cstdint>
+
+// read the interface of a shader from its SPIR-V binary, so the layouts of the pipelines
+// follow what the shaders declare instead of being written a second time on the C++ side
+// only the instructions describing the interface are decoded, the function bodies are skipped
+class VkShaderReflection
+{
+public:
+    // a vertex shader input, a matrix is reported as one input per column
+    struct Input
+    {
+        uint32_t location_m;
+        VkFormat format_m;
+    };
+    struct DescriptorBinding
+    {
+        uint32_t set_m;
+        uint32_t binding_m;
+        VkDescriptorType descriptorType_m;
+        // product of the array sizes, 1 for a single descriptor
+        uint32_t descriptorCount_m;
+        VkShaderStageFlags stageFlags_m;
+        // bytes of a uniform block, what its descriptor has to cover, 0 for the other descriptors
+        uint32_t blockSize_m = 0;
+    };
+    struct ShaderInterface
+    {
+        // the stages of the merged shaders
+        VkShaderStageFlags stageFlags_m = 0;
+        // only filled for a vertex shader, sorted by location
+        std::vector<Input> inputs_m;
+        // sorted by set, then by binding
+        std::vector<DescriptorBinding> descriptorBindings_m;
+        // size 0 when there is no push constant block
+        VkPushConstantRange pushConstantRange_m{};
+    };
+    // throw when code is not a valid SPIR-V module
+    static ShaderInterface reflect(const std::vector<char>& code);
+    // interface of a pipeline made of several stages, a binding declared by several stages
+    // is visible to all of them and the push constant range covers every block
+    // throw when the stages declare the same binding with different types
+    static ShaderInterface merge(const std::vector<ShaderInterface>& interfaces);
+    // SPIR-V cannot tell a dynamic uniform buffer from another one, the uniform buffers of set
+    // become UNIFORM_BUFFER_DYNAMIC before the layouts are created
+    static void setDynamicUniformBuffers(ShaderInterface& interface, uint32_t set);
+    // the bindings of one set
+    static std::vector<VkDescriptorSetLayoutBinding> getSetLayoutBindings(const ShaderInterface& interface,
+        uint32_t set);
+    // highest set + 1, 0 without descriptors
+    static uint32_t getSetCount(const ShaderInterface& interface);
+    // every input of the vertex shader is fed by one of the attributes
+    static bool isVertexInputCompatible(const ShaderInterface& interface,
+        const std::vector<VkVertexInputAttributeDescription>& attributeDescriptions);
+};
@@ -0,0 +1,68 @@
+#pragma once
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <vector>
+#include <mutex>
+#include <cstring>
+#include <VkDeviceManager.hpp>
+#include <VkMemoryAllocator.hpp>
+#include <VkLayoutCacheManager.hpp>
+#include <VkDescriptorAllocator.hpp>
+#include <VkShaderReflection.hpp>
+
+// per-frame uniform data written into a persistently mapped ring buffer
+// the ring has one region per frame in flight, a frame bump allocates from its own region
+// and the data is selected with dynamic offsets, so a single descriptor set serves every frame
+// and nothing is rewritten or reallocated while frames are in flight
+class VkUniformManager
+{
+public:
+    struct Allocation
+    {
+        // host address of the allocated range
+        void* mapped_m = nullptr;
+        // dynamic offset of the range, given to vkCmdBindDescriptorSets
+        uint32_t offset_m = 0;
+    };
+    // the uniform buffers of set in interface are dynamic, see VkShaderReflection::setDynamicUniformBuffers
+    // regionSize is rounded up to minUniformBufferOffsetAlignment
+    // the descriptor set is a persistent one of descriptorAllocator, it is released with the allocator
+    void createUniformManager(const VkDeviceManager& deviceManager, VkMemoryAllocator& memoryAllocator,
+        VkLayoutCacheManager& layoutCache, VkDescriptorAllocator& descriptorAllocator,
+        const VkShaderReflection::ShaderInterface& interface, uint32_t set,
+        size_t framesInFlight, VkDeviceSize regionSize = DEFAULT_REGION_SIZE);
+    void destroyUniformManager(VkMemoryAllocator& memoryAllocator);
+    // rewind the region of frameIndex, the fence of frameIndex must have been waited on
+    void beginFrame(size_t frameIndex);
+    // aligned to minUniformBufferOffsetAlignment, may be called from the recording threads
+    // throw when the region of the frame is full
+    Allocation allocate(VkDeviceSize size);
+    // copy data into the ring and return its dynamic offset
+    template <class T>
+    uint32_t push(const T& data)
+    {
+        auto allocation = allocate(sizeof(T));
+        std::memcpy(allocation.mapped_m, &data, sizeof(T));
+        return allocation.offset_m;
+    }
+    // the ring bound to every uniform buffer of the set, with the size of its block
+    const VkDescriptorSet& getDescriptorSetRef() const;
+    // bytes allocated in the current frame
+    VkDeviceSize getUsedBytes() const;
+
+    static constexpr VkDeviceSize DEFAULT_REGION_SIZE = 64 * 1024;
+private:
+    void createDescriptorSet(VkDescriptorAllocator& descriptorAllocator, const VkDescriptorSetLayout& setLayout,
+        const std::vector<VkShaderReflection::DescriptorBinding>& bindings);
+
+    VkDeviceSize alignment_m = 1;
+    VkDeviceSize regionSize_m = 0;
+    VkBuffer ringBuffer_m = VK_NULL_HANDLE;
+    VkMemoryAllocator::Allocation ringBufferAllocation_m;
+    // start and bump pointer of the region of the current frame
+    VkDeviceSize regionBegin_m = 0;
+    VkDeviceSize head_m = 0;
+    // the recording threads allocate concurrently
+    mutable std::mutex mutex_m;
+    VkDescriptorSet descriptorSet_m = VK_NULL_HANDLE;
+};
@@ -0,0 +1,114 @@
+#pragma once
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <VkDeviceManager.hpp>
+#include <VkMemoryAllocator.hpp>
+
+// copy data to device local buffers through a persistently mapped staging ring
+// requests are batched into one command buffer per processUploads call, and the ring space
+// of a batch is reclaimed once its fence has signaled, so nothing waits for the queue to be idle
+// with a dedicated transfer family the copies run on the transfer queue, the ownership of the
+// destinations is released there and acquired on the graphics queue after a semaphore
+class VkUploadManager
+{
+public:
+    // identifies a request, tickets increase in request order
+    using Ticket = uint64_t;
+    void createUploadManager(const VkDeviceManager& deviceManager, VkMemoryAllocator& memoryAllocator,
+        VkDeviceSize ringSize = DEFAULT_RING_SIZE, VkDeviceSize frameBudget = DEFAULT_FRAME_BUDGET);
+    void destroyUploadManager();
+    // data is read when the request is staged, it must stay valid until isUploadSubmitted returns true
+    // dstStage and dstAccess : how the buffer is used after the copy
+    // the range is handed over to the graphics queue, it must not be in use there until the upload completes
+    Ticket uploadBuffer(const void* data, VkDeviceSize size, const VkBuffer& dstBuffer, VkDeviceSize dstOffset,
+        VkPipelineStageFlags dstStage, VkAccessFlags dstAccess);
+    // stage pending requests up to the frame budget and submit them, never blocks
+    // call it once per frame before submitting the frame which uses the data
+    void processUploads();
+    // submit every pending request, waiting for ring space when needed (loading time)
+    void flush();
+    // commands submitted later on the graphics queue see the data
+    bool isUploadSubmitted(Ticket ticket) const;
+    // the GPU has finished the copy
+    bool isUploadComplete(Ticket ticket) const;
+
+    static constexpr VkDeviceSize DEFAULT_RING_SIZE = 16 * 1024 * 1024;
+    static constexpr VkDeviceSize DEFAULT_FRAME_BUDGET = 4 * 1024 * 1024;
+    // batches that may be in flight at the same time
+    static constexpr size_t MAX_BATCHES = 4;
+private:
+    struct Request
+    {
+        Ticket ticket_m;
+        const char* data_m;
+        VkDeviceSize size_m;
+        // bytes already staged, buffers may be split across batches
+        VkDeviceSize stagedSize_m = 0;
+        VkBuffer dstBuffer_m = VK_NULL_HANDLE;
+        VkDeviceSize dstOffset_m = 0;
+        VkPipelineStageFlags dstStage_m;
+        VkAccessFlags dstAccess_m;
+    };
+    struct Batch
+    {
+        // recorded for the transfer queue
+        VkCommandBuffer commandBuffer_m;
+        // acquire barriers for the graphics queue, only with a dedicated transfer family
+        VkCommandBuffer acquireCommandBuffer_m = VK_NULL_HANDLE;
+        // signaled by the copies, waited on by the acquire barriers
+        VkSemaphore semaphore_m = VK_NULL_HANDLE;
+        // stages which wait for the copies on the graphics queue
+        VkPipelineStageFlags acquireStages_m = 0;
+        // signaled once the data is visible on the graphics queue
+        VkFence fence_m;
+        bool inFlight_m = false;
+        // ring head after the batch was staged and bytes it consumed
+        VkDeviceSize ringEnd_m = 0;
+        VkDeviceSize ringBytes_m = 0;
+        // every request up to this ticket is complete when the batch is
+        Ticket lastTicket_m = 0;
+    };
+    // release the ring space of finished batches in submission order
+    void reclaimBatches();
+    // reserve size bytes of the ring, false if there is no room
+    bool allocateRing(VkDeviceSize size, VkDeviceSize& offset, VkDeviceSize& consumed);
+    // record as many pending requests as the budget and the ring allow into batch
+    // return the number of bytes staged
+    VkDeviceSize stageRequests(Batch& batch, VkDeviceSize budget);
+    void recordBufferCopy(Batch& batch, const Request& request, VkDeviceSize ringOffset, VkDeviceSize size);
+    // begin the command buffers of batch
+    void beginBatch(Batch& batch);
+    void submitBatch(Batch& batch);
+
+    const VkDeviceManager* deviceManager_m = nullptr;
+    VkMemoryAllocator* memoryAllocator_m = nullptr;
+    // transfer family pool
+    VkCommandPool commandPool_m = VK_NULL_HANDLE;
+    // graphics family pool for the acquire barriers
+    VkCommandPool acquirePool_m = VK_NULL_HANDLE;
+    uint32_t transferFamily_m = 0;
+    uint32_t graphicsFamily_m = 0;
+    // the transfer family is not the graphics family, ownership has to be transferred
+    bool ownershipTransfer_m = false;
+    VkBuffer ringBuffer_m = VK_NULL_HANDLE;
+    VkMemoryAllocator::Allocation ringAllocation_m;
+    VkDeviceSize ringSize_m = 0;
+    VkDeviceSize frameBudget_m = 0;
+    // staged data is written at head and released from tail
+    VkDeviceSize ringHead_m = 0;
+    VkDeviceSize ringTail_m = 0;
+    // bytes between tail and head including the padding skipped when wrapping
+    VkDeviceSize ringUsed_m = 0;
+    // in submission order
+    std::vector<Batch> batches_m;
+    size_t nextBatch_m = 0;
+    std::deque<Request> requests_m;
+    Ticket nextTicket_m = 1;
+    Ticket submittedTicket_m = 0;
+    Ticket completedTicket_m = 0;
+    // requests may come from loading threads
+    mutable std::mutex mutex_m;
+};
@@ -3,34 +3,123 @@
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
 #include <vector>
+#include <string>
 #include <array>
 #include <VkDeviceManager.hpp>
+#include <VkMemoryAllocator.hpp>
+#include <VkUploadManager.hpp>
+#include <MeshFile.hpp>
+#include <MeshVertices.hpp>
+#include <VertexQuantizer.hpp>
+#include <VertexLayout.hpp>
 
 class VkVertexManager
 {
 public:
-    struct Vertex
+    // how the vertices of a mesh are stored, selected per mesh
+    enum class VertexFormat
     {
-        glm::vec2 position_m;
-        glm::vec3 color_m;
-        static VkVertexInputBindingDescription getBindingDescription();
-        static std::array<VkVertexInputAttributeDescription, 2>
-            getAttributeDescriptions();
+        // Vertex, 20 bytes
+        FLOAT,
+        // QuantizedVertex, 8 bytes
+        QUANTIZED
     };
-    void createVerticesData();
-    void createVertexBuffer(const VkDeviceManager& deviceManager, VkCommandPool& commandPool);
-    void destroyVertexBuffer(const VkDevice& device);
+    // the formats tools/obj2mesh writes, see MeshVertices.hpp
+    using Vertex = MeshVertex;
+    // positions relative to the bounds of the mesh, see getDequantizationMatrix
+    using QuantizedVertex = QuantizedMeshVertex;
+    // per-instance data, read by the vertex shader once per instance
+    struct Instance
+    {
+        // a mat4 attribute takes four locations, one per column
+        glm::mat4 model_m;
+        glm::vec4 color_m;
+    };
+    // vertex input of the pipeline of each vertex format, generated from the VertexLayout
+    // specializations below, binding 0 is read per vertex and binding 1 per instance
+    using FloatVertexInput = VertexInput<Vertex, Instance>;
+    using QuantizedVertexInput = VertexInput<QuantizedVertex, Instance>;
+    // the triangle list is indexed and optimized with optimizeMesh, then encoded in format
+    void createVerticesData(VertexFormat format = VertexFormat::FLOAT);
+    // map a mesh file written by tools/obj2mesh, its vertices must have the layout of Vertex or QuantizedVertex
+    // the file is already optimized, the blobs are uploaded as they are
+    // float vertices are encoded on load when format is QUANTIZED, quantized files stay quantized
+    void loadMesh(const std::string& path, VertexFormat format = VertexFormat::FLOAT);
+    // the vertices and indices are copied by the upload manager, they must outlive the upload
+    void createVertexBuffer(VkMemoryAllocator& memoryAllocator, VkUploadManager& uploadManager);
+    // drop the CPU copy of the mesh once the upload has been submitted
+    void releaseVerticesData();
+    void destroyVertexBuffer(VkMemoryAllocator& memoryAllocator);
+    // device local buffer with one region of maxInstanceCount instances per frame in flight,
+    // persistently mapped when such memory is host visible, written through the staging ring otherwise
+    void createInstanceBuffer(VkMemoryAllocator& memoryAllocator, size_t maxInstanceCount, size_t framesInFlight);
+    void destroyInstanceBuffer(VkMemoryAllocator& memoryAllocator);
+    // write the instances of a frame, the fence of frameIndex must have been waited on
+    // the copy through the staging ring is submitted before returning
+    void updateInstances(VkUploadManager& uploadManager, size_t frameIndex, const std::vector<Instance>& instances);
     VkBuffer& getVertexBufferRef();
+    VkBuffer& getIndexBufferRef();
+    VkBuffer& getInstanceBufferRef();
+    // offset of the region of frameIndex in the instance buffer
+    VkDeviceSize getInstanceBufferOffset(size_t frameIndex) const;
+    // FloatVertexInput or QuantizedVertexInput, following the format of the mesh
+    std::vector<VkVertexInputBindingDescription> getBindingDescriptions() const;
+    std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions() const;
+    VertexFormat getVertexFormat() const;
+    // from the stored positions to model space, applied before the instance transform
+    // identity for float vertices
+    glm::mat4 getDequantizationMatrix() const;
+    // 16-bit indices when every vertex can be addressed with them
+    VkIndexType getIndexType() const;
     size_t getVerticesSize();
+    size_t getIndicesSize();
+    // sphere around every vertex in the space of the stored positions, xyz center and w radius
+    glm::vec4 getBoundingSphere() const;
 private:
-    void createBuffer(const VkDevice& device, const VkPhysicalDevice& physicalDevice, VkDeviceSize size, 
-        VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory);
-    void fillVertexBuffer(const VkDevice& device);
-    void copyBuffer(const VkDevice& device, VkCommandPool& commandPool, const VkQueue& graphicsQueue, 
-        VkBuffer& srcBuffer, VkBuffer& dstBuffer, VkDeviceSize size);
+    // sphere around vertices_m
+    void computeBoundingSphere();
+    // encode vertexCount vertices into quantizedVertices_m and move the bounding sphere to their space
+    void quantizeVertices(const Vertex* vertices, size_t vertexCount);
+    // replace the unindexed triangle list in vertices_m by unique vertices and indices
+    // ordered for the post-transform cache and then for vertex fetch
+    void optimizeMesh();
     // use exactly the same position and color values as the shader file
     std::vector<Vertex> vertices_m;
+    std::vector<uint32_t> indices_m;
+    // indices_m narrowed when indexType_m is VK_INDEX_TYPE_UINT16
+    std::vector<uint16_t> indices16_m;
+    VkIndexType indexType_m = VK_INDEX_TYPE_UINT32;
+    VertexFormat vertexFormat_m = VertexFormat::FLOAT;
+    std::vector<QuantizedVertex> quantizedVertices_m;
+    VertexQuantizer::Dequantization dequantization_m;
+    // mapped mesh file, the vectors above stay empty when it is used
+    MeshFile meshFile_m;
+    // what is uploaded, in the vectors or in the mapping
+    const void* vertexData_m = nullptr;
+    VkDeviceSize vertexDataSize_m = 0;
+    const void* indexData_m = nullptr;
+    VkDeviceSize indexDataSize_m = 0;
+    size_t vertexCount_m = 0;
+    size_t indexCount_m = 0;
+    glm::vec4 boundingSphere_m = glm::vec4(0.0f);
     // handle of the vertex buffer
     VkBuffer vertexBuffer_m;
-    VkDeviceMemory vertexBufferMemory_m;    
-};
\ No newline at end of file
+    // sub-allocated range of a larger memory block
+    VkMemoryAllocator::Allocation vertexBufferAllocation_m;
+    VkBuffer indexBuffer_m;
+    VkMemoryAllocator::Allocation indexBufferAllocation_m;
+    VkBuffer instanceBuffer_m = VK_NULL_HANDLE;
+    VkMemoryAllocator::Allocation instanceBufferAllocation_m;
+    size_t maxInstanceCount_m = 0;
+};
+
+template <>
+struct VertexLayout<VkVertexManager::Instance>
+{
+    static constexpr VkVertexInputRate INPUT_RATE = VK_VERTEX_INPUT_RATE_INSTANCE;
+    static constexpr std::array<VertexMember, 2> MEMBERS =
+    {
+        VERTEX_MEMBER(VkVertexManager::Instance, model_m),
+        VERTEX_MEMBER(VkVertexManager::Instance, color_m)
+    };
+};
@@ -6,13 +6,32 @@
 #include <vector>
 #include <Application.hpp>
 #include <memory>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <set>
+#include <thread>
+#include <condition_variable>
+#include <exception>
+#include <numeric>
+#include <limits>
 
 constexpr uint32_t WIDTH = 800;
 constexpr uint32_t HEIGHT = 600;
+// per frame resources are created for this many frames rather than for the frames in flight
+// of the current present profile, the profiles may switch to more frames in flight at runtime
+constexpr size_t FRAME_RESOURCE_COUNT = VkRenderer::MAX_FRAMES_IN_FLIGHT;
+// resize events closer together than this are handled by a single swap chain recreation
+constexpr auto RESIZE_SETTLE_TIME = std::chrono::milliseconds(100);
 
 // init app's information variables
-Application::Application() : deviceManager_m(), swapChainManager_m(getDeviceManagerRef(), window_m)
+Application::Application(const Settings& settings) : settings_m(settings),
+    threadPool_m(settings.recordThreadCount_m), deviceManager_m(settings.headless_m), swapChainManager_m(getDeviceManagerRef(), window_m, memoryAllocator_m)
 {
+    presentProfile_m = requestedPresentProfile_m =
+        std::min(settings.presentProfile_m, VkPresentProfile::getProfiles().size() - 1);
+    presentStatistics_m.resize(VkPresentProfile::getProfiles().size());
+    pipelineVariant_m.blendMode_m = settings.blendMode_m;
     validationLayers_m = {
     "VK_LAYER_KHRONOS_validation"
     };
@@ -25,14 +44,25 @@ Application::Application() : deviceManager_m(), swapChainManager_m(getDeviceMana
 
 void Application::run()
 {
+    auto start = std::chrono::steady_clock::now();
     initWindow();
     initVulkan();
+    startupMs_m = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "startup : " << startupMs_m << " ms" << std::endl;
+    if (settings_m.watchShaders_m)
+        startShaderWatcher();
     mainLoop();
     cleanup();
+    // reported after cleanup so that a failed check still releases everything
+    if (!benchmarkPassed_m)
+        throw std::runtime_error("benchmark regressed against the baseline!");
 }
 // init GLFW, create  window
 void Application::initWindow()
 {
+    // nothing to show
+    if (settings_m.headless_m)
+        return;
     glfwInit();
     // disable openGL
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
@@ -43,59 +73,572 @@ void Application::initWindow()
     // handle framebuffer resizes
     glfwSetWindowUserPointer(window_m, this);
     glfwSetFramebufferSizeCallback(window_m, framebufferResizeCallback);
+    glfwSetKeyCallback(window_m, keyCallback);
 }
 // init validation layer, instance
 void Application::initVulkan()
 {
+    initStageGraph();
     initCreateFunctions();
-    // initDestroyFunctions();
-    execFunctionsSequence(createFunctions_m);
+    initDestroyFunctions();
+    // the independent stages overlap, most of the startup is spent waiting on the driver and the disk
+    ThreadPool initThreadPool(std::thread::hardware_concurrency());
+    createStages({}, &initThreadPool);
+    memoryAllocator_m.printStatistics();
 }
 
-void Application::execFunctionsSequence
-    (const std::vector<VkStageFunc>& targetFuncs, const std::vector<VkStage>& stages)
+const Application::VkStageFunc* Application::findStageFunc
+    (const std::vector<VkStageFunc>& targetFuncs, VkStage stage)
 {
-    // execute all create functions
-    if(stages.size() == 0)
-        for(const auto& func : targetFuncs)
-            func.func_m();
-    // execute specified create functions
-    else {
-        auto cursor = targetFuncs.begin();
-        for(const auto& stage : stages) {
-            // dont exceed the end of the function list
-            while(cursor != targetFuncs.end() && stage != cursor->stage_m) 
-                cursor++;
-            if (cursor == targetFuncs.end())
-                std::runtime_error("there is an invalid stage or dependency problem.");
-            else 
-                cursor->func_m();
+    auto func = std::find_if(targetFuncs.begin(), targetFuncs.end(),
+        [stage](const auto& func) { return func.stage_m == stage; });
+    return func == targetFuncs.end() ? nullptr : &*func;
+}
+
+std::vector<Application::VkStage> Application::sortStages(const std::vector<VkStage>& stages) const
+{
+    std::set<VkStage> remaining;
+    for (const auto& func : createFunctions_m)
+        if (stages.empty() || std::find(stages.begin(), stages.end(), func.stage_m) != stages.end())
+            remaining.insert(func.stage_m);
+    if (!stages.empty() && remaining.size() != std::set<VkStage>(stages.begin(), stages.end()).size())
+        throw std::runtime_error("there is an invalid stage or dependency problem.");
+    // the needed stages which are not sorted are assumed to exist already
+    auto isReady = [&](VkStage stage)
+        {
+            auto node = stageGraph_m.find(stage);
+            if (node == stageGraph_m.end())
+                return true;
+            for (const auto& needed : {node->second.dependencies_m, node->second.reads_m})
+                for (const auto& neededStage : needed)
+                    if (remaining.count(neededStage) != 0)
+                        return false;
+            return true;
+        };
+    std::vector<VkStage> order;
+    while (!remaining.empty()) {
+        // the first ready stage in declaration order keeps the order stable
+        auto ready = std::find_if(remaining.begin(), remaining.end(), isReady);
+        if (ready == remaining.end())
+            throw std::runtime_error("there is an invalid stage or dependency problem.");
+        order.push_back(*ready);
+        remaining.erase(ready);
+    }
+    return order;
+}
+
+std::vector<Application::VkStage> Application::getDependentStages(const std::vector<VkStage>& stages) const
+{
+    std::set<VkStage> dependents(stages.begin(), stages.end());
+    // walk the dependency edges backwards until nothing is added
+    for (bool added = true; added;) {
+        added = false;
+        for (const auto& node : stageGraph_m) {
+            if (dependents.count(node.first) != 0 || findStageFunc(createFunctions_m, node.first) == nullptr)
+                continue;
+            for (const auto& dependency : node.second.dependencies_m)
+                if (dependents.count(dependency) != 0) {
+                    dependents.insert(node.first);
+                    added = true;
+                    break;
+                }
+        }
+    }
+    return {dependents.begin(), dependents.end()};
+}
+
+void Application::createStages(const std::vector<VkStage>& stages, ThreadPool* threadPool)
+{
+    auto order = sortStages(stages);
+    if (threadPool == nullptr) {
+        for (const auto& stage : order)
+            findStageFunc(createFunctions_m, stage)->func_m();
+        return;
+    }
+    std::mutex mutex;
+    std::condition_variable stageFinished;
+    // stages of this call which have not finished, or not started
+    std::set<VkStage> unfinished(order.begin(), order.end());
+    std::set<VkStage> unstarted = unfinished;
+    size_t runningCount = 0;
+    std::exception_ptr exception;
+    auto isReady = [&](VkStage stage)
+        {
+            auto node = stageGraph_m.find(stage);
+            if (node == stageGraph_m.end())
+                return true;
+            for (const auto& needed : {node->second.dependencies_m, node->second.reads_m})
+                for (const auto& neededStage : needed)
+                    if (unfinished.count(neededStage) != 0)
+                        return false;
+            return true;
+        };
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!unfinished.empty() && !(exception && runningCount == 0)) {
+        // after a failure nothing new is started, the running stages are waited for
+        bool ranOnMainThread = false;
+        for (auto stage = unstarted.begin(); !exception && stage != unstarted.end();) {
+            if (!isReady(*stage)) {
+                stage++;
+                continue;
+            }
+            auto func = findStageFunc(createFunctions_m, *stage);
+            auto node = stageGraph_m.find(*stage);
+            auto readyStage = *stage;
+            stage = unstarted.erase(stage);
+            if (node != stageGraph_m.end() && node->second.mainThread_m) {
+                lock.unlock();
+                try {
+                    func->func_m();
+                } catch (...) {
+                    lock.lock();
+                    exception = std::current_exception();
+                    break;
+                }
+                lock.lock();
+                unfinished.erase(readyStage);
+                // other stages may have become ready
+                ranOnMainThread = true;
+                break;
+            }
+            runningCount++;
+            threadPool->submit([&, func, readyStage]()
+                {
+                    std::exception_ptr stageException;
+                    try {
+                        func->func_m();
+                    } catch (...) {
+                        stageException = std::current_exception();
+                    }
+                    std::lock_guard<std::mutex> stageLock(mutex);
+                    if (stageException && !exception)
+                        exception = stageException;
+                    unfinished.erase(readyStage);
+                    runningCount--;
+                    // notified under the lock, the caller may return as soon as it is released
+                    stageFinished.notify_all();
+                });
         }
+        if (ranOnMainThread || (exception && runningCount == 0))
+            continue;
+        if (runningCount == 0)
+            throw std::runtime_error("there is an invalid stage or dependency problem.");
+        stageFinished.wait(lock);
+    }
+    if (exception)
+        std::rethrow_exception(exception);
+}
+
+void Application::destroyStages(const std::vector<VkStage>& stages, bool retire)
+{
+    auto order = sortStages(stages);
+    // the reverse of a creation order destroys every stage before the ones it needs
+    for (auto stage = order.rbegin(); stage != order.rend(); stage++) {
+        auto func = retire ? findStageFunc(retireFunctions_m, *stage) : nullptr;
+        if (func == nullptr)
+            func = findStageFunc(destroyFunctions_m, *stage);
+        // some stages only produce CPU data
+        if (func != nullptr)
+            func->func_m();
     }
 }
 
 void Application::mainLoop()
 {
+    if (settings_m.headless_m) {
+        runHeadlessFrames();
+        return;
+    }
+    std::cout << "keys 1-" << VkPresentProfile::getProfiles().size() << " : switch the present profile" << std::endl;
+    std::cout << "key B : switch the blend mode" << std::endl;
+    presentProfileStartTime_m = std::chrono::steady_clock::now();
     while (!glfwWindowShouldClose(window_m)){
         glfwPollEvents();
-        bool swapChainUpToDate = renderer_m.drawFrame
-        (
-            getDeviceManagerRef(),
-            swapChainManager_m.getSwapChainRef(),
-            commandManager_m.getCommandBufferRef()
-        );
-        if(!swapChainUpToDate)
+        if (requestedPresentProfile_m != presentProfile_m)
+            switchPresentProfile(requestedPresentProfile_m);
+        bool swapChainUpToDate = drawFrame();
+        auto& statistics = presentStatistics_m[presentProfile_m];
+        statistics.frameCount_m++;
+        auto latencyMs = renderer_m.getLastLatencyMs();
+        if (latencyMs >= 0.0) {
+            statistics.latencyMs_m.push_back(latencyMs);
+            if (statistics.latencyMs_m.size() > VkProfiler::ROLLING_WINDOW)
+                statistics.latencyMs_m.pop_front();
+        }
+        if (renderer_m.isSuboptimal() && !resizePending_m) {
+            resizePending_m = true;
+            lastResizeTime_m = std::chrono::steady_clock::now();
+        }
+        // an out of date swap chain cannot be presented to anymore, so it is recreated at once
+        // otherwise the swap chain is only recreated after the window has stopped resizing
+        bool resizeSettled = resizePending_m &&
+            std::chrono::steady_clock::now() - lastResizeTime_m >= RESIZE_SETTLE_TIME;
+        if(!swapChainUpToDate || resizeSettled)
             recreateSwapChain();
     }
     // wait for the logical device to finish operations 
     // before exiting mainLoop and destroying the windwo
     vkDeviceWaitIdle(deviceManager_m.getDevice());
+    presentStatistics_m[presentProfile_m].elapsedSec_m +=
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - presentProfileStartTime_m).count();
+    commandManager_m.printRecordingStatistics();
+    profiler_m.printStatistics();
+    printPresentStatistics();
+    graphicsPipeline_m.printStatistics();
+    descriptorAllocator_m.printStatistics();
+}
+
+void Application::switchPresentProfile(size_t profileIndex)
+{
+    presentStatistics_m[presentProfile_m].elapsedSec_m +=
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - presentProfileStartTime_m).count();
+    const auto& profile = VkPresentProfile::getProfiles()[profileIndex];
+    const auto& device = deviceManager_m.getDevice();
+    renderer_m.setFramesInFlight(device, profile.framesInFlight_m);
+    // the frames in flight are renumbered, so the pending timestamps are read back now
+    profiler_m.collectPendingResults(device);
+    presentProfile_m = profileIndex;
+    // the present mode and the image count belong to the swap chain
+    recreateSwapChain();
+    std::cout << "present profile : " << profile.name_m << ", " << profile.framesInFlight_m
+        << " frames in flight" << std::endl;
+    presentProfileStartTime_m = std::chrono::steady_clock::now();
+}
+
+void Application::printPresentStatistics() const
+{
+    const auto& profiles = VkPresentProfile::getProfiles();
+    std::cout << "present profiles :" << std::endl;
+    for (size_t i = 0; i < profiles.size(); i++) {
+        const auto& statistics = presentStatistics_m[i];
+        if (statistics.frameCount_m == 0)
+            continue;
+        std::cout << profiles[i].name_m << " : " << statistics.frameCount_m << " frames, "
+            << statistics.frameCount_m / statistics.elapsedSec_m << " frames/sec" << std::endl;
+        // present completion is not observable, the fence of the frame is the closest point
+        VkProfiler::printStatistics("input to GPU completion",
+            VkProfiler::computeStatistics({statistics.latencyMs_m.begin(), statistics.latencyMs_m.end()}));
+    }
+}
+
+bool Application::drawFrame()
+{
+    // streamed data is submitted before the frame which uses it
+    uploadManager_m.processUploads();
+    // destroy the retired swap chain resources whose frames have finished
+    retireQueue_m.collect(deviceManager_m.getDevice());
+    // a frame boundary, nothing is being recorded
+    swapReloadedPipelines();
+    uint32_t imageIndex;
+    if (!renderer_m.beginFrame(getDeviceManagerRef(), swapChainManager_m.getSwapChainRef(), imageIndex))
+        return false;
+    // the instance region and the command buffer of this frame in flight are no longer in use
+    updateInstances();
+    VkCommandManager::GeometryBuffers geometry{};
+    geometry.vertexBuffer_m = vertexManager_m.getVertexBufferRef();
+    geometry.indexBuffer_m = vertexManager_m.getIndexBufferRef();
+    geometry.indexType_m = vertexManager_m.getIndexType();
+    geometry.instanceBuffer_m = vertexManager_m.getInstanceBufferRef();
+    geometry.instanceOffset_m = vertexManager_m.getInstanceBufferOffset(renderer_m.getCurrentFrame());
+    // the ring region and the frame descriptor sets of this frame in flight are no longer read either
+    uniformManager_m.beginFrame(renderer_m.getCurrentFrame());
+    descriptorAllocator_m.beginFrame(renderer_m.getCurrentFrame());
+    if (settings_m.gpuCulling_m)
+        cullingManager_m.beginFrame(descriptorAllocator_m, vertexManager_m.getInstanceBufferRef(),
+            renderer_m.getCurrentFrame());
+    CameraUniforms camera{computeViewProjection()};
+    // the culling shader appends the visible draws in no particular order, only the CPU list can be sorted
+    // blended draws keep the order they were submitted in
+    if (!settings_m.gpuCulling_m && pipelineVariant_m.blendMode_m == VkGraphicsPipelineFactory::BlendMode::OPAQUE)
+        sortDrawCalls(camera.viewProjection_m);
+    writeInstances();
+    geometry.pipelineLayout_m = graphicsPipeline_m.getPipelineLayoutRef();
+    geometry.uniformSet_m = uniformManager_m.getDescriptorSetRef();
+    geometry.dynamicOffsets_m = {uniformManager_m.push(camera)};
+    cullingManager_m.setViewProjection(camera.viewProjection_m);
+    geometry.setDrawData(drawData_m);
+    geometry.pushConstantRange_m = graphicsPipeline_m.getShaderInterfaceRef().pushConstantRange_m;
+    if (drawDataInUniform_m) {
+        drawUniformManager_m.beginFrame(renderer_m.getCurrentFrame());
+        geometry.drawRing_m = &drawUniformManager_m;
+        geometry.drawSet_m = drawUniformManager_m.getDescriptorSetRef();
+    }
+    const auto& commandBuffer = commandManager_m.recordCommandBuffer
+    (
+        deviceManager_m.getDevice(),
+        threadPool_m,
+        profiler_m,
+        renderer_m.getCurrentFrame(),
+        graphicsPipeline_m.getRenderPassRef(),
+        framebufferFactory_m.getSwapChainFrameBuffersRef()[imageIndex],
+        graphicsPipeline_m.getGraphicsPipelineRef(pipelineVariant_m),
+        swapChainManager_m.getSwapChainExtentRef(),
+        geometry,
+        drawCalls_m,
+        settings_m.gpuCulling_m ? &cullingManager_m : nullptr
+    );
+    return renderer_m.endFrame(getDeviceManagerRef(), swapChainManager_m.getSwapChainRef(), commandBuffer);
+}
+
+void Application::startShaderWatcher()
+{
+    // the same sources and outputs as compile.sh
+    std::vector<ShaderWatcher::Shader> shaders =
+    {
+        {"./src/shader/shader.vert", "./spv/vert.spv"},
+        {"./src/shader/shader.vert", "./spv/vert_draw_uniform.spv", "-DDRAW_DATA_UNIFORM"},
+        {"./src/shader/shader.frag", "./spv/frag.spv"}
+    };
+    if (settings_m.gpuCulling_m)
+        shaders.push_back({"./src/shader/cull.comp", "./spv/cull.spv"});
+    shaderWatcher_m.start(shaders, settings_m.shaderCompilerPath_m,
+        [this](const std::vector<std::string>& outputs) { rebuildPipelines(outputs); });
+    std::cout << "watching ./src/shader, the pipelines are rebuilt when a shader is saved" << std::endl;
+}
+
+void Application::rebuildPipelines(const std::vector<std::string>& outputs)
+{
+    auto changed = [&](const char* output)
+        { return std::find(outputs.begin(), outputs.end(), output) != outputs.end(); };
+    std::lock_guard<std::mutex> buildLock(pipelineBuildMutex_m);
+    const auto& device = deviceManager_m.getDevice();
+    // a failed build keeps the current pipeline, the error is reported and the next save retries
+    if (changed(graphicsPipeline_m.getVertShaderPathRef().c_str()) || changed("./spv/frag.spv")) {
+        try {
+            // every variant compiled so far
+            auto pipelines = graphicsPipeline_m.buildGraphicsPipelines();
+            std::lock_guard<std::mutex> lock(reloadMutex_m);
+            // built by a previous save and never used
+            VkGraphicsPipelineFactory::destroyPipelineSet(device, reloadedGraphicsPipelines_m);
+            reloadedGraphicsPipelines_m = std::move(pipelines);
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+        }
+    }
+    if (settings_m.gpuCulling_m && changed("./spv/cull.spv")) {
+        try {
+            auto pipeline = cullingManager_m.buildComputePipeline(device,
+                pipelineCacheManager_m.getPipelineCacheRef(), layoutCacheManager_m);
+            std::lock_guard<std::mutex> lock(reloadMutex_m);
+            if (reloadedComputePipeline_m != VK_NULL_HANDLE)
+                vkDestroyPipeline(device, reloadedComputePipeline_m, nullptr);
+            reloadedComputePipeline_m = pipeline;
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+        }
+    }
+}
+
+void Application::swapReloadedPipelines()
+{
+    VkGraphicsPipelineFactory::PipelineSet graphicsPipelines;
+    VkPipeline computePipeline;
+    {
+        std::lock_guard<std::mutex> lock(reloadMutex_m);
+        graphicsPipelines = std::move(reloadedGraphicsPipelines_m);
+        reloadedGraphicsPipelines_m.variants_m.clear();
+        computePipeline = reloadedComputePipeline_m;
+        reloadedComputePipeline_m = VK_NULL_HANDLE;
+    }
+    // the frames in flight may still use the old pipelines
+    const auto& device = deviceManager_m.getDevice();
+    const auto& inFlightFences = renderer_m.getInFlightFencesRef();
+    if (!graphicsPipelines.variants_m.empty()) {
+        auto variantCount = graphicsPipelines.variants_m.size();
+        graphicsPipeline_m.replaceGraphicsPipelines(graphicsPipelines, retireQueue_m, inFlightFences);
+        std::cout << "graphics pipelines reloaded (" << variantCount << " variants)" << std::endl;
+    }
+    if (computePipeline != VK_NULL_HANDLE) {
+        cullingManager_m.replaceComputePipeline(device, computePipeline, retireQueue_m, inFlightFences);
+        std::cout << "culling pipeline reloaded" << std::endl;
+    }
+}
+
+void Application::createDrawCalls()
+{
+    auto indexCount = static_cast<uint32_t>(vertexManager_m.getIndicesSize());
+    auto instanceCount = static_cast<uint32_t>(instances_m.size());
+    // every instance is drawn once, a draw call takes a contiguous range of them
+    auto drawCount = std::max(1u, std::min(settings_m.drawCount_m, instanceCount));
+    drawCalls_m.clear();
+    for (uint32_t i = 0; i < drawCount; i++) {
+        auto firstInstance = instanceCount * i / drawCount;
+        auto lastInstance = instanceCount * (i + 1) / drawCount;
+        // indexCount, instanceCount, firstIndex, vertexOffset, firstInstance
+        drawCalls_m.push_back(VkCommandManager::DrawCall{indexCount, lastInstance - firstInstance, 0, 0,
+            firstInstance});
+    }
+    // the draws share their data, so it is only pushed once per command buffer
+    drawData_m.assign(drawCalls_m.size(), DrawData{glm::mat4(1.0f), glm::vec4(1.0f)});
+}
+
+void Application::createInstances()
+{
+    auto instanceCount = std::max(1u, settings_m.instanceCount_m);
+    // the smallest square grid holding every instance, in normalized device coordinates
+    auto columns = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(instanceCount))));
+    auto rows = (instanceCount + columns - 1) / columns;
+    auto cellSize = 2.0f / static_cast<float>(columns);
+    // the triangle spans one unit, it overlaps its neighbours so that the depth test has work to do
+    instanceScale_m = instanceCount == 1 ? cellSize * 0.9f : cellSize * 1.5f;
+    instances_m.resize(instanceCount);
+    instanceCenters_m.resize(instanceCount);
+    orderedInstances_m.resize(instanceCount);
+    instanceOrder_m.resize(instanceCount);
+    std::iota(instanceOrder_m.begin(), instanceOrder_m.end(), 0);
+    for (uint32_t i = 0; i < instanceCount; i++) {
+        auto column = i % columns;
+        auto row = i / columns;
+        // every instance at its own depth in [0.1, 0.9], the last ones in front, so that the
+        // submission order is back to front until sortDrawCalls reverses it
+        instanceCenters_m[i] = glm::vec3(-1.0f + cellSize * (column + 0.5f),
+            -1.0f + cellSize * (row + 0.5f) + (columns - rows) * cellSize * 0.5f,
+            0.9f - 0.8f * (static_cast<float>(i) + 0.5f) / static_cast<float>(instanceCount));
+        // spread the hues so that neighbours differ
+        auto hue = static_cast<float>(i) / static_cast<float>(instanceCount);
+        instances_m[i].color_m = glm::vec4(
+            0.5f + 0.5f * std::cos(6.2831853f * hue),
+            0.5f + 0.5f * std::cos(6.2831853f * (hue - 1.0f / 3.0f)),
+            0.5f + 0.5f * std::cos(6.2831853f * (hue - 2.0f / 3.0f)),
+            1.0f);
+    }
+    // a single instance keeps the plain triangle colors
+    if (instanceCount == 1)
+        instances_m[0].color_m = glm::vec4(1.0f);
+    animationFrame_m = 0;
+}
+
+void Application::updateInstances()
+{
+    // quantized positions are brought back to model space by the model matrix
+    auto dequantization = vertexManager_m.getDequantizationMatrix();
+    for (size_t i = 0; i < instances_m.size(); i++) {
+        // alternate the direction, a single instance stays still
+        auto angle = instances_m.size() == 1 ? 0.0f :
+            static_cast<float>(animationFrame_m) * 0.01f * (i % 2 == 0 ? 1.0f : -1.0f);
+        auto c = instanceScale_m * std::cos(angle);
+        auto s = instanceScale_m * std::sin(angle);
+        // column major, rotation and scale in the xy plane followed by the translation
+        auto& model = instances_m[i].model_m;
+        model[0] = glm::vec4(c, s, 0.0f, 0.0f);
+        model[1] = glm::vec4(-s, c, 0.0f, 0.0f);
+        model[2] = glm::vec4(0.0f, 0.0f, 1.0f, 0.0f);
+        model[3] = glm::vec4(instanceCenters_m[i], 1.0f);
+        model = model * dequantization;
+    }
+    animationFrame_m++;
+}
+
+void Application::writeInstances()
+{
+    for (size_t i = 0; i < instanceOrder_m.size(); i++)
+        orderedInstances_m[i] = instances_m[instanceOrder_m[i]];
+    vertexManager_m.updateInstances(uploadManager_m, renderer_m.getCurrentFrame(), orderedInstances_m);
+}
+
+void Application::sortDrawCalls(const glm::mat4& viewProjection)
+{
+    // depths are measured at the center of the mesh
+    auto sphere = vertexManager_m.getBoundingSphere();
+    glm::vec4 center(sphere.x, sphere.y, sphere.z, 1.0f);
+    std::vector<float> instanceDepths(instances_m.size());
+    auto nearer = [&instanceDepths](uint32_t a, uint32_t b) { return instanceDepths[a] < instanceDepths[b]; };
+    std::vector<float> depths(drawCalls_m.size());
+    for (size_t i = 0; i < drawCalls_m.size(); i++) {
+        auto transform = viewProjection * drawData_m[i].transform_m;
+        const auto& drawCall = drawCalls_m[i];
+        auto first = instanceOrder_m.begin() + drawCall.firstInstance_m;
+        auto last = first + drawCall.instanceCount_m;
+        for (auto instance = first; instance != last; ++instance) {
+            auto clip = transform * instances_m[*instance].model_m * center;
+            instanceDepths[*instance] = clip.w > 0.0f ? clip.z / clip.w : clip.z;
+        }
+        // the instances of a draw are rasterized in their order in the instance buffer,
+        // so the range of the draw is sorted as well, which is all there is to sort with a single draw
+        // the order of the last frame usually holds
+        if (!std::is_sorted(first, last, nearer))
+            std::stable_sort(first, last, nearer);
+        // the depth of a draw call is the one of its nearest instance
+        depths[i] = first == last ? std::numeric_limits<float>::max() : instanceDepths[*first];
+    }
+    if (std::is_sorted(depths.begin(), depths.end()))
+        return;
+    std::vector<size_t> order(drawCalls_m.size());
+    std::iota(order.begin(), order.end(), 0);
+    // equal depths keep their order
+    std::stable_sort(order.begin(), order.end(),
+        [&depths](size_t a, size_t b) { return depths[a] < depths[b]; });
+    std::vector<VkCommandManager::DrawCall> drawCalls(order.size());
+    std::vector<DrawData> drawData(order.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        drawCalls[i] = drawCalls_m[order[i]];
+        drawData[i] = drawData_m[order[i]];
+    }
+    drawCalls_m = std::move(drawCalls);
+    drawData_m = std::move(drawData);
+}
+
+glm::mat4 Application::computeViewProjection() const
+{
+    // orthographic, the shorter side of the swap chain covers [-1, 1] and the longer one shows more
+    const auto& extent = swapChainManager_m.getSwapChainExtentRef();
+    auto width = static_cast<float>(std::max(extent.width, 1u));
+    auto height = static_cast<float>(std::max(extent.height, 1u));
+    glm::mat4 viewProjection(1.0f);
+    viewProjection[0][0] = std::min(1.0f, height / width);
+    viewProjection[1][1] = std::min(1.0f, width / height);
+    return viewProjection;
+}
+
+void Application::runHeadlessFrames()
+{
+    // let caches, allocations and clocks settle
+    for (uint32_t i = 0; i < settings_m.warmupFrameCount_m; i++)
+        drawFrame();
+    vkDeviceWaitIdle(deviceManager_m.getDevice());
+
+    std::vector<double> frameTimesMs;
+    frameTimesMs.reserve(settings_m.frameCount_m);
+    auto start = std::chrono::steady_clock::now();
+    auto previous = start;
+    for (uint32_t i = 0; i < settings_m.frameCount_m; i++) {
+        drawFrame();
+        // drawFrame waits for the frame in flight, so this follows the GPU throughput
+        auto now = std::chrono::steady_clock::now();
+        frameTimesMs.push_back(std::chrono::duration<double, std::milli>(now - previous).count());
+        previous = now;
+    }
+    // include the frames still in flight
+    vkDeviceWaitIdle(deviceManager_m.getDevice());
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "headless : " << settings_m.frameCount_m << " frames in " << elapsed.count()
+        << " s (" << settings_m.frameCount_m / elapsed.count() << " frames/sec)" << std::endl;
+    commandManager_m.printRecordingStatistics();
+    profiler_m.printStatistics();
+
+    Benchmark benchmark;
+    benchmark.setStartupTime(startupMs_m);
+    benchmark.setFrameTimes(frameTimesMs, elapsed.count());
+    benchmark.measurePeakMemory();
+    benchmark.printResults();
+    if (!settings_m.benchOutputPath_m.empty())
+        benchmark.writeResults(settings_m.benchOutputPath_m);
+    if (!settings_m.baselinePath_m.empty())
+        benchmarkPassed_m = benchmark.compareWithBaseline(settings_m.baselinePath_m, settings_m.regressionThreshold_m);
 }
 
 void Application::cleanup()
 {
+    // no pipeline is built past this point, the device is idle
+    shaderWatcher_m.stop();
+    VkGraphicsPipelineFactory::destroyPipelineSet(deviceManager_m.getDevice(), reloadedGraphicsPipelines_m);
+    if (reloadedComputePipeline_m != VK_NULL_HANDLE)
+        vkDestroyPipeline(deviceManager_m.getDevice(), reloadedComputePipeline_m, nullptr);
+    reloadedComputePipeline_m = VK_NULL_HANDLE;
     // once window_m is closed, destroy resources and terminate glfw
-    execFunctionsSequence(destroyFunctions_m);
+    destroyStages();
+    if (settings_m.headless_m)
+        return;
     glfwDestroyWindow(window_m);
     glfwTerminate();
 }
@@ -114,9 +657,6 @@ void Application::createInstance()
     createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
     createInfo.pApplicationInfo = &appInfo;
 
-    uint32_t glfwExtensionCount = 0;
-    const char** glfwExtensions;
-    glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
     checkingForExtensionSupport();
     // getting required extentions according to whether debug mode or not
     auto extensions = getRequiredExtensions();
@@ -190,12 +730,15 @@ bool Application::checkValidationLayerSupport() {
 // required list of extensions based on wheather validation lyaers are enabled
 std::vector<const char*> Application::getRequiredExtensions()
 {
-    uint32_t glfwExtensionCount = 0;
-    const char** glfwExtensions
-        = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-    // convert const char** to std::vector<const char*>
-    std::vector<const char*> extensions(glfwExtensions, 
-        glfwExtensions + glfwExtensionCount); // ???
+    std::vector<const char*> extensions;
+    // surface extensions are unnecessary without a window
+    if (!settings_m.headless_m) {
+        uint32_t glfwExtensionCount = 0;
+        const char** glfwExtensions
+            = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+        // convert const char** to std::vector<const char*>
+        extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+    }
     if(enableValidationLayers_m) {
         // add debug messenger extension
         // VK_EXT_DEBUG_UTILS_EXTENSION_NAME = VK_EXT_debug_utils (literal string)
@@ -217,29 +760,108 @@ void Application::recreateSwapChain()
         glfwWaitEvents();
     }
 
-    // wait for finishing the current task
-    vkDeviceWaitIdle(deviceManager_m.getDevice());
+    // resizes received while waiting are handled by this recreation
+    resizePending_m = false;
     // recreation
-    // recreate anything dependent on the swap chain
-    std::vector<VkStage> stageList = 
-    {
-        VkStage::COMMAND_BUFFER,
-        VkStage::FRAME_BUFFERS,
-        VkStage::GRAPHICS_PIPELINE,
-        VkStage::RENDER_PASS,
-        VkStage::IMAGE_VIEWS,
-        VkStage::SWAP_CHAIN
-    };
-    // destroy anything to recreate right now
-    execFunctionsSequence(destroyFunctions_m, stageList);
-    std::reverse(stageList.begin(), stageList.end());
-    execFunctionsSequence(createFunctions_m, stageList);
+    // only recreate what is built from the swap chain images,
+    // the pipeline uses dynamic viewport and scissor
+    std::vector<VkStage> changedStages = {VkStage::SWAP_CHAIN};
+    // the render pass (and the pipeline compatible with it) only depends on the format
+    // a format change is rare (the window moved to another monitor), so it still drains the device
+    bool formatChanged = swapChainManager_m.chooseImageFormat() != swapChainManager_m.getSwapChainImageFormatRef();
+    if (formatChanged)
+        changedStages.push_back(VkStage::RENDER_PASS);
+    auto dirtyStages = getDependentStages(changedStages);
+    // a reload in progress would use the render pass being replaced
+    std::unique_lock<std::mutex> buildLock(pipelineBuildMutex_m, std::defer_lock);
+    if (formatChanged) {
+        buildLock.lock();
+        vkDeviceWaitIdle(deviceManager_m.getDevice());
+        // built for the old render pass
+        std::lock_guard<std::mutex> lock(reloadMutex_m);
+        VkGraphicsPipelineFactory::destroyPipelineSet(deviceManager_m.getDevice(), reloadedGraphicsPipelines_m);
+    }
+    // frames in flight may still use the old framebuffers and images,
+    // they are destroyed once the fences of those frames have signaled
+    destroyStages(dirtyStages, true);
+    // command buffers are recorded every frame, so they do not depend on the swap chain
+    createStages(dirtyStages);
+    renderer_m.resetImagesInFlight(swapChainManager_m.getSwapChainImagesNum());
 }
 
 void Application::framebufferResizeCallback(GLFWwindow* window, int width, int height)
 {
     auto app = reinterpret_cast<Application*>(glfwGetWindowUserPointer(window));
-    app->renderer_m.framebufferResized = true;
+    // a drag produces a burst of events, only the last one matters
+    app->resizePending_m = true;
+    app->lastResizeTime_m = std::chrono::steady_clock::now();
+}
+
+void Application::keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods)
+{
+    if (action != GLFW_PRESS)
+        return;
+    auto app = reinterpret_cast<Application*>(glfwGetWindowUserPointer(window));
+    // drawn with from the next frame, glfwPollEvents runs on the render thread
+    if (key == GLFW_KEY_B) {
+        auto& blendMode = app->pipelineVariant_m.blendMode_m;
+        using BlendMode = VkGraphicsPipelineFactory::BlendMode;
+        blendMode = blendMode == BlendMode::ALPHA ? BlendMode::OPAQUE
+            : blendMode == BlendMode::OPAQUE ? BlendMode::ADDITIVE : BlendMode::ALPHA;
+        std::cout << "pipeline variant : " << app->pipelineVariant_m.getName() << std::endl;
+        return;
+    }
+    if (key < GLFW_KEY_1)
+        return;
+    auto profileIndex = static_cast<size_t>(key - GLFW_KEY_1);
+    // switching recreates the swap chain, which cannot happen inside glfwPollEvents
+    if (profileIndex < VkPresentProfile::getProfiles().size())
+        app->requestedPresentProfile_m = profileIndex;
+}
+
+void Application::initStageGraph()
+{
+    // conditional stages (SURFACE, CULLING) which are not created count as satisfied
+    stageGraph_m =
+    {
+        {VkStage::DEBUGGER,         {{VkStage::INSTANCE}}},
+        // glfwCreateWindowSurface may be called from any thread, but the window belongs to the main one
+        {VkStage::SURFACE,          {{VkStage::INSTANCE}, {}, true}},
+        // the surface takes part in the device selection
+        {VkStage::PHYSICAL_DEVICE,  {{VkStage::INSTANCE, VkStage::SURFACE}}},
+        {VkStage::LOGICAL_DEVICE,   {{VkStage::PHYSICAL_DEVICE}}},
+        {VkStage::MEMORY_ALLOCATOR, {{VkStage::LOGICAL_DEVICE}}},
+        {VkStage::PIPELINE_CACHE,   {{VkStage::LOGICAL_DEVICE}}},
+        {VkStage::LAYOUT_CACHE,     {{VkStage::LOGICAL_DEVICE}}},
+        // the update templates are created from the set layouts of the cache
+        {VkStage::DESCRIPTOR_ALLOCATOR, {{VkStage::LOGICAL_DEVICE, VkStage::LAYOUT_CACHE}}},
+        {VkStage::UPLOAD_MANAGER,   {{VkStage::MEMORY_ALLOCATOR}}},
+        // glfwGetFramebufferSize is main thread only, headless mode allocates its images
+        {VkStage::SWAP_CHAIN,       {{VkStage::LOGICAL_DEVICE, VkStage::MEMORY_ALLOCATOR}, {}, true}},
+        {VkStage::IMAGE_VIEWS,      {{VkStage::SWAP_CHAIN}}},
+        // only the format of the swap chain, a change of it is handled by recreateSwapChain
+        {VkStage::RENDER_PASS,      {{VkStage::LOGICAL_DEVICE}, {VkStage::SWAP_CHAIN}}},
+        // VERTEX_FACTORY only reads the mesh file, so it overlaps with the device creation
+        {VkStage::GRAPHICS_PIPELINE,
+            {{VkStage::RENDER_PASS, VkStage::PIPELINE_CACHE, VkStage::LAYOUT_CACHE, VkStage::VERTEX_FACTORY}}},
+        // only the layouts of the frame and draw sets, which are the same for every rebuilt pipeline,
+        // and the number of draw calls
+        {VkStage::UNIFORM_BUFFER,
+            {{VkStage::MEMORY_ALLOCATOR, VkStage::LAYOUT_CACHE, VkStage::DESCRIPTOR_ALLOCATOR},
+                {VkStage::GRAPHICS_PIPELINE, VkStage::VERTEX_FACTORY}}},
+        // of the size of the swap chain, recreated with it
+        {VkStage::DEPTH_BUFFER,     {{VkStage::SWAP_CHAIN, VkStage::MEMORY_ALLOCATOR}}},
+        {VkStage::FRAME_BUFFERS,    {{VkStage::IMAGE_VIEWS, VkStage::RENDER_PASS, VkStage::DEPTH_BUFFER}}},
+        {VkStage::COMMAND_POOL,     {{VkStage::LOGICAL_DEVICE}}},
+        {VkStage::VERTEX_BUFFER,    {{VkStage::VERTEX_FACTORY, VkStage::UPLOAD_MANAGER}}},
+        {VkStage::CULLING,
+            {{VkStage::VERTEX_BUFFER, VkStage::PIPELINE_CACHE, VkStage::LAYOUT_CACHE,
+                VkStage::DESCRIPTOR_ALLOCATOR}}},
+        {VkStage::COMMAND_BUFFER,   {{VkStage::COMMAND_POOL}}},
+        {VkStage::PROFILER,         {{VkStage::LOGICAL_DEVICE}}},
+        // the image count is refreshed with resetImagesInFlight when the swap chain is recreated
+        {VkStage::RENDERER,         {{VkStage::LOGICAL_DEVICE}, {VkStage::SWAP_CHAIN}}}
+    };
 }
 
 void Application::initCreateFunctions()
@@ -259,11 +881,13 @@ void Application::initCreateFunctions()
                     debugger_m.setupDebugMessenger(instance_m);
                 }
             });
-    createFunctions_m.emplace_back
-        (VkStage::SURFACE, [this]()
-            {
-                deviceManager_m.createSurface(instance_m, window_m);
-            });
+    // headless mode has no window to create a surface for
+    if (!settings_m.headless_m)
+        createFunctions_m.emplace_back
+            (VkStage::SURFACE, [this]()
+                {
+                    deviceManager_m.createSurface(instance_m, window_m);
+                });
     createFunctions_m.emplace_back
         (VkStage::PHYSICAL_DEVICE, [this]()
             {
@@ -274,9 +898,46 @@ void Application::initCreateFunctions()
             {
                 deviceManager_m.createLogicalDevice(enableValidationLayers_m, validationLayers_m);
             });
+    createFunctions_m.emplace_back
+        (VkStage::MEMORY_ALLOCATOR, [this]()
+            {
+                memoryAllocator_m.createAllocator(getDeviceManagerRef(), settings_m.memoryBlockSize_m);
+            });
+    createFunctions_m.emplace_back
+        (VkStage::PIPELINE_CACHE, [this]()
+            {
+                pipelineCacheManager_m.createPipelineCache(getDeviceManagerRef(), settings_m.pipelineCachePath_m);
+            });
+    createFunctions_m.emplace_back
+        (VkStage::LAYOUT_CACHE, [this]()
+            {
+                layoutCacheManager_m.createLayoutCache(deviceManager_m.getDevice());
+            });
+    createFunctions_m.emplace_back
+        (VkStage::DESCRIPTOR_ALLOCATOR, [this]()
+            {
+                descriptorAllocator_m.createDescriptorAllocator
+                (
+                    getDeviceManagerRef(),
+                    layoutCacheManager_m,
+                    FRAME_RESOURCE_COUNT
+                );
+            });
+    createFunctions_m.emplace_back
+        (VkStage::UPLOAD_MANAGER, [this]()
+            {
+                uploadManager_m.createUploadManager
+                (
+                    getDeviceManagerRef(),
+                    memoryAllocator_m,
+                    settings_m.stagingRingSize_m,
+                    settings_m.uploadBudget_m
+                );
+            });
     createFunctions_m.emplace_back
         (VkStage::SWAP_CHAIN, [this]()
             {
+                swapChainManager_m.setPresentProfile(VkPresentProfile::getProfiles()[presentProfile_m]);
                 swapChainManager_m.createSwapChain(WIDTH, HEIGHT);
             });
     createFunctions_m.emplace_back
@@ -290,20 +951,101 @@ void Application::initCreateFunctions()
                 graphicsPipeline_m.createRenderPass
                 (
                     deviceManager_m.getDevice(),
-                    swapChainManager_m.getSwapChainImageFormatRef()
+                    swapChainManager_m.getSwapChainImageFormatRef(),
+                    swapChainManager_m.getImageFinalLayout(),
+                    VkFramebufferFactory::chooseDepthFormat(deviceManager_m.getPhysicalDevice())
                 );
             });
     createFunctions_m.emplace_back
         (VkStage::VERTEX_FACTORY, [this]()
             {
-               vertexManager_m.createVerticesData();
+               auto vertexFormat = settings_m.quantizeVertices_m ?
+                   VkVertexManager::VertexFormat::QUANTIZED : VkVertexManager::VertexFormat::FLOAT;
+               if (settings_m.meshPath_m.empty())
+                   vertexManager_m.createVerticesData(vertexFormat);
+               else
+                   vertexManager_m.loadMesh(settings_m.meshPath_m, vertexFormat);
+               createInstances();
+               createDrawCalls();
             });
     createFunctions_m.emplace_back
         (VkStage::GRAPHICS_PIPELINE, [this]()
             {
+                VkPhysicalDeviceProperties properties;
+                vkGetPhysicalDeviceProperties(deviceManager_m.getPhysicalDevice(), &properties);
+                // threadPool_m is sized for recording by --threads, one thread by default
+                // and the stage may run on a task of the init pool, which cannot wait for its own tasks
+                ThreadPool compileThreadPool(std::max(1u, std::thread::hardware_concurrency()));
                 graphicsPipeline_m.createGraphicsPipeline
                 (
                     deviceManager_m.getDevice(),
+                    pipelineCacheManager_m.getPipelineCacheRef(),
+                    layoutCacheManager_m,
+                    properties.limits.maxPushConstantsSize,
+                    vertexManager_m.getBindingDescriptions(),
+                    vertexManager_m.getAttributeDescriptions(),
+                    compileThreadPool,
+                    // compiled up front, the additive variant is left to its first use
+                    {VkGraphicsPipelineFactory::PipelineVariant{},
+                        {VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, VkGraphicsPipelineFactory::BlendMode::OPAQUE,
+                            VK_CULL_MODE_BACK_BIT}}
+                );
+            });
+    createFunctions_m.emplace_back
+        (VkStage::UNIFORM_BUFFER, [this]()
+            {
+                // drawFrame binds a single dynamic offset, the one of the camera
+                const auto& interface = graphicsPipeline_m.getShaderInterfaceRef();
+                auto frameBindings = VkShaderReflection::getSetLayoutBindings(interface,
+                    VkGraphicsPipelineFactory::FRAME_SET);
+                auto camera = std::find_if(interface.descriptorBindings_m.begin(), interface.descriptorBindings_m.end(),
+                    [](const auto& binding)
+                        { return binding.set_m == VkGraphicsPipelineFactory::FRAME_SET && binding.binding_m == 0; });
+                if (frameBindings.size() != 1 || camera == interface.descriptorBindings_m.end() ||
+                    camera->blockSize_m != sizeof(CameraUniforms))
+                    throw std::runtime_error("failed to match the camera uniforms with shader.vert!");
+                uniformManager_m.createUniformManager
+                (
+                    getDeviceManagerRef(),
+                    memoryAllocator_m,
+                    layoutCacheManager_m,
+                    descriptorAllocator_m,
+                    interface,
+                    VkGraphicsPipelineFactory::FRAME_SET,
+                    FRAME_RESOURCE_COUNT
+                );
+                // the pipeline factory fell back to the draw set when the push constants could not hold it
+                auto drawBindings = VkShaderReflection::getSetLayoutBindings(interface,
+                    VkGraphicsPipelineFactory::DRAW_SET);
+                drawDataInUniform_m = !drawBindings.empty();
+                auto drawDataSize = interface.pushConstantRange_m.size;
+                for (const auto& binding : interface.descriptorBindings_m)
+                    if (binding.set_m == VkGraphicsPipelineFactory::DRAW_SET)
+                        drawDataSize = binding.blockSize_m;
+                if (drawBindings.size() > 1 || drawDataSize != sizeof(DrawData))
+                    throw std::runtime_error("failed to match the draw data with shader.vert!");
+                if (drawDataInUniform_m)
+                    drawUniformManager_m.createUniformManager
+                    (
+                        getDeviceManagerRef(),
+                        memoryAllocator_m,
+                        layoutCacheManager_m,
+                        descriptorAllocator_m,
+                        interface,
+                        VkGraphicsPipelineFactory::DRAW_SET,
+                        FRAME_RESOURCE_COUNT,
+                        // every draw call may change the data, 256 is the largest offset alignment allowed
+                        std::max<VkDeviceSize>(drawCalls_m.size(), 1) *
+                            ((sizeof(DrawData) + 255) / 256 * 256)
+                    );
+            });
+    createFunctions_m.emplace_back
+        (VkStage::DEPTH_BUFFER, [this]()
+            {
+                framebufferFactory_m.createDepthBuffer
+                (
+                    getDeviceManagerRef(),
+                    memoryAllocator_m,
                     swapChainManager_m.getSwapChainExtentRef()
                 );
             });
@@ -325,24 +1067,57 @@ void Application::initCreateFunctions()
     createFunctions_m.emplace_back
         (VkStage::VERTEX_BUFFER, [this]()
             {
-                vertexManager_m.createVertexBuffer
+                vertexManager_m.createVertexBuffer(memoryAllocator_m, uploadManager_m);
+                // the scene is static, so submit the vertices before the first frame
+                uploadManager_m.flush();
+                // the staging ring holds its own copy now
+                vertexManager_m.releaseVerticesData();
+                // one region per frame in flight
+                vertexManager_m.createInstanceBuffer(memoryAllocator_m, instances_m.size(),
+                    FRAME_RESOURCE_COUNT);
+            });
+    // the draw list of the instances is built on the GPU
+    if (settings_m.gpuCulling_m)
+        createFunctions_m.emplace_back
+            (VkStage::CULLING, [this]()
+                {
+                    // every instance is an object drawing the whole mesh
+                    auto boundingSphere = vertexManager_m.getBoundingSphere();
+                    auto indexCount = static_cast<uint32_t>(vertexManager_m.getIndicesSize());
+                    std::vector<VkCullingManager::Object> objects(instances_m.size());
+                    for (size_t i = 0; i < objects.size(); i++)
+                        objects[i] = {boundingSphere, indexCount, 0, 0, static_cast<uint32_t>(i)};
+                    cullingManager_m.createCullingManager
+                    (
+                        getDeviceManagerRef(),
+                        memoryAllocator_m,
+                        uploadManager_m,
+                        pipelineCacheManager_m.getPipelineCacheRef(),
+                        layoutCacheManager_m,
+                        objects,
+                        instances_m.size(),
+                        FRAME_RESOURCE_COUNT
+                    );
+                    uploadManager_m.flush();
+                });
+    createFunctions_m.emplace_back
+        (VkStage::COMMAND_BUFFER, [this]()
+            {
+                commandManager_m.createCommandBuffers
                 (
                     getDeviceManagerRef(),
-                    commandManager_m.getCommandPoolRef()
+                    FRAME_RESOURCE_COUNT,
+                    threadPool_m.getThreadCount()
                 );
             });
     createFunctions_m.emplace_back
-        (VkStage::COMMAND_BUFFER, [this]()
+        (VkStage::PROFILER, [this]()
             {
-                commandManager_m.createCommandBuffers
+                profiler_m.createProfiler
                 (
-                    deviceManager_m.getDevice(), 
-                    graphicsPipeline_m.getRenderPassRef(), 
-                    framebufferFactory_m.getSwapChainFrameBuffersRef(), 
-                    graphicsPipeline_m.getGraphicsPipelineRef(),
-                    swapChainManager_m.getSwapChainExtentRef(),
-                    vertexManager_m.getVertexBufferRef(),
-                    vertexManager_m.getVerticesSize()
+                    getDeviceManagerRef(),
+                    FRAME_RESOURCE_COUNT,
+                    settings_m.profileCsvPath_m
                 );
             });
     createFunctions_m.emplace_back
@@ -351,7 +1126,8 @@ void Application::initCreateFunctions()
                 renderer_m.createSyncObjects
                 (
                     deviceManager_m.getDevice(),
-                    swapChainManager_m.getSwapChainImagesNum()
+                    swapChainManager_m.getSwapChainImagesNum(),
+                    VkPresentProfile::getProfiles()[presentProfile_m].framesInFlight_m
                 );
             });
 }
@@ -363,15 +1139,27 @@ void Application::initDestroyFunctions()
         {
             renderer_m.destroyRenderer(getDeviceManagerRef().getDevice());
         });
+    destroyFunctions_m.emplace_back
+        (VkStage::PROFILER, [this]()
+        {
+            profiler_m.destroyProfiler(getDeviceManagerRef().getDevice());
+        });
     destroyFunctions_m.emplace_back
         (VkStage::COMMAND_BUFFER, [this]()
         {
             commandManager_m.destroyCommandBuffers(getDeviceManagerRef().getDevice());
         });
+    if (settings_m.gpuCulling_m)
+        destroyFunctions_m.emplace_back
+            (VkStage::CULLING, [this]()
+            {
+                cullingManager_m.destroyCullingManager(getDeviceManagerRef().getDevice(), memoryAllocator_m);
+            });
     destroyFunctions_m.emplace_back
         (VkStage::VERTEX_BUFFER, [this]()
         {
-            vertexManager_m.destroyVertexBuffer(deviceManager_m.getDevice());
+            vertexManager_m.destroyInstanceBuffer(memoryAllocator_m);
+            vertexManager_m.destroyVertexBuffer(memoryAllocator_m);
         });
     destroyFunctions_m.emplace_back
         (VkStage::COMMAND_POOL, [this]()
@@ -383,6 +1171,18 @@ void Application::initDestroyFunctions()
         {
             framebufferFactory_m.destroyFramebuffers(getDeviceManagerRef());
         });
+    destroyFunctions_m.emplace_back
+        (VkStage::DEPTH_BUFFER, [this]()
+        {
+            framebufferFactory_m.destroyDepthBuffer(getDeviceManagerRef().getDevice(), memoryAllocator_m);
+        });
+    destroyFunctions_m.emplace_back
+        (VkStage::UNIFORM_BUFFER, [this]()
+        {
+            if (drawDataInUniform_m)
+                drawUniformManager_m.destroyUniformManager(memoryAllocator_m);
+            uniformManager_m.destroyUniformManager(memoryAllocator_m);
+        });
     destroyFunctions_m.emplace_back
         (VkStage::GRAPHICS_PIPELINE, [this]()
         {
@@ -401,8 +1201,58 @@ void Application::initDestroyFunctions()
     destroyFunctions_m.emplace_back
         (VkStage::SWAP_CHAIN, [this]
         {
+            // the device is idle, so the retired swap chains can go as well
+            retireQueue_m.flush();
             swapChainManager_m.destroySwapChain();
         });
+    destroyFunctions_m.emplace_back
+        (VkStage::UPLOAD_MANAGER, [this]
+        {
+            uploadManager_m.destroyUploadManager();
+        });
+    // a recreation does not wait for the frames in flight, which may still use these
+    retireFunctions_m.emplace_back
+        (VkStage::FRAME_BUFFERS, [this]()
+        {
+            framebufferFactory_m.retireFramebuffers(deviceManager_m.getDevice(), retireQueue_m,
+                renderer_m.getInFlightFencesRef());
+        });
+    retireFunctions_m.emplace_back
+        (VkStage::DEPTH_BUFFER, [this]()
+        {
+            framebufferFactory_m.retireDepthBuffer(deviceManager_m.getDevice(), memoryAllocator_m, retireQueue_m,
+                renderer_m.getInFlightFencesRef());
+        });
+    retireFunctions_m.emplace_back
+        (VkStage::IMAGE_VIEWS, [this]()
+        {
+            // retired with the swap chain
+        });
+    retireFunctions_m.emplace_back
+        (VkStage::SWAP_CHAIN, [this]()
+        {
+            swapChainManager_m.retireSwapChain(retireQueue_m, renderer_m.getInFlightFencesRef());
+        });
+    destroyFunctions_m.emplace_back
+        (VkStage::DESCRIPTOR_ALLOCATOR, [this]
+        {
+            descriptorAllocator_m.destroyDescriptorAllocator();
+        });
+    destroyFunctions_m.emplace_back
+        (VkStage::LAYOUT_CACHE, [this]
+        {
+            layoutCacheManager_m.destroyLayoutCache();
+        });
+    destroyFunctions_m.emplace_back
+        (VkStage::PIPELINE_CACHE, [this]
+        {
+            pipelineCacheManager_m.destroyPipelineCache(deviceManager_m.getDevice());
+        });
+    destroyFunctions_m.emplace_back
+        (VkStage::MEMORY_ALLOCATOR, [this]
+        {
+            memoryAllocator_m.destroyAllocator();
+        });
     destroyFunctions_m.emplace_back
         (VkStage::LOGICAL_DEVICE, [this]
         {
@@ -413,11 +1263,12 @@ void Application::initDestroyFunctions()
         {
             deviceManager_m.destroyPhysicalDevice(instance_m);
         });
-    destroyFunctions_m.emplace_back
-        (VkStage::SURFACE, [this]
-        {
-            deviceManager_m.destroySurface(instance_m);
-        });
+    if (!settings_m.headless_m)
+        destroyFunctions_m.emplace_back
+            (VkStage::SURFACE, [this]
+            {
+                deviceManager_m.destroySurface(instance_m);
+            });
     destroyFunctions_m.emplace_back
         (VkStage::DEBUGGER, [this]
         {
@@ -0,0 +1,108 @@
+#include <Benchmark.hpp>
+#include <VkProfiler.hpp>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+#include <sys/resource.h>
+
+void Benchmark::setMetric(const std::string& name, double value, bool higherIsBetter)
+{
+    if (metrics_m.find(name) == metrics_m.end())
+        names_m.push_back(name);
+    metrics_m[name] = Metric{value, higherIsBetter};
+}
+
+void Benchmark::setStartupTime(double startupMs)
+{
+    setMetric("startup_ms", startupMs, false);
+}
+
+void Benchmark::setFrameTimes(const std::vector<double>& frameTimesMs, double elapsedSeconds)
+{
+    auto statistics = VkProfiler::computeStatistics(frameTimesMs);
+    setMetric("frames_per_sec", elapsedSeconds > 0.0 ? frameTimesMs.size() / elapsedSeconds : 0.0, true);
+    setMetric("frame_ms_p50", statistics.p50_m, false);
+    setMetric("frame_ms_p95", statistics.p95_m, false);
+    setMetric("frame_ms_p99", statistics.p99_m, false);
+}
+
+void Benchmark::measurePeakMemory()
+{
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    // ru_maxrss is in bytes on macOS and in kilobytes on linux
+#ifdef __APPLE__
+    auto peakBytes = static_cast<double>(usage.ru_maxrss);
+#else
+    auto peakBytes = static_cast<double>(usage.ru_maxrss) * 1024.0;
+#endif
+    setMetric("peak_memory_mib", peakBytes / (1024.0 * 1024.0), false);
+}
+
+void Benchmark::printResults() const
+{
+    std::cout << "benchmark :" << std::endl;
+    for (const auto& name : names_m)
+        std::cout << "\t" << name << " : " << metrics_m.at(name).value_m << std::endl;
+}
+
+void Benchmark::writeResults(const std::string& path) const
+{
+    std::ofstream file(path, std::ios::trunc);
+    if (!file.is_open())
+        throw std::runtime_error("failed to open benchmark output file!");
+    file << "# written by --bench-output, used as a baseline by --baseline" << std::endl;
+    file << std::setprecision(6);
+    for (const auto& name : names_m)
+        file << name << " " << metrics_m.at(name).value_m << std::endl;
+    std::cout << "benchmark : wrote results to " << path << std::endl;
+}
+
+std::map<std::string, double> Benchmark::readBaseline(const std::string& path)
+{
+    std::ifstream file(path);
+    if (!file.is_open())
+        throw std::runtime_error("failed to open benchmark baseline file!");
+    std::map<std::string, double> baseline;
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#')
+            continue;
+        std::istringstream stream(line);
+        std::string name;
+        double value;
+        if (stream >> name >> value)
+            baseline[name] = value;
+    }
+    return baseline;
+}
+
+bool Benchmark::compareWithBaseline(const std::string& path, double threshold) const
+{
+    auto baseline = readBaseline(path);
+    bool passed = true;
+    std::cout << "benchmark baseline " << path << " (threshold " << threshold * 100.0 << "%) :" << std::endl;
+    // until the reference machine has measured it, the run only reports
+    if (baseline.empty())
+        std::cout << "\tno metric measured yet, write them with make bench-baseline" << std::endl;
+    for (const auto& name : names_m) {
+        const auto& metric = metrics_m.at(name);
+        auto it = baseline.find(name);
+        if (it == baseline.end() || it->second <= 0.0) {
+            std::cout << "\t" << name << " : " << metric.value_m << " (no baseline)" << std::endl;
+            continue;
+        }
+        // positive when the metric got worse
+        auto change = (metric.value_m - it->second) / it->second;
+        if (metric.higherIsBetter_m)
+            change = -change;
+        bool regressed = change > threshold;
+        passed = passed && !regressed;
+        std::cout << "\t" << name << " : " << metric.value_m << " (baseline " << it->second << ", "
+            << (change >= 0.0 ? "worse by " : "better by ") << std::abs(change) * 100.0 << "%)"
+            << (regressed ? " REGRESSION" : "") << std::endl;
+    }
+    return passed;
+}
@@ -0,0 +1,19 @@
+#include <FileUtils.hpp>
+#include <fstream>
+#include <stdexcept>
+
+std::vector<char> FileUtils::readFile(const std::string& filename)
+{
+    // ate : start reading at the end of the file
+    // binary : read  the file as binary file
+    std::ifstream file(filename, std::ios::ate | std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to open file!");
+    }
+    size_t fileSize = (size_t) file.tellg();
+    std::vector<char> buffer(fileSize);
+    file.seekg(0);
+    file.read(buffer.data(), fileSize);
+    file.close();
+    return buffer;
+}
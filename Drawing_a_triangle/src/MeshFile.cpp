@@ -0,0 +1,149 @@
+#include <MeshFile.hpp>
+#include <stdexcept>
+#include <fstream>
+#include <cstring>
+#include <algorithm>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+static uint64_t alignUp(uint64_t value, uint64_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+MeshFile::~MeshFile()
+{
+    close();
+}
+
+void MeshFile::open(const std::string& path)
+{
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("failed to open mesh file!");
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0 || fileStat.st_size < static_cast<off_t>(sizeof(Header))) {
+        ::close(fd);
+        throw std::runtime_error("failed to read mesh file!");
+    }
+    mappingSize_m = static_cast<size_t>(fileStat.st_size);
+    mapping_m = mmap(nullptr, mappingSize_m, PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping keeps its own reference to the file
+    ::close(fd);
+    if (mapping_m == MAP_FAILED) {
+        mapping_m = nullptr;
+        throw std::runtime_error("failed to map mesh file!");
+    }
+    // the blobs are read once from the beginning to the end by the staging copies
+    madvise(mapping_m, mappingSize_m, MADV_SEQUENTIAL);
+    madvise(mapping_m, mappingSize_m, MADV_WILLNEED);
+
+    const auto& header = getHeader();
+    auto attributesEnd = sizeof(Header) + sizeof(Attribute) * static_cast<uint64_t>(header.attributeCount_m);
+    auto fits = [&](uint64_t offset, uint64_t size)
+        { return offset >= attributesEnd && offset <= mappingSize_m && size <= mappingSize_m - offset; };
+    auto valid = std::memcmp(header.magic_m, MAGIC, sizeof(MAGIC)) == 0
+        && header.version_m == VERSION
+        && (header.indexSize_m == 2 || header.indexSize_m == 4)
+        && header.vertexStride_m != 0
+        && header.vertexOffset_m % ALIGNMENT == 0 && header.indexOffset_m % ALIGNMENT == 0
+        && attributesEnd <= mappingSize_m
+        && header.vertexCount_m <= mappingSize_m / header.vertexStride_m
+        && header.indexCount_m <= mappingSize_m / header.indexSize_m
+        && fits(header.vertexOffset_m, getVertexDataSize())
+        && fits(header.indexOffset_m, getIndexDataSize());
+    if (!valid) {
+        close();
+        throw std::runtime_error("invalid mesh file!");
+    }
+    // robustBufferAccess is not enabled, an index past the vertices would be fetched out of bounds
+    // the index blob is read by the staging copies anyway, so this only faults its pages in earlier
+    if (header.indexCount_m != 0 && findMaxIndex() >= header.vertexCount_m) {
+        close();
+        throw std::runtime_error("failed to load mesh: index out of range!");
+    }
+}
+
+uint64_t MeshFile::findMaxIndex() const
+{
+    const auto& header = getHeader();
+    uint64_t maxIndex = 0;
+    // the blob starts at a multiple of ALIGNMENT, so the indices are aligned
+    if (header.indexSize_m == 2) {
+        auto indices = static_cast<const uint16_t*>(getIndexData());
+        for (uint64_t i = 0; i < header.indexCount_m; i++)
+            maxIndex = std::max<uint64_t>(maxIndex, indices[i]);
+    }
+    else {
+        auto indices = static_cast<const uint32_t*>(getIndexData());
+        for (uint64_t i = 0; i < header.indexCount_m; i++)
+            maxIndex = std::max<uint64_t>(maxIndex, indices[i]);
+    }
+    return maxIndex;
+}
+
+void MeshFile::close()
+{
+    if (mapping_m != nullptr)
+        munmap(mapping_m, mappingSize_m);
+    mapping_m = nullptr;
+    mappingSize_m = 0;
+}
+
+bool MeshFile::isOpen() const
+    { return mapping_m != nullptr; }
+
+const MeshFile::Header& MeshFile::getHeader() const
+    { return *static_cast<const Header*>(mapping_m); }
+
+const MeshFile::Attribute* MeshFile::getAttributes() const
+    { return reinterpret_cast<const Attribute*>(static_cast<const char*>(mapping_m) + sizeof(Header)); }
+
+const void* MeshFile::getVertexData() const
+    { return static_cast<const char*>(mapping_m) + getHeader().vertexOffset_m; }
+
+size_t MeshFile::getVertexDataSize() const
+    { return static_cast<size_t>(getHeader().vertexCount_m * getHeader().vertexStride_m); }
+
+const void* MeshFile::getIndexData() const
+    { return static_cast<const char*>(mapping_m) + getHeader().indexOffset_m; }
+
+size_t MeshFile::getIndexDataSize() const
+    { return static_cast<size_t>(getHeader().indexCount_m * getHeader().indexSize_m); }
+
+void MeshFile::write(const std::string& path, uint32_t vertexStride, const std::vector<Attribute>& attributes,
+    const void* vertices, uint64_t vertexCount, const void* indices, uint64_t indexCount, uint32_t indexSize,
+    const float boundingSphere[4], float positionScale, const float positionOffset[3])
+{
+    Header header{};
+    std::memcpy(header.magic_m, MAGIC, sizeof(MAGIC));
+    header.version_m = VERSION;
+    header.vertexStride_m = vertexStride;
+    header.attributeCount_m = static_cast<uint32_t>(attributes.size());
+    header.vertexCount_m = vertexCount;
+    header.indexCount_m = indexCount;
+    header.indexSize_m = indexSize;
+    auto attributesEnd = sizeof(Header) + sizeof(Attribute) * attributes.size();
+    header.vertexOffset_m = alignUp(attributesEnd, ALIGNMENT);
+    header.indexOffset_m = alignUp(header.vertexOffset_m + vertexCount * vertexStride, ALIGNMENT);
+    std::memcpy(header.boundingSphere_m, boundingSphere, sizeof(header.boundingSphere_m));
+    header.positionScale_m = positionScale;
+    if (positionOffset != nullptr)
+        std::memcpy(header.positionOffset_m, positionOffset, sizeof(header.positionOffset_m));
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+        throw std::runtime_error("failed to open mesh file!");
+    const char padding[ALIGNMENT] = {};
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(attributes.data()), sizeof(Attribute) * attributes.size());
+    file.write(padding, header.vertexOffset_m - attributesEnd);
+    file.write(static_cast<const char*>(vertices), vertexCount * vertexStride);
+    file.write(padding, header.indexOffset_m - (header.vertexOffset_m + vertexCount * vertexStride));
+    file.write(static_cast<const char*>(indices), indexCount * indexSize);
+    if (!file)
+        throw std::runtime_error("failed to write mesh file!");
+}
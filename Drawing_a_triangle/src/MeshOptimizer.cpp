@@ -0,0 +1,201 @@
+#include <MeshOptimizer.hpp>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+#include <algorithm>
+#include <stdexcept>
+
+// simulated cache of the vertex cache optimization
+constexpr uint32_t CACHE_SIZE = 32;
+constexpr float CACHE_DECAY_POWER = 1.5f;
+constexpr float LAST_TRIANGLE_SCORE = 0.75f;
+constexpr float VALENCE_BOOST_SCALE = 2.0f;
+constexpr float VALENCE_BOOST_POWER = 0.5f;
+constexpr uint32_t INVALID_INDEX = ~0u;
+
+// FNV-1a
+static uint64_t hashBytes(const char* data, size_t size)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+size_t MeshOptimizer::generateVertexRemap(const void* vertices, size_t vertexCount, size_t vertexSize,
+    std::vector<uint32_t>& remap)
+{
+    auto bytes = static_cast<const char*>(vertices);
+    remap.assign(vertexCount, INVALID_INDEX);
+    // hash -> vertices with that hash, collisions are resolved by comparing the bytes
+    std::unordered_multimap<uint64_t, uint32_t> uniqueVertices;
+    uniqueVertices.reserve(vertexCount);
+    uint32_t uniqueCount = 0;
+    for (size_t i = 0; i < vertexCount; i++) {
+        auto vertex = bytes + i * vertexSize;
+        auto hash = hashBytes(vertex, vertexSize);
+        auto range = uniqueVertices.equal_range(hash);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (std::memcmp(vertex, bytes + it->second * vertexSize, vertexSize) == 0) {
+                remap[i] = remap[it->second];
+                break;
+            }
+        }
+        if (remap[i] != INVALID_INDEX)
+            continue;
+        remap[i] = uniqueCount++;
+        uniqueVertices.emplace(hash, static_cast<uint32_t>(i));
+    }
+    return uniqueCount;
+}
+
+void MeshOptimizer::remapVertices(void* dst, const void* src, size_t vertexCount, size_t vertexSize,
+    const std::vector<uint32_t>& remap)
+{
+    auto dstBytes = static_cast<char*>(dst);
+    auto srcBytes = static_cast<const char*>(src);
+    for (size_t i = 0; i < vertexCount; i++)
+        if (remap[i] != INVALID_INDEX)
+            std::memcpy(dstBytes + remap[i] * vertexSize, srcBytes + i * vertexSize, vertexSize);
+}
+
+// recently used vertices and vertices with few remaining triangles score higher
+static float computeVertexScore(int cachePosition, uint32_t remainingValence)
+{
+    // no triangle left to emit
+    if (remainingValence == 0)
+        return -1.0f;
+    float score = 0.0f;
+    if (cachePosition >= 0) {
+        // the vertices of the last triangle get a fixed score, so that the next triangle
+        // does not simply reuse the same edge in a strip
+        if (cachePosition < 3)
+            score = LAST_TRIANGLE_SCORE;
+        else {
+            auto scale = 1.0f / (CACHE_SIZE - 3);
+            score = std::pow(1.0f - (cachePosition - 3) * scale, CACHE_DECAY_POWER);
+        }
+    }
+    // finish off lone vertices early, they would cost a cache miss later
+    score += VALENCE_BOOST_SCALE * std::pow(static_cast<float>(remainingValence), -VALENCE_BOOST_POWER);
+    return score;
+}
+
+void MeshOptimizer::optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount)
+{
+    if (indices.size() % 3 != 0)
+        throw std::runtime_error("index count is not a multiple of 3!");
+    auto triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+        return;
+    // triangles using each vertex, as ranges of adjacency
+    std::vector<uint32_t> valence(vertexCount, 0);
+    for (auto index : indices)
+        valence[index]++;
+    std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+    for (size_t i = 0; i < vertexCount; i++)
+        adjacencyOffsets[i + 1] = adjacencyOffsets[i] + valence[i];
+    std::vector<uint32_t> adjacency(indices.size());
+    std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+    for (size_t i = 0; i < indices.size(); i++)
+        adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+
+    // valence now counts the triangles which have not been emitted yet
+    std::vector<int> cachePositions(vertexCount, -1);
+    std::vector<float> vertexScores(vertexCount);
+    for (size_t i = 0; i < vertexCount; i++)
+        vertexScores[i] = computeVertexScore(-1, valence[i]);
+    std::vector<bool> emitted(triangleCount, false);
+
+    std::vector<uint32_t> result;
+    result.reserve(indices.size());
+    std::vector<uint32_t> cache, newCache;
+    cache.reserve(CACHE_SIZE + 3);
+    newCache.reserve(CACHE_SIZE + 3);
+    // first triangle which may not have been emitted, used when the cache has no candidate
+    size_t inputCursor = 0;
+    auto bestTriangle = INVALID_INDEX;
+    for (size_t emittedCount = 0; emittedCount < triangleCount; emittedCount++) {
+        if (bestTriangle == INVALID_INDEX) {
+            // dead end, continue in input order so the search stays linear
+            while (emitted[inputCursor])
+                inputCursor++;
+            bestTriangle = static_cast<uint32_t>(inputCursor);
+        }
+        const auto* triangle = &indices[bestTriangle * 3];
+        result.insert(result.end(), triangle, triangle + 3);
+        emitted[bestTriangle] = true;
+
+        // the vertices of the triangle move to the front of the cache
+        newCache.assign(triangle, triangle + 3);
+        for (auto vertex : cache)
+            if (vertex != triangle[0] && vertex != triangle[1] && vertex != triangle[2])
+                newCache.push_back(vertex);
+        // the triangle is no longer pending for its vertices
+        for (size_t k = 0; k < 3; k++) {
+            auto vertex = triangle[k];
+            auto begin = adjacency.begin() + adjacencyOffsets[vertex];
+            auto end = begin + valence[vertex];
+            auto it = std::find(begin, end, bestTriangle);
+            std::iter_swap(it, end - 1);
+            valence[vertex]--;
+        }
+        // rescore every vertex whose cache position changed, including the evicted ones
+        for (size_t i = 0; i < newCache.size(); i++) {
+            auto vertex = newCache[i];
+            cachePositions[vertex] = i < CACHE_SIZE ? static_cast<int>(i) : -1;
+            vertexScores[vertex] = computeVertexScore(cachePositions[vertex], valence[vertex]);
+        }
+        // the next triangle is the best one touching the cache
+        bestTriangle = INVALID_INDEX;
+        float bestScore = -1.0f;
+        for (size_t i = 0; i < newCache.size(); i++) {
+            auto vertex = newCache[i];
+            for (uint32_t j = 0; j < valence[vertex]; j++) {
+                auto candidate = adjacency[adjacencyOffsets[vertex] + j];
+                auto score = vertexScores[indices[candidate * 3]] + vertexScores[indices[candidate * 3 + 1]]
+                    + vertexScores[indices[candidate * 3 + 2]];
+                if (score > bestScore) {
+                    bestScore = score;
+                    bestTriangle = candidate;
+                }
+            }
+        }
+        if (newCache.size() > CACHE_SIZE)
+            newCache.resize(CACHE_SIZE);
+        std::swap(cache, newCache);
+    }
+    indices.swap(result);
+}
+
+size_t MeshOptimizer::generateVertexFetchRemap(std::vector<uint32_t>& indices, size_t vertexCount,
+    std::vector<uint32_t>& remap)
+{
+    remap.assign(vertexCount, INVALID_INDEX);
+    uint32_t nextVertex = 0;
+    for (auto& index : indices) {
+        if (remap[index] == INVALID_INDEX)
+            remap[index] = nextVertex++;
+        index = remap[index];
+    }
+    return nextVertex;
+}
+
+double MeshOptimizer::computeAcmr(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize)
+{
+    if (indices.size() < 3)
+        return 0.0;
+    // time each vertex entered the FIFO cache
+    std::vector<size_t> cacheTimes(vertexCount, 0);
+    size_t time = cacheSize + 1;
+    size_t misses = 0;
+    for (auto index : indices) {
+        if (time - cacheTimes[index] > cacheSize) {
+            cacheTimes[index] = time++;
+            misses++;
+        }
+    }
+    return static_cast<double>(misses) / (indices.size() / 3);
+}
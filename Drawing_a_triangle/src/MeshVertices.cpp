@@ -0,0 +1,75 @@
+#include <MeshVertices.hpp>
+#include <MeshOptimizer.hpp>
+#include <algorithm>
+#include <cmath>
+
+MeshVertices::OptimizeStatistics MeshVertices::optimize(std::vector<MeshVertex>& vertices,
+    std::vector<uint32_t>& indices)
+{
+    OptimizeStatistics statistics;
+    statistics.inputVertexCount_m = vertices.size();
+    // identical vertices are shared through the index buffer
+    std::vector<uint32_t> remap;
+    auto vertexCount = MeshOptimizer::generateVertexRemap(vertices.data(), vertices.size(),
+        sizeof(MeshVertex), remap);
+    std::vector<MeshVertex> uniqueVertices(vertexCount);
+    MeshOptimizer::remapVertices(uniqueVertices.data(), vertices.data(), vertices.size(), sizeof(MeshVertex), remap);
+    // the unindexed list referenced vertex i at position i
+    indices = remap;
+    statistics.acmrBefore_m = MeshOptimizer::computeAcmr(indices, vertexCount);
+    MeshOptimizer::optimizeVertexCache(indices, vertexCount);
+    // the cache order decides the vertex order
+    vertexCount = MeshOptimizer::generateVertexFetchRemap(indices, vertexCount, remap);
+    vertices.resize(vertexCount);
+    MeshOptimizer::remapVertices(vertices.data(), uniqueVertices.data(), uniqueVertices.size(),
+        sizeof(MeshVertex), remap);
+    statistics.acmrAfter_m = MeshOptimizer::computeAcmr(indices, vertexCount);
+    return statistics;
+}
+
+glm::vec4 MeshVertices::computeBoundingSphere(const std::vector<MeshVertex>& vertices)
+{
+    if (vertices.empty())
+        return glm::vec4(0.0f);
+    auto minimum = vertices[0].position_m;
+    auto maximum = vertices[0].position_m;
+    for (const auto& vertex : vertices) {
+        minimum = glm::vec2(std::min(minimum.x, vertex.position_m.x), std::min(minimum.y, vertex.position_m.y));
+        maximum = glm::vec2(std::max(maximum.x, vertex.position_m.x), std::max(maximum.y, vertex.position_m.y));
+    }
+    auto center = (minimum + maximum) * 0.5f;
+    float radius = 0.0f;
+    for (const auto& vertex : vertices) {
+        auto d = vertex.position_m - center;
+        radius = std::max(radius, std::sqrt(d.x * d.x + d.y * d.y));
+    }
+    return glm::vec4(center.x, center.y, 0.0f, radius);
+}
+
+VertexQuantizer::Dequantization MeshVertices::quantize(const MeshVertex* vertices, size_t vertexCount,
+    std::vector<QuantizedMeshVertex>& quantizedVertices)
+{
+    auto dequantization = VertexQuantizer::computeDequantization(vertices, vertexCount, sizeof(MeshVertex));
+    quantizedVertices.resize(vertexCount);
+    for (size_t i = 0; i < vertexCount; i++) {
+        auto& quantizedVertex = quantizedVertices[i];
+        for (int axis = 0; axis < 2; axis++)
+            quantizedVertex.position_m[axis] =
+                VertexQuantizer::quantizePosition(vertices[i].position_m[axis], dequantization, axis);
+        for (int channel = 0; channel < 3; channel++)
+            quantizedVertex.color_m[channel] = VertexQuantizer::encodeUnorm8(vertices[i].color_m[channel]);
+        quantizedVertex.color_m[3] = 255;
+    }
+    return dequantization;
+}
+
+glm::vec4 MeshVertices::quantizeBoundingSphere(const glm::vec4& boundingSphere,
+    const VertexQuantizer::Dequantization& dequantization)
+{
+    // inverse of the dequantization matrix, which scales and offsets every axis
+    // the rounding may move a position out of the sphere by half a step
+    return glm::vec4((boundingSphere.x - dequantization.offset_m[0]) / dequantization.scale_m,
+        (boundingSphere.y - dequantization.offset_m[1]) / dequantization.scale_m,
+        (boundingSphere.z - dequantization.offset_m[2]) / dequantization.scale_m,
+        boundingSphere.w / dequantization.scale_m + 2.0f * VertexQuantizer::SNORM16_ERROR);
+}
@@ -0,0 +1,102 @@
+#include <ShaderWatcher.hpp>
+#include <cstdlib>
+#include <iostream>
+
+ShaderWatcher::~ShaderWatcher()
+{
+    stop();
+}
+
+void ShaderWatcher::start(const std::vector<Shader>& shaders, const std::string& compilerPath,
+    std::function<void(const std::vector<std::string>&)> onCompiled, std::chrono::milliseconds interval)
+{
+    stop();
+    shaders_m = shaders;
+    compilerPath_m = compilerPath;
+    onCompiled_m = onCompiled;
+    interval_m = interval;
+    // the current sources are assumed to be compiled already
+    writeTimes_m.clear();
+    for (const auto& shader : shaders_m)
+        writeTimes_m.push_back(getWriteTime(shader.sourcePath_m));
+    stopping_m = false;
+    thread_m = std::thread(&ShaderWatcher::watchLoop, this);
+}
+
+void ShaderWatcher::stop()
+{
+    if (!thread_m.joinable())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_m);
+        stopping_m = true;
+    }
+    stopRequested_m.notify_all();
+    thread_m.join();
+}
+
+bool ShaderWatcher::isRunning() const
+{
+    return thread_m.joinable();
+}
+
+std::filesystem::file_time_type ShaderWatcher::getWriteTime(const std::string& path)
+{
+    // a missing file, or one being replaced by an editor, reads as the minimum time
+    std::error_code error;
+    auto writeTime = std::filesystem::last_write_time(path, error);
+    return error ? std::filesystem::file_time_type::min() : writeTime;
+}
+
+void ShaderWatcher::watchLoop()
+{
+    std::unique_lock<std::mutex> lock(mutex_m);
+    while (!stopRequested_m.wait_for(lock, interval_m, [this]() { return stopping_m; })) {
+        lock.unlock();
+        std::vector<std::string> compiledOutputs;
+        for (size_t i = 0; i < shaders_m.size(); i++) {
+            auto writeTime = getWriteTime(shaders_m[i].sourcePath_m);
+            if (writeTime == writeTimes_m[i] || writeTime == std::filesystem::file_time_type::min())
+                continue;
+            // a failed compilation is not retried until the source is saved again
+            writeTimes_m[i] = writeTime;
+            if (compile(shaders_m[i]))
+                compiledOutputs.push_back(shaders_m[i].outputPath_m);
+        }
+        if (!compiledOutputs.empty() && onCompiled_m) {
+            // an exception would terminate the program from this thread
+            try {
+                onCompiled_m(compiledOutputs);
+            } catch (const std::exception& e) {
+                std::cerr << e.what() << std::endl;
+            }
+        }
+        lock.lock();
+    }
+}
+
+bool ShaderWatcher::compile(const Shader& shader) const
+{
+    auto temporaryPath = shader.outputPath_m + ".tmp";
+    // the compiler reports its errors on stderr itself
+    auto command = "\"" + compilerPath_m + "\" " + shader.options_m + " \"" + shader.sourcePath_m
+        + "\" -o \"" + temporaryPath + "\"";
+    auto start = std::chrono::steady_clock::now();
+    if (std::system(command.c_str()) != 0) {
+        std::cerr << "failed to compile " << shader.sourcePath_m << ", keeping the previous shader" << std::endl;
+        std::error_code error;
+        std::filesystem::remove(temporaryPath, error);
+        return false;
+    }
+    std::error_code error;
+    // rename replaces the output in one step
+    std::filesystem::rename(temporaryPath, shader.outputPath_m, error);
+    if (error) {
+        std::cerr << "failed to replace " << shader.outputPath_m << " : " << error.message() << std::endl;
+        return false;
+    }
+    std::cout << "compiled " << shader.sourcePath_m << " ("
+        << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count()
+        << " ms)" << std::endl;
+    return true;
+}
@@ -0,0 +1,74 @@
+#include <ThreadPool.hpp>
+#include <algorithm>
+
+ThreadPool::ThreadPool(uint32_t threadCount)
+{
+    threadCount = std::max(threadCount, 1u);
+    for (uint32_t i = 0; i < threadCount; i++)
+        workers_m.emplace_back(&ThreadPool::workerLoop, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_m);
+        stopping_m = true;
+    }
+    taskAvailable_m.notify_all();
+    for (auto& worker : workers_m)
+        worker.join();
+}
+
+uint32_t ThreadPool::getThreadCount() const
+{
+    return static_cast<uint32_t>(workers_m.size());
+}
+
+void ThreadPool::submit(std::function<void(void)> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_m);
+        tasks_m.push(std::move(task));
+        pendingCount_m++;
+    }
+    taskAvailable_m.notify_one();
+}
+
+void ThreadPool::wait()
+{
+    std::unique_lock<std::mutex> lock(mutex_m);
+    tasksFinished_m.wait(lock, [this]() { return pendingCount_m == 0; });
+    if (exception_m) {
+        auto exception = std::move(exception_m);
+        exception_m = nullptr;
+        lock.unlock();
+        std::rethrow_exception(exception);
+    }
+}
+
+void ThreadPool::workerLoop()
+{
+    while (true) {
+        std::function<void(void)> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_m);
+            taskAvailable_m.wait(lock, [this]() { return stopping_m || !tasks_m.empty(); });
+            if (tasks_m.empty())
+                return;
+            task = std::move(tasks_m.front());
+            tasks_m.pop();
+        }
+        // keep the worker alive and hand the exception over to wait()
+        std::exception_ptr exception;
+        try {
+            task();
+        } catch (...) {
+            exception = std::current_exception();
+        }
+        std::lock_guard<std::mutex> lock(mutex_m);
+        if (exception && !exception_m)
+            exception_m = std::move(exception);
+        if (--pendingCount_m == 0)
+            tasksFinished_m.notify_all();
+    }
+}
@@ -0,0 +1,48 @@
+#include <VertexQuantizer.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+VertexQuantizer::Dequantization VertexQuantizer::computeDequantization(const void* positions, size_t count,
+    size_t stride)
+{
+    Dequantization dequantization;
+    if (count == 0)
+        return dequantization;
+    float minimum[2];
+    float maximum[2];
+    for (size_t i = 0; i < count; i++) {
+        float position[2];
+        // the positions may be unaligned in a mapped file
+        std::memcpy(position, static_cast<const char*>(positions) + i * stride, sizeof(position));
+        for (int axis = 0; axis < 2; axis++) {
+            minimum[axis] = i == 0 ? position[axis] : std::min(minimum[axis], position[axis]);
+            maximum[axis] = i == 0 ? position[axis] : std::max(maximum[axis], position[axis]);
+        }
+    }
+    // the center of the bounds maps to 0 and the longest half extent to 1
+    dequantization.offset_m[0] = (minimum[0] + maximum[0]) * 0.5f;
+    dequantization.offset_m[1] = (minimum[1] + maximum[1]) * 0.5f;
+    dequantization.scale_m = std::max(maximum[0] - minimum[0], maximum[1] - minimum[1]) * 0.5f;
+    // a single point
+    if (dequantization.scale_m <= 0.0f)
+        dequantization.scale_m = 1.0f;
+    return dequantization;
+}
+
+int16_t VertexQuantizer::encodeSnorm16(float value)
+{
+    value = std::min(std::max(value, -1.0f), 1.0f);
+    return static_cast<int16_t>(std::lround(value * 32767.0f));
+}
+
+uint8_t VertexQuantizer::encodeUnorm8(float value)
+{
+    value = std::min(std::max(value, 0.0f), 1.0f);
+    return static_cast<uint8_t>(std::lround(value * 255.0f));
+}
+
+int16_t VertexQuantizer::quantizePosition(float position, const Dequantization& dequantization, int axis)
+{
+    return encodeSnorm16((position - dequantization.offset_m[axis]) / dequantization.scale_m);
+}
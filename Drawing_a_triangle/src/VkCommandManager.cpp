@@ -1,8 +1,10 @@
 #include <VkCommandManager.hpp>
+#include <VkGraphicsPipeline.hpp>
 #include <iostream>
+#include <chrono>
+#include <algorithm>
+#include <cstring>
 
-const std::vector<VkCommandBuffer>& VkCommandManager::getCommandBufferRef() const
-    { return commandBuffers_m; }
 VkCommandPool& VkCommandManager::getCommandPoolRef()
     { return commandPool_m; }
 // Command pools manage the memory that is used to store the buffers 
@@ -21,22 +23,49 @@ void VkCommandManager::createCommandPool(const VkDeviceManager& deviceManager)
         throw std::runtime_error("failed to create command pool!");
 }
 
+void VkCommandManager::createFramePool(const VkDevice& device, uint32_t queueFamilyIndex, VkCommandPool& pool)
+{
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.queueFamilyIndex = queueFamilyIndex;
+    // the whole pool is reset every frame instead of individual command buffers
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    if (vkCreateCommandPool(device, &poolInfo, nullptr, &pool) != VK_SUCCESS)
+        throw std::runtime_error("failed to create command pool!");
+}
+
 void VkCommandManager::createCommandBuffers
-    (const VkDevice& device, const VkRenderPass& renderPass, const std::vector<VkFramebuffer>& swapChainFramebuffers,
-    const VkPipeline& graphicsPipeline, const VkExtent2D& swapChainExtent, const VkBuffer& vertexBuffer, size_t verticesCount)
+    (const VkDeviceManager& deviceManager, size_t framesInFlight, uint32_t threadCount)
 {
-    commandBuffers_m.resize(swapChainFramebuffers.size());
-    // specify command pool and number of buffers to allocate
-    VkCommandBufferAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    allocInfo.commandPool = commandPool_m;
-    // if the allocated command buffers are primary or secondary command buffers
-    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    allocInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers_m.size());
-    if (vkAllocateCommandBuffers(device, &allocInfo, commandBuffers_m.data()) != VK_SUCCESS)
-        throw std::runtime_error("failed to allocate command buffers!");
-    // execute command buffer-relevant functions
-    executeCommandFunctions(renderPass, swapChainExtent, swapChainFramebuffers, graphicsPipeline, vertexBuffer, verticesCount);
+    const auto& device = deviceManager.getDevice();
+    auto queueFamilyIndices =
+        const_cast<VkDeviceManager&>(deviceManager).findQueueFamilies(deviceManager.getPhysicalDevice());
+    auto queueFamilyIndex = queueFamilyIndices.graphicsFamily_m.value();
+    frames_m.resize(framesInFlight);
+    for (auto& frame : frames_m) {
+        createFramePool(device, queueFamilyIndex, frame.primaryPool_m);
+        // specify command pool and number of buffers to allocate
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = frame.primaryPool_m;
+        // if the allocated command buffers are primary or secondary command buffers
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = 1;
+        if (vkAllocateCommandBuffers(device, &allocInfo, &frame.primaryBuffer_m) != VK_SUCCESS)
+            throw std::runtime_error("failed to allocate command buffers!");
+        // command pools are externally synchronized, so every thread needs its own
+        frame.threadPools_m.resize(threadCount);
+        frame.secondaryBuffers_m.resize(threadCount);
+        for (uint32_t i = 0; i < threadCount; i++) {
+            createFramePool(device, queueFamilyIndex, frame.threadPools_m[i]);
+            allocInfo.commandPool = frame.threadPools_m[i];
+            allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+            if (vkAllocateCommandBuffers(device, &allocInfo, &frame.secondaryBuffers_m[i]) != VK_SUCCESS)
+                throw std::runtime_error("failed to allocate secondary command buffers!");
+        }
+    }
+    recordingStatistics_m.assign(threadCount + 1, RecordingStatistics{});
+    recordedFrameCount_m = 0;
 }
 
 void VkCommandManager::destroyCommandPool(const VkDevice& device)
@@ -46,59 +75,232 @@ void VkCommandManager::destroyCommandPool(const VkDevice& device)
 
 void VkCommandManager::destroyCommandBuffers(const VkDevice& device)
 {
-    // for reusing command buffers
-    vkFreeCommandBuffers(device, commandPool_m,
-        static_cast<uint32_t>(commandBuffers_m.size()),
-        commandBuffers_m.data());
+    // destroying a pool frees its command buffers
+    for (const auto& frame : frames_m) {
+        for (const auto& pool : frame.threadPools_m)
+            vkDestroyCommandPool(device, pool, nullptr);
+        vkDestroyCommandPool(device, frame.primaryPool_m, nullptr);
+    }
+    frames_m.clear();
+}
+
+const VkCommandBuffer& VkCommandManager::recordCommandBuffer(const VkDevice& device, ThreadPool& threadPool,
+    VkProfiler& profiler,
+    size_t frameIndex, const VkRenderPass& renderPass, const VkFramebuffer& framebuffer,
+    const VkPipeline& graphicsPipeline, const VkExtent2D& extent, const GeometryBuffers& geometry,
+    const std::vector<DrawCall>& drawCalls, const VkCullingManager* culling)
+{
+    auto& frame = frames_m[frameIndex];
+    // the primary command buffer is recorded on this thread
+    auto start = std::chrono::steady_clock::now();
+    vkResetCommandPool(device, frame.primaryPool_m, 0);
+    const auto& commandBuffer = frame.primaryBuffer_m;
+    // start reconding command buffers
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    // re-recorded every frame
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    beginInfo.pInheritanceInfo = nullptr;
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+        throw std::runtime_error("failed to begin recording command buffer!");
+    profiler.beginFrame(device, commandBuffer, frameIndex);
+    // compute work cannot be recorded inside a render pass
+    if (culling != nullptr)
+        culling->recordCulling(commandBuffer, frameIndex);
+
+    // starting a render pass
+    VkRenderPassBeginInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassInfo.renderPass = renderPass;
+    renderPassInfo.framebuffer = framebuffer;
+    // the pixels outside this region will have undefined values
+    renderPassInfo.renderArea.offset = {0, 0};
+    renderPassInfo.renderArea.extent = extent;
+    // one per attachment, the depth is cleared to the far plane
+    VkClearValue clearValues[2]{};
+    clearValues[0].color = {{0.0f, 0.0f, 0.0f, 0.0f}};
+    clearValues[1].depthStencil = {1.0f, 0};
+    renderPassInfo.clearValueCount = 2;
+    renderPassInfo.pClearValues = clearValues;
+    profiler.writeTimestamp(commandBuffer, frameIndex, VkProfiler::RENDER_PASS_BEGIN);
+    // the drawing commands are provided by secondary command buffers
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+
+    auto threadCount = frame.secondaryBuffers_m.size();
+    // contiguous ranges of the draw list, so the draw order is kept
+    auto drawsPerThread = (drawCalls.size() + threadCount - 1) / threadCount;
+    std::vector<VkCommandBuffer> secondaryBuffers;
+    secondaryBuffers.reserve(threadCount);
+    if (culling != nullptr) {
+        // a few indirect draws whatever the object count, there is nothing to split across the threads
+        auto start = std::chrono::steady_clock::now();
+        vkResetCommandPool(device, frame.threadPools_m[0], 0);
+        recordSecondaryCommandBuffer(frame.secondaryBuffers_m[0], renderPass, framebuffer,
+            graphicsPipeline, extent, geometry, drawCalls, 0, 0, recordingStatistics_m[0], culling, frameIndex);
+        secondaryBuffers.push_back(frame.secondaryBuffers_m[0]);
+        recordingStatistics_m[0].totalMs_m += std::chrono::duration<double, std::milli>
+            (std::chrono::steady_clock::now() - start).count();
+        recordingStatistics_m[0].drawCount_m += culling->getObjectCount();
+        // skip the draw list
+        threadCount = 0;
+    }
+    // nothing may throw between submitting and waiting, the tasks refer to this stack frame
+    for (size_t i = 0; i < threadCount; i++) {
+        auto first = std::min(i * drawsPerThread, drawCalls.size());
+        auto last = std::min(first + drawsPerThread, drawCalls.size());
+        if (first == last)
+            continue;
+        secondaryBuffers.push_back(frame.secondaryBuffers_m[i]);
+        threadPool.submit([&, i, first, last]()
+            {
+                auto start = std::chrono::steady_clock::now();
+                // the previous use of this pool has finished since the frame fence was waited on
+                vkResetCommandPool(device, frame.threadPools_m[i], 0);
+                auto& statistics = recordingStatistics_m[i];
+                recordSecondaryCommandBuffer(frame.secondaryBuffers_m[i], renderPass, framebuffer,
+                    graphicsPipeline, extent, geometry, drawCalls, first, last, statistics);
+                statistics.totalMs_m += std::chrono::duration<double, std::milli>
+                    (std::chrono::steady_clock::now() - start).count();
+                statistics.drawCount_m += last - first;
+            });
+    }
+
+    threadPool.wait();
+    if (!secondaryBuffers.empty())
+        vkCmdExecuteCommands(commandBuffer, static_cast<uint32_t>(secondaryBuffers.size()), secondaryBuffers.data());
+
+    // finish render pass and recording the comand buffer
+    vkCmdEndRenderPass(commandBuffer);
+    profiler.writeTimestamp(commandBuffer, frameIndex, VkProfiler::RENDER_PASS_END);
+    profiler.writeTimestamp(commandBuffer, frameIndex, VkProfiler::FRAME_END);
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+        throw std::runtime_error("failed to record command buffer!");
+    recordingStatistics_m.back().totalMs_m += std::chrono::duration<double, std::milli>
+        (std::chrono::steady_clock::now() - start).count();
+    recordingStatistics_m.back().drawCount_m += culling != nullptr ? culling->getObjectCount() : drawCalls.size();
+    recordedFrameCount_m++;
+    return commandBuffer;
+}
+
+void VkCommandManager::recordSecondaryCommandBuffer(const VkCommandBuffer& commandBuffer,
+    const VkRenderPass& renderPass, const VkFramebuffer& framebuffer, const VkPipeline& graphicsPipeline,
+    const VkExtent2D& extent, const GeometryBuffers& geometry, const std::vector<DrawCall>& drawCalls,
+    size_t first, size_t last, RecordingStatistics& statistics, const VkCullingManager* culling, size_t frameIndex)
+{
+    // state to inherit from the calling primary command buffers
+    VkCommandBufferInheritanceInfo inheritanceInfo{};
+    inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritanceInfo.renderPass = renderPass;
+    inheritanceInfo.subpass = 0;
+    inheritanceInfo.framebuffer = framebuffer;
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    // executed entirely inside a render pass
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+        | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    beginInfo.pInheritanceInfo = &inheritanceInfo;
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+        throw std::runtime_error("failed to begin recording secondary command buffer!");
+
+    // basic drawing commands
+    // bind the graphics pipeline
+    // the second parameter specifies if the pipeline object is a graphics or compute pipeline
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+    // viewport and scissor are dynamic state of the pipeline
+    // and are not inherited from the primary command buffer
+    // draw entire framebuffer
+    VkViewport viewport{};
+    viewport.x = 0.0f;
+    viewport.y = 0.0f;
+    viewport.width = static_cast<float>(extent.width);
+    viewport.height = static_cast<float>(extent.height);
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+    VkRect2D scissor{};
+    scissor.offset = {0, 0};
+    scissor.extent = extent;
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+    // bind the vertex buffer and the instance region of this frame
+    VkBuffer vertexBuffers[] = {geometry.vertexBuffer_m, geometry.instanceBuffer_m};
+    VkDeviceSize offsets[] = {0, geometry.instanceOffset_m};
+    vkCmdBindVertexBuffers(commandBuffer, 0, 2, vertexBuffers, offsets);
+    // shared vertices are transformed once while they stay in the post-transform cache
+    vkCmdBindIndexBuffer(commandBuffer, geometry.indexBuffer_m, 0, geometry.indexType_m);
+    // the uniforms of the frame, the dynamic offsets select them in the ring
+    if (geometry.uniformSet_m != VK_NULL_HANDLE)
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, geometry.pipelineLayout_m,
+            VkGraphicsPipelineFactory::FRAME_SET, 1, &geometry.uniformSet_m,
+            static_cast<uint32_t>(geometry.dynamicOffsets_m.size()), geometry.dynamicOffsets_m.data());
+    // push constants are not inherited either, every secondary command buffer starts without them
+    DrawDataRecorder drawData(commandBuffer, geometry);
+    // the draw parameters were written by the culling dispatch
+    if (culling != nullptr) {
+        if (geometry.drawData_m != nullptr)
+            drawData.push(geometry.drawData_m, geometry.drawDataSize_m);
+        culling->recordDraws(commandBuffer, frameIndex);
+    }
+    for (auto i = first; i < last; i++) {
+        const auto& drawCall = drawCalls[i];
+        if (geometry.drawData_m != nullptr)
+            drawData.push(geometry.drawData_m + geometry.drawDataSize_m * i, geometry.drawDataSize_m);
+        // indexCount, instanceCount, firstIndex, vertexOffset, firstInstance
+        vkCmdDrawIndexed(commandBuffer, drawCall.indexCount_m, drawCall.instanceCount_m,
+            drawCall.firstIndex_m, drawCall.vertexOffset_m, drawCall.firstInstance_m);
+    }
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+        throw std::runtime_error("failed to record secondary command buffer!");
+    statistics.pushCount_m += drawData.getPushCount();
+    statistics.skippedPushCount_m += drawData.getSkippedCount();
 }
 
-void VkCommandManager::executeCommandFunctions
-    (const VkRenderPass& renderPass, const VkExtent2D& swapChainExtent,
-     const std::vector<VkFramebuffer>& swapChainFramebuffers, const VkPipeline& graphicsPipeline,
-     const VkBuffer& vertexBuffer, size_t verticesCount)
+VkCommandManager::DrawDataRecorder::DrawDataRecorder(const VkCommandBuffer& commandBuffer,
+    const GeometryBuffers& geometry)
+    : commandBuffer_m(commandBuffer), geometry_m(geometry) {}
+
+void VkCommandManager::DrawDataRecorder::push(const void* data, uint32_t size)
 {
-    for (size_t i = 0; i < commandBuffers_m.size(); i++) {
-        // start reconding command buffers
-        VkCommandBufferBeginInfo beginInfo{};
-        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-        // how to use the command buffer
-        beginInfo.flags = 0;
-        // state to inherit from the calling primary command buffers
-        // (only relevant for secondary command buffers)
-        beginInfo.pInheritanceInfo = nullptr;
-        if (vkBeginCommandBuffer(commandBuffers_m[i], &beginInfo) != VK_SUCCESS)
-            throw std::runtime_error("failed to begin recording command buffer!");
-        
-        // starting a render pass
-        VkRenderPassBeginInfo renderPassInfo{};
-        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        renderPassInfo.renderPass = renderPass;
-        renderPassInfo.framebuffer = swapChainFramebuffers[i];
-        // the pixels outside this region will have undefined values
-        renderPassInfo.renderArea.offset = {0, 0};
-        renderPassInfo.renderArea.extent = swapChainExtent;
-        VkClearValue clearColor = {0.0f, 0.0f, 0.0f, 0.0f};
-        renderPassInfo.clearValueCount = 1;
-        renderPassInfo.pClearValues = &clearColor;
-        // last parameter controls how the drawing commands within the render pass
-        // will be provided. 
-        vkCmdBeginRenderPass(commandBuffers_m[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-        // basic drawing commands
-        // bind the graphics pipeline
-        // the second parameter specifies if the pipeline object is a graphics or compute pipeline
-        vkCmdBindPipeline(commandBuffers_m[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
-        // bind the vertex buffer
-        VkBuffer vertexBuffers[] = {vertexBuffer};
-        VkDeviceSize offsets[] = {0};
-        vkCmdBindVertexBuffers(commandBuffers_m[i], 0, 1, vertexBuffers, offsets);
-        // draw triangle
-        // vertexCount, instanceCount, firstVertex, firstInstance
-        vkCmdDraw(commandBuffers_m[i], static_cast<uint32_t>(verticesCount), 1, 0, 0);
-
-        // finish render pass and recording the comand buffer
-        vkCmdEndRenderPass(commandBuffers_m[i]);
-        if (vkEndCommandBuffer(commandBuffers_m[i]) != VK_SUCCESS) 
-            throw std::runtime_error("failed to record command buffer!");
+    const auto* bytes = static_cast<const char*>(data);
+    // consecutive draws often share their data, the bound values still hold
+    if (current_m.size() == size && std::equal(current_m.begin(), current_m.end(), bytes)) {
+        skippedCount_m++;
+        return;
+    }
+    if (geometry_m.drawRing_m != nullptr) {
+        // the ring is shared by the recording threads, it is synchronized
+        auto allocation = geometry_m.drawRing_m->allocate(size);
+        std::memcpy(allocation.mapped_m, data, size);
+        vkCmdBindDescriptorSets(commandBuffer_m, VK_PIPELINE_BIND_POINT_GRAPHICS, geometry_m.pipelineLayout_m,
+            VkGraphicsPipelineFactory::DRAW_SET, 1, &geometry_m.drawSet_m, 1, &allocation.offset_m);
+    } else {
+        const auto& range = geometry_m.pushConstantRange_m;
+        if (size > range.size)
+            throw std::runtime_error("failed to push the draw data, it exceeds the push constant range!");
+        vkCmdPushConstants(commandBuffer_m, geometry_m.pipelineLayout_m, range.stageFlags, range.offset,
+            size, data);
     }
-}
\ No newline at end of file
+    current_m.assign(bytes, bytes + size);
+    pushCount_m++;
+}
+
+uint64_t VkCommandManager::DrawDataRecorder::getPushCount() const
+    { return pushCount_m; }
+
+uint64_t VkCommandManager::DrawDataRecorder::getSkippedCount() const
+    { return skippedCount_m; }
+
+void VkCommandManager::printRecordingStatistics() const
+{
+    if (recordedFrameCount_m == 0)
+        return;
+    std::cout << "command recording (" << recordedFrameCount_m << " frames) :" << std::endl;
+    for (size_t i = 0; i + 1 < recordingStatistics_m.size(); i++)
+        std::cout << "\tthread " << i << " : " << recordingStatistics_m[i].totalMs_m / recordedFrameCount_m
+            << " ms/frame, " << recordingStatistics_m[i].drawCount_m / recordedFrameCount_m
+            << " draws/frame, " << recordingStatistics_m[i].pushCount_m / recordedFrameCount_m
+            << " pushes/frame (" << recordingStatistics_m[i].skippedPushCount_m / recordedFrameCount_m
+            << " redundant skipped)" << std::endl;
+    // includes waiting for the threads
+    std::cout << "\tprimary : " << recordingStatistics_m.back().totalMs_m / recordedFrameCount_m
+        << " ms/frame" << std::endl;
+}
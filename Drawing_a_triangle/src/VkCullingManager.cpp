@@ -0,0 +1,199 @@
+#include <VkCullingManager.hpp>
+#include <VkShaderReflection.hpp>
+#include <FileUtils.hpp>
+#include <algorithm>
+
+void VkCullingManager::createCullingManager(const VkDeviceManager& deviceManager,
+    VkMemoryAllocator& memoryAllocator, VkUploadManager& uploadManager, const VkPipelineCache& pipelineCache,
+    VkLayoutCacheManager& layoutCache, const std::vector<Object>& objects, size_t instanceRegionSize,
+    size_t framesInFlight)
+{
+    const auto& physicalDevice = deviceManager.getPhysicalDevice();
+    // the dispatch is recorded in the command buffer of the frame, on the graphics queue
+    auto queueFamilyIndices =
+        const_cast<VkDeviceManager&>(deviceManager).findQueueFamilies(physicalDevice);
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+    if (!(queueFamilies[queueFamilyIndices.graphicsFamily_m.value()].queueFlags & VK_QUEUE_COMPUTE_BIT))
+        throw std::runtime_error("failed to find compute support on the graphics queue!");
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    multiDrawIndirect_m = deviceManager.isMultiDrawIndirectEnabled();
+    maxDrawIndirectCount_m = std::max(1u, properties.limits.maxDrawIndirectCount);
+
+    objects_m = objects;
+    instanceRegionSize_m = instanceRegionSize;
+    auto objectCount = std::max<size_t>(objects_m.size(), 1);
+    const auto& device = deviceManager.getDevice();
+    // static scene, uploaded once through the staging ring
+    VkDeviceSize objectBufferSize = sizeof(Object) * objectCount;
+    memoryAllocator.createBuffer(objectBufferSize,
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VkMemoryAllocator::Lifetime::PERSISTENT,
+        objectBuffer_m, objectBufferAllocation_m);
+    if (!objects_m.empty())
+        uploadManager.uploadBuffer(objects_m.data(), sizeof(Object) * objects_m.size(), objectBuffer_m, 0,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+    // written by the compute shader and read by the draws, never touched by the host
+    VkDeviceSize drawBufferSize = sizeof(VkDrawIndexedIndirectCommand) * objectCount * framesInFlight;
+    memoryAllocator.createBuffer(drawBufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VkMemoryAllocator::Lifetime::PERSISTENT,
+        drawBuffer_m, drawBufferAllocation_m);
+    memoryAllocator.createBuffer(sizeof(uint32_t) * framesInFlight,
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VkMemoryAllocator::Lifetime::PERSISTENT,
+        counterBuffer_m, counterBufferAllocation_m);
+    // the descriptor sets are allocated with the reflected layout
+    createComputePipeline(device, pipelineCache, layoutCache);
+    // objects, instances, draw commands and counters
+    if (bindings_m.size() != 4)
+        throw std::runtime_error("failed to match the culling buffers with the bindings of cull.comp!");
+    frameDescriptorSets_m.assign(framesInFlight, VK_NULL_HANDLE);
+}
+
+void VkCullingManager::beginFrame(VkDescriptorAllocator& descriptorAllocator, const VkBuffer& instanceBuffer,
+    size_t frameIndex)
+{
+    // the set of the previous use of this frame went with the reset of its chain
+    auto& descriptorSet = frameDescriptorSets_m.at(frameIndex);
+    descriptorSet = descriptorAllocator.allocate(descriptorSetLayout_m, VkDescriptorAllocator::Lifetime::FRAME,
+        frameIndex);
+    // whole buffers, the region of a frame is an index in the push constants
+    // so the offsets never have to respect minStorageBufferOffsetAlignment
+    std::vector<VkDescriptorAllocator::DescriptorInfo> infos(4);
+    infos[0].buffer_m = {objectBuffer_m, 0, VK_WHOLE_SIZE};
+    infos[1].buffer_m = {instanceBuffer, 0, VK_WHOLE_SIZE};
+    infos[2].buffer_m = {drawBuffer_m, 0, VK_WHOLE_SIZE};
+    infos[3].buffer_m = {counterBuffer_m, 0, VK_WHOLE_SIZE};
+    descriptorAllocator.write(descriptorSet, descriptorSetLayout_m, infos);
+}
+
+void VkCullingManager::createComputePipeline(const VkDevice& device, const VkPipelineCache& pipelineCache,
+    VkLayoutCacheManager& layoutCache)
+{
+    auto interface = VkShaderReflection::reflect(FileUtils::readFile("./spv/cull.spv"));
+    if (interface.pushConstantRange_m.size != sizeof(PushConstants) || VkShaderReflection::getSetCount(interface) != 1)
+        throw std::runtime_error("failed to match the culling push constants and sets with cull.comp!");
+    bindings_m = VkShaderReflection::getSetLayoutBindings(interface, 0);
+    pipelineLayout_m = layoutCache.getPipelineLayout(interface);
+    descriptorSetLayout_m = layoutCache.getSetLayouts(pipelineLayout_m)[0];
+    computePipeline_m = buildComputePipeline(device, pipelineCache, layoutCache);
+}
+
+VkPipeline VkCullingManager::buildComputePipeline(const VkDevice& device, const VkPipelineCache& pipelineCache,
+    VkLayoutCacheManager& layoutCache) const
+{
+    auto code = FileUtils::readFile("./spv/cull.spv");
+    // the descriptor set and the push constants are written for the current layout
+    if (layoutCache.getPipelineLayout(VkShaderReflection::reflect(code)) != pipelineLayout_m)
+        throw std::runtime_error("failed to reload cull.comp, its interface changed and needs a restart!");
+    VkShaderModuleCreateInfo moduleInfo{};
+    moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    moduleInfo.codeSize = code.size();
+    moduleInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+    VkShaderModule shaderModule;
+    if (vkCreateShaderModule(device, &moduleInfo, nullptr, &shaderModule) != VK_SUCCESS)
+        throw std::runtime_error("failed to create shader module!");
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = shaderModule;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = pipelineLayout_m;
+    VkPipeline computePipeline;
+    auto result = vkCreateComputePipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &computePipeline);
+    // the module is only needed to create the pipeline
+    vkDestroyShaderModule(device, shaderModule, nullptr);
+    if (result != VK_SUCCESS)
+        throw std::runtime_error("failed to create culling pipeline!");
+    return computePipeline;
+}
+
+void VkCullingManager::replaceComputePipeline(const VkDevice& device, const VkPipeline& pipeline,
+    VkRetireQueue& retireQueue, const std::vector<VkFence>& fences)
+{
+    auto oldPipeline = computePipeline_m;
+    retireQueue.retire(fences, [device, oldPipeline]()
+        {
+            vkDestroyPipeline(device, oldPipeline, nullptr);
+        });
+    computePipeline_m = pipeline;
+}
+
+void VkCullingManager::destroyCullingManager(const VkDevice& device, VkMemoryAllocator& memoryAllocator)
+{
+    vkDestroyPipeline(device, computePipeline_m, nullptr);
+    // the sets go with the pools of the descriptor allocator, the layouts belong to the layout cache
+    frameDescriptorSets_m.clear();
+    memoryAllocator.destroyBuffer(counterBuffer_m, counterBufferAllocation_m);
+    memoryAllocator.destroyBuffer(drawBuffer_m, drawBufferAllocation_m);
+    memoryAllocator.destroyBuffer(objectBuffer_m, objectBufferAllocation_m);
+    objects_m.clear();
+}
+
+void VkCullingManager::recordCulling(const VkCommandBuffer& commandBuffer, size_t frameIndex) const
+{
+    auto objectCount = std::max<size_t>(objects_m.size(), 1);
+    VkDeviceSize drawRegionSize = sizeof(VkDrawIndexedIndirectCommand) * objectCount;
+    // culled slots keep an instanceCount of 0, so the whole region can be drawn without a count buffer
+    // the draws of the previous use of this region have finished since the frame fence was waited on
+    vkCmdFillBuffer(commandBuffer, drawBuffer_m, drawRegionSize * frameIndex, drawRegionSize, 0);
+    vkCmdFillBuffer(commandBuffer, counterBuffer_m, sizeof(uint32_t) * frameIndex, sizeof(uint32_t), 0);
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+        1, &barrier, 0, nullptr, 0, nullptr);
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline_m);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout_m, 0, 1,
+        &frameDescriptorSets_m[frameIndex], 0, nullptr);
+    PushConstants pushConstants{};
+    pushConstants.viewProjection_m = viewProjection_m;
+    pushConstants.objectCount_m = static_cast<uint32_t>(objects_m.size());
+    pushConstants.instanceBase_m = static_cast<uint32_t>(instanceRegionSize_m * frameIndex);
+    pushConstants.drawBase_m = static_cast<uint32_t>(objectCount * frameIndex);
+    pushConstants.counterIndex_m = static_cast<uint32_t>(frameIndex);
+    vkCmdPushConstants(commandBuffer, pipelineLayout_m, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants),
+        &pushConstants);
+    auto groupCount = static_cast<uint32_t>((objects_m.size() + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE);
+    if (groupCount != 0)
+        vkCmdDispatch(commandBuffer, groupCount, 1, 1);
+
+    // the compacted commands are read by the indirect draws of the render pass
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+        0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void VkCullingManager::recordDraws(const VkCommandBuffer& commandBuffer, size_t frameIndex) const
+{
+    auto objectCount = std::max<size_t>(objects_m.size(), 1);
+    auto stride = static_cast<uint32_t>(sizeof(VkDrawIndexedIndirectCommand));
+    VkDeviceSize offset = static_cast<VkDeviceSize>(stride) * objectCount * frameIndex;
+    // the visible commands are compacted at the front of the region, the rest draws nothing
+    if (multiDrawIndirect_m) {
+        for (size_t first = 0; first < objectCount; first += maxDrawIndirectCount_m) {
+            auto drawCount = static_cast<uint32_t>(std::min<size_t>(maxDrawIndirectCount_m, objectCount - first));
+            vkCmdDrawIndexedIndirect(commandBuffer, drawBuffer_m, offset + first * stride, drawCount, stride);
+        }
+        return;
+    }
+    // without multiDrawIndirect every command needs its own call, the parameters still come from the GPU
+    for (size_t i = 0; i < objectCount; i++)
+        vkCmdDrawIndexedIndirect(commandBuffer, drawBuffer_m, offset + i * stride, 1, stride);
+}
+
+void VkCullingManager::setViewProjection(const glm::mat4& viewProjection)
+{
+    viewProjection_m = viewProjection;
+}
+
+size_t VkCullingManager::getObjectCount() const
+    { return objects_m.size(); }
@@ -0,0 +1,248 @@
+#include <VkDescriptorAllocator.hpp>
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+void VkDescriptorAllocator::createDescriptorAllocator(const VkDeviceManager& deviceManager,
+    VkLayoutCacheManager& layoutCache, size_t framesInFlight, uint32_t setsPerPool)
+{
+    device_m = deviceManager.getDevice();
+    layoutCache_m = &layoutCache;
+    setsPerPool_m = std::max(1u, std::min(setsPerPool, MAX_SETS_PER_POOL));
+    persistentChain_m = PoolChain{};
+    frameChains_m.assign(framesInFlight, PoolChain{});
+    statistics_m = Statistics{};
+    createUpdateTemplate_m = nullptr;
+    destroyUpdateTemplate_m = nullptr;
+    updateWithTemplate_m = nullptr;
+    // device level functions of an extension have to be looked up
+    if (deviceManager.isDescriptorUpdateTemplateEnabled()) {
+        createUpdateTemplate_m = (PFN_vkCreateDescriptorUpdateTemplateKHR)
+            vkGetDeviceProcAddr(device_m, "vkCreateDescriptorUpdateTemplateKHR");
+        destroyUpdateTemplate_m = (PFN_vkDestroyDescriptorUpdateTemplateKHR)
+            vkGetDeviceProcAddr(device_m, "vkDestroyDescriptorUpdateTemplateKHR");
+        updateWithTemplate_m = (PFN_vkUpdateDescriptorSetWithTemplateKHR)
+            vkGetDeviceProcAddr(device_m, "vkUpdateDescriptorSetWithTemplateKHR");
+        if (createUpdateTemplate_m == nullptr || destroyUpdateTemplate_m == nullptr || updateWithTemplate_m == nullptr)
+            createUpdateTemplate_m = nullptr;
+    }
+}
+
+void VkDescriptorAllocator::destroyDescriptorAllocator()
+{
+    std::lock_guard<std::mutex> lock(mutex_m);
+    for (auto& updateTemplate : updateTemplates_m)
+        if (updateTemplate.second.template_m != VK_NULL_HANDLE)
+            destroyUpdateTemplate_m(device_m, updateTemplate.second.template_m, nullptr);
+    updateTemplates_m.clear();
+    // destroying a pool frees its sets
+    for (auto pool : persistentChain_m.pools_m)
+        vkDestroyDescriptorPool(device_m, pool, nullptr);
+    persistentChain_m = PoolChain{};
+    for (auto& chain : frameChains_m)
+        for (auto pool : chain.pools_m)
+            vkDestroyDescriptorPool(device_m, pool, nullptr);
+    frameChains_m.clear();
+    statistics_m.poolCount_m = 0;
+}
+
+VkDescriptorPool VkDescriptorAllocator::createPool(uint32_t maxSets)
+{
+    // descriptors of each type per set, a set needing more than a pool holds cannot be allocated
+    static const std::vector<std::pair<VkDescriptorType, uint32_t>> descriptorsPerSet =
+    {
+        {VK_DESCRIPTOR_TYPE_SAMPLER,                1},
+        {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4},
+        {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,          4},
+        {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,          1},
+        {VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER,   1},
+        {VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER,   1},
+        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,         2},
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,         4},
+        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 2},
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1},
+        {VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT,       1}
+    };
+    std::vector<VkDescriptorPoolSize> poolSizes;
+    for (const auto& type : descriptorsPerSet)
+        poolSizes.push_back({type.first, type.second * maxSets});
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    // no FREE_DESCRIPTOR_SET_BIT, the sets are released by resetting the pool
+    poolInfo.flags = 0;
+    poolInfo.maxSets = maxSets;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+    VkDescriptorPool pool;
+    if (vkCreateDescriptorPool(device_m, &poolInfo, nullptr, &pool) != VK_SUCCESS)
+        throw std::runtime_error("failed to create descriptor pool!");
+    statistics_m.poolCount_m++;
+    return pool;
+}
+
+void VkDescriptorAllocator::resetChain(PoolChain& chain)
+{
+    // the pools past current_m have not been allocated from since the last reset
+    auto usedCount = std::min(chain.current_m + 1, chain.pools_m.size());
+    for (size_t i = 0; i < usedCount; i++)
+        vkResetDescriptorPool(device_m, chain.pools_m[i], 0);
+    statistics_m.poolResetCount_m += usedCount;
+    chain.current_m = 0;
+}
+
+void VkDescriptorAllocator::beginFrame(size_t frameIndex)
+{
+    std::lock_guard<std::mutex> lock(mutex_m);
+    resetChain(frameChains_m.at(frameIndex));
+}
+
+VkDescriptorSet VkDescriptorAllocator::allocate(const VkDescriptorSetLayout& setLayout, Lifetime lifetime,
+    size_t frameIndex)
+{
+    std::lock_guard<std::mutex> lock(mutex_m);
+    auto& chain = lifetime == Lifetime::PERSISTENT ? persistentChain_m : frameChains_m.at(frameIndex);
+    while (true) {
+        auto newPool = chain.current_m == chain.pools_m.size();
+        if (newPool) {
+            // each pool of a chain is twice as large as the previous one
+            auto maxSets = static_cast<uint32_t>(std::min<uint64_t>(
+                static_cast<uint64_t>(setsPerPool_m) << std::min<size_t>(chain.pools_m.size(), 16),
+                MAX_SETS_PER_POOL));
+            chain.pools_m.push_back(createPool(maxSets));
+        }
+        VkDescriptorSetAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = chain.pools_m[chain.current_m];
+        allocInfo.descriptorSetCount = 1;
+        allocInfo.pSetLayouts = &setLayout;
+        VkDescriptorSet descriptorSet;
+        auto result = vkAllocateDescriptorSets(device_m, &allocInfo, &descriptorSet);
+        if (result == VK_SUCCESS) {
+            statistics_m.allocatedSetCount_m++;
+            return descriptorSet;
+        }
+        if (result != VK_ERROR_OUT_OF_POOL_MEMORY && result != VK_ERROR_FRAGMENTED_POOL)
+            throw std::runtime_error("failed to allocate descriptor set!");
+        // an empty pool which cannot hold the set never will
+        if (newPool)
+            throw std::runtime_error("failed to allocate descriptor set, it does not fit in an empty pool!");
+        // the pool is full, the next one of the chain is tried
+        chain.current_m++;
+    }
+}
+
+VkDescriptorSet VkDescriptorAllocator::allocate(const VkPipelineLayout& pipelineLayout, uint32_t set,
+    Lifetime lifetime, size_t frameIndex)
+{
+    const auto& setLayouts = layoutCache_m->getSetLayouts(pipelineLayout);
+    if (set >= setLayouts.size())
+        throw std::runtime_error("failed to allocate descriptor set, the pipeline layout has no such set!");
+    return allocate(setLayouts[set], lifetime, frameIndex);
+}
+
+const VkDescriptorAllocator::UpdateTemplate& VkDescriptorAllocator::getUpdateTemplate(
+    const VkDescriptorSetLayout& setLayout)
+{
+    auto cached = updateTemplates_m.find(setLayout);
+    if (cached != updateTemplates_m.end())
+        return cached->second;
+
+    UpdateTemplate updateTemplate;
+    updateTemplate.bindings_m = layoutCache_m->getSetLayoutBindings(setLayout);
+    // the descriptors of the bindings follow each other in the DescriptorInfo array
+    std::vector<VkDescriptorUpdateTemplateEntry> entries;
+    for (const auto& binding : updateTemplate.bindings_m) {
+        VkDescriptorUpdateTemplateEntry entry{};
+        entry.dstBinding = binding.binding;
+        entry.dstArrayElement = 0;
+        entry.descriptorCount = binding.descriptorCount;
+        entry.descriptorType = binding.descriptorType;
+        entry.offset = sizeof(DescriptorInfo) * updateTemplate.descriptorCount_m;
+        entry.stride = sizeof(DescriptorInfo);
+        entries.push_back(entry);
+        updateTemplate.descriptorCount_m += binding.descriptorCount;
+    }
+    if (createUpdateTemplate_m != nullptr && !entries.empty()) {
+        VkDescriptorUpdateTemplateCreateInfo templateInfo{};
+        templateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO;
+        templateInfo.descriptorUpdateEntryCount = static_cast<uint32_t>(entries.size());
+        templateInfo.pDescriptorUpdateEntries = entries.data();
+        templateInfo.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET;
+        templateInfo.descriptorSetLayout = setLayout;
+        if (createUpdateTemplate_m(device_m, &templateInfo, nullptr, &updateTemplate.template_m) != VK_SUCCESS)
+            throw std::runtime_error("failed to create descriptor update template!");
+    }
+    return updateTemplates_m.emplace(setLayout, updateTemplate).first->second;
+}
+
+void VkDescriptorAllocator::write(const VkDescriptorSet& descriptorSet, const VkDescriptorSetLayout& setLayout,
+    const std::vector<DescriptorInfo>& infos)
+{
+    const UpdateTemplate* updateTemplate;
+    {
+        // the templates are never erased before the allocator is destroyed, so the entry stays valid
+        std::lock_guard<std::mutex> lock(mutex_m);
+        updateTemplate = &getUpdateTemplate(setLayout);
+        statistics_m.writtenSetCount_m++;
+    }
+    if (infos.size() != updateTemplate->descriptorCount_m)
+        throw std::runtime_error("failed to write descriptor set, the descriptors do not match its layout!");
+    if (updateTemplate->template_m != VK_NULL_HANDLE) {
+        // a single call reading the descriptors straight from infos
+        updateWithTemplate_m(device_m, descriptorSet, updateTemplate->template_m, infos.data());
+        return;
+    }
+    // without the extension, the same descriptors unpacked into one write per binding
+    std::vector<VkDescriptorBufferInfo> bufferInfos(infos.size());
+    std::vector<VkDescriptorImageInfo> imageInfos(infos.size());
+    std::vector<VkBufferView> texelBufferViews(infos.size());
+    std::vector<VkWriteDescriptorSet> writes;
+    size_t first = 0;
+    for (const auto& binding : updateTemplate->bindings_m) {
+        VkWriteDescriptorSet write{};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = descriptorSet;
+        write.dstBinding = binding.binding;
+        write.descriptorCount = binding.descriptorCount;
+        write.descriptorType = binding.descriptorType;
+        for (size_t i = first; i < first + binding.descriptorCount; i++) {
+            switch (binding.descriptorType) {
+                case VK_DESCRIPTOR_TYPE_SAMPLER:
+                case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+                case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+                case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+                case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
+                    imageInfos[i] = infos[i].image_m;
+                    write.pImageInfo = &imageInfos[first];
+                    break;
+                case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:
+                case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER:
+                    texelBufferViews[i] = infos[i].texelBufferView_m;
+                    write.pTexelBufferView = &texelBufferViews[first];
+                    break;
+                default:
+                    bufferInfos[i] = infos[i].buffer_m;
+                    write.pBufferInfo = &bufferInfos[first];
+                    break;
+            }
+        }
+        first += binding.descriptorCount;
+        if (binding.descriptorCount > 0)
+            writes.push_back(write);
+    }
+    vkUpdateDescriptorSets(device_m, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+}
+
+VkDescriptorAllocator::Statistics VkDescriptorAllocator::getStatistics() const
+{
+    std::lock_guard<std::mutex> lock(mutex_m);
+    return statistics_m;
+}
+
+void VkDescriptorAllocator::printStatistics() const
+{
+    auto statistics = getStatistics();
+    std::cout << "descriptor allocator : " << statistics.poolCount_m << " pools, "
+        << statistics.allocatedSetCount_m << " sets allocated, " << statistics.writtenSetCount_m << " written, "
+        << statistics.poolResetCount_m << " pool resets" << std::endl;
+}
@@ -4,6 +4,14 @@
 #include <set>
 #include <cstdint>
 #include <algorithm>
+#include <cstring>
+
+VkDeviceManager::VkDeviceManager(bool headless) : headless_m(headless)
+{
+    // swap chain extension is only necessary for presentation
+    if (headless_m)
+        deviceExtensions_m.clear();
+}
 
 const VkDevice& VkDeviceManager::getDevice() const
     {return device_m;}
@@ -17,6 +25,18 @@ const VkQueue& VkDeviceManager::getGraphicsQueueRef() const
 const VkQueue& VkDeviceManager::getPresentQueueRef() const
     {return presentQueue_m;}
 
+const VkQueue& VkDeviceManager::getTransferQueueRef() const
+    {return transferQueue_m;}
+
+bool VkDeviceManager::isHeadless() const
+    {return headless_m;}
+
+bool VkDeviceManager::isMultiDrawIndirectEnabled() const
+    {return multiDrawIndirect_m;}
+
+bool VkDeviceManager::isDescriptorUpdateTemplateEnabled() const
+    {return descriptorUpdateTemplate_m;}
+
 void VkDeviceManager::destroyLogicalDevice(const VkInstance& instance)
 {
     // VkQueue is automatically destroyed when its device is deleted
@@ -65,13 +85,13 @@ bool VkDeviceManager::isDeviceSuitable(const VkPhysicalDevice& device)
     //     && deviceFeatures.geometryShader;
     auto indices = findQueueFamilies(device);
     bool extensionsSupported = checkDeviceExtensionSupport(device);
-    bool swapChainAdequate = false;
-    if (extensionsSupported) {
+    bool swapChainAdequate = headless_m;
+    if (extensionsSupported && !headless_m) {
         auto swapChainSupport = querySwapChainSupport(device);
         swapChainAdequate = !swapChainSupport.formats_m.empty() && 
             !swapChainSupport.presentModes_m.empty();
     }
-    return indices.isComplete() && extensionsSupported 
+    return indices.isComplete(headless_m) && extensionsSupported 
         && swapChainAdequate;
 }
 
@@ -126,28 +146,67 @@ VkDeviceManager::QueueFamilyIndices VkDeviceManager::findQueueFamilies
     std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
     vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
     // check whether at least one queueFamily support VK_QUEUEGRAPHICS_BIT
-    int i = 0;
-    VkBool32 presentSupport = false;
+    uint32_t i = 0;
+    bool graphicsCanPresent = false;
     for (const auto& queueFamily : queueFamilies){
-        // same i for presentFamily and graphicsFamily improves the performance
+        VkBool32 presentSupport = false;
         // vulkan: No DRI3 support detected - required for presentation
         // Note: you can probably enable DRI3 in your Xorg config
-        vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_m, &presentSupport);
-        if (presentSupport) indices.presentFamily_m = i;
-        if (queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) {
-            indices.graphicsFamily_m = i;
-            if(presentSupport) break;
+        // there is no surface to query in headless mode
+        if (!headless_m)
+            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_m, &presentSupport);
+        if (presentSupport && !indices.presentFamily_m.has_value())
+            indices.presentFamily_m = i;
+        if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+            // same i for presentFamily and graphicsFamily improves the performance
+            if (!indices.graphicsFamily_m.has_value() || (presentSupport && !graphicsCanPresent)) {
+                indices.graphicsFamily_m = i;
+                graphicsCanPresent = presentSupport;
+                if (presentSupport) indices.presentFamily_m = i;
+            }
         }
         i++;
     }
+    // a family with transfer but without graphics and compute is usually a DMA engine
+    // which copies while the graphics queue is rendering
+    // a compute family which can transfer is the next best choice
+    std::optional<uint32_t> computeFamily;
+    for (i = 0; i < queueFamilyCount; i++) {
+        auto flags = queueFamilies[i].queueFlags;
+        if (!(flags & VK_QUEUE_TRANSFER_BIT) || (flags & VK_QUEUE_GRAPHICS_BIT))
+            continue;
+        if (!(flags & VK_QUEUE_COMPUTE_BIT)) {
+            indices.transferFamily_m = i;
+            break;
+        }
+        if (!computeFamily.has_value())
+            computeFamily = i;
+    }
+    if (!indices.transferFamily_m.has_value())
+        indices.transferFamily_m = computeFamily.has_value() ? computeFamily : indices.graphicsFamily_m;
     return indices;
 }
 
-inline bool VkDeviceManager::QueueFamilyIndices::isComplete()
+inline bool VkDeviceManager::QueueFamilyIndices::isComplete(bool headless)
+{
+    // graphics queues always support transfer, so transferFamily_m is set with graphicsFamily_m
+    return graphicsFamily_m.has_value() && (headless || presentFamily_m.has_value());
+}
+
+uint32_t VkDeviceManager::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties,
+    const VkPhysicalDevice& physicalDevice)
 {
-    // changed to transfer queue
-    // return graphicsFamily_m.has_value() && presentFamily_m.has_value();
-    return graphicsFamily_m.has_value() && presentFamily_m.has_value();
+    // available types of memory
+    VkPhysicalDeviceMemoryProperties memProperties;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+        // check if the result of the bitwise AND is not just non-zero, 
+        // but equal to the desired properties bit field
+        if (typeFilter & (1 << i) && 
+            (memProperties.memoryTypes[i].propertyFlags & properties) == properties) 
+            return i;
+    }
+    throw std::runtime_error("failed to find suitable memory type!");
 }
 
 void VkDeviceManager::createLogicalDevice
@@ -157,8 +216,10 @@ void VkDeviceManager::createLogicalDevice
     // create a set of all unique queue famililes that are necessary for required queues
     std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
     // if queue families are the same, handle for those queues are also same
-    std::set<uint32_t> uniqueQueueFamilies = 
-    {indices.graphicsFamily_m.value(), indices.presentFamily_m.value()};
+    std::set<uint32_t> uniqueQueueFamilies =
+        {indices.graphicsFamily_m.value(), indices.transferFamily_m.value()};
+    if (!headless_m)
+        uniqueQueueFamilies.insert(indices.presentFamily_m.value());
     float queuePriority = 1.0f;
     for (uint32_t queueFamily : uniqueQueueFamilies) {
         // VkDeviceQueueCreateInfo descrives the number of queues we want for a single queue family
@@ -172,18 +233,34 @@ void VkDeviceManager::createLogicalDevice
         queueCreateInfo.pQueuePriorities = &queuePriority;
         queueCreateInfos.push_back(queueCreateInfo);
     }
-    // we need nothing special right now
+    // only optional features are enabled, the renderer falls back when they are missing
+    VkPhysicalDeviceFeatures supportedFeatures;
+    vkGetPhysicalDeviceFeatures(physicalDevice_m, &supportedFeatures);
     VkPhysicalDeviceFeatures deviceFeatures{};
+    // many indirect draws in one command for the GPU driven path
+    deviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+    multiDrawIndirect_m = supportedFeatures.multiDrawIndirect == VK_TRUE;
+    // optional extensions as well, core since Vulkan 1.1 but the instance asks for 1.0
+    uint32_t extensionCount;
+    vkEnumerateDeviceExtensionProperties(physicalDevice_m, nullptr, &extensionCount, nullptr);
+    std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(physicalDevice_m, nullptr, &extensionCount, availableExtensions.data());
+    auto enabledExtensions = deviceExtensions_m;
+    // descriptor sets written from a packed array in one call
+    descriptorUpdateTemplate_m = std::any_of(availableExtensions.begin(), availableExtensions.end(),
+        [](const auto& extension)
+            { return std::strcmp(extension.extensionName, VK_KHR_DESCRIPTOR_UPDATE_TEMPLATE_EXTENSION_NAME) == 0; });
+    if (descriptorUpdateTemplate_m)
+        enabledExtensions.push_back(VK_KHR_DESCRIPTOR_UPDATE_TEMPLATE_EXTENSION_NAME);
     // filling in the main VkDeviceCreateInfo structure;
     VkDeviceCreateInfo createInfo{};
     createInfo.sType =  VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
     createInfo.pQueueCreateInfos = queueCreateInfos.data();
     createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
-    // nothing right now
     createInfo.pEnabledFeatures = &deviceFeatures;
     // enable device extension 
-    createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions_m.size());
-    createInfo.ppEnabledExtensionNames = deviceExtensions_m.data();
+    createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+    createInfo.ppEnabledExtensionNames = enabledExtensions.data();
     if (enableValidationLayers) {
         createInfo.enabledLayerCount =
             static_cast<uint32_t>(validationLayers.size());
@@ -199,7 +276,10 @@ void VkDeviceManager::createLogicalDevice
     // retrieve queue handles for each queue family
     // simply use index 0, because were only creating a single queue from  this family
     vkGetDeviceQueue(device_m, indices.graphicsFamily_m.value(), 0, &graphicsQueue_m);
-    vkGetDeviceQueue(device_m, indices.presentFamily_m.value(), 0, &presentQueue_m);
+    vkGetDeviceQueue(device_m, indices.transferFamily_m.value(), 0, &transferQueue_m);
+    // offscreen images are never presented
+    if (!headless_m)
+        vkGetDeviceQueue(device_m, indices.presentFamily_m.value(), 0, &presentQueue_m);
 }
 
 void VkDeviceManager::createSurface
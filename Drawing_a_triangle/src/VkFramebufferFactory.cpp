@@ -15,13 +15,14 @@ void VkFramebufferFactory::createFramebuffers
     swapChainFramebuffers_m.resize(swapChainImageViews.size());
 
     for(size_t i = 0; i < swapChainImageViews.size(); i++) {
-        VkImageView attachments[] = { swapChainImageViews[i] };
+        // in the order of the attachments of the render pass
+        VkImageView attachments[] = { swapChainImageViews[i], depthImageView_m };
         VkFramebufferCreateInfo framebufferInfo{};
         framebufferInfo.sType = 
             VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
         // renderPass the framebuffer needs to be compatible
         framebufferInfo.renderPass = renderPass;
-        framebufferInfo.attachmentCount = 1;
+        framebufferInfo.attachmentCount = 2;
         framebufferInfo.pAttachments = attachments;
         framebufferInfo.width = swapChainExtent.width;
         framebufferInfo.height = swapChainExtent.height;
@@ -38,4 +39,94 @@ void VkFramebufferFactory::destroyFramebuffers(const VkDeviceManager& deviceMana
     const auto& device = deviceManager.getDevice();
     for(const auto& framebuffer : swapChainFramebuffers_m) 
         vkDestroyFramebuffer(device, framebuffer, nullptr);
-}
\ No newline at end of file
+    swapChainFramebuffers_m.clear();
+}
+
+void VkFramebufferFactory::retireFramebuffers
+    (const VkDevice& device, VkRetireQueue& retireQueue, const std::vector<VkFence>& fences)
+{
+    auto framebuffers = std::move(swapChainFramebuffers_m);
+    swapChainFramebuffers_m.clear();
+    retireQueue.retire(fences, [device, framebuffers]()
+        {
+            for (const auto& framebuffer : framebuffers)
+                vkDestroyFramebuffer(device, framebuffer, nullptr);
+        });
+}
+
+// the first one supported as a depth attachment, D16 is always supported
+VkFormat VkFramebufferFactory::chooseDepthFormat(const VkPhysicalDevice& physicalDevice)
+{
+    const VkFormat candidates[] = {
+        VK_FORMAT_D32_SFLOAT,
+        VK_FORMAT_D32_SFLOAT_S8_UINT,
+        VK_FORMAT_D24_UNORM_S8_UINT,
+        VK_FORMAT_D16_UNORM
+    };
+    for (const auto& format : candidates) {
+        VkFormatProperties properties;
+        vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &properties);
+        if (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT)
+            return format;
+    }
+    throw std::runtime_error("failed to find a depth format!");
+}
+
+void VkFramebufferFactory::createDepthBuffer(const VkDeviceManager& deviceManager,
+    VkMemoryAllocator& memoryAllocator, const VkExtent2D& extent)
+{
+    auto format = chooseDepthFormat(deviceManager.getPhysicalDevice());
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = format;
+    imageInfo.extent = {extent.width, extent.height, 1};
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    // cleared and discarded by the render pass, never read outside of it
+    imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    memoryAllocator.createImage(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        depthImage_m, depthImageAllocation_m);
+
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = depthImage_m;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = format;
+    // the stencil aspect of the combined formats is not used
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+    viewInfo.subresourceRange.baseMipLevel = 0;
+    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.baseArrayLayer = 0;
+    viewInfo.subresourceRange.layerCount = 1;
+    if (vkCreateImageView(deviceManager.getDevice(), &viewInfo, nullptr, &depthImageView_m) != VK_SUCCESS)
+        throw std::runtime_error("failed to create depth image view!");
+}
+
+void VkFramebufferFactory::destroyDepthBuffer(const VkDevice& device, VkMemoryAllocator& memoryAllocator)
+{
+    vkDestroyImageView(device, depthImageView_m, nullptr);
+    memoryAllocator.destroyImage(depthImage_m, depthImageAllocation_m);
+    depthImageView_m = VK_NULL_HANDLE;
+    depthImage_m = VK_NULL_HANDLE;
+}
+
+void VkFramebufferFactory::retireDepthBuffer(const VkDevice& device, VkMemoryAllocator& memoryAllocator,
+    VkRetireQueue& retireQueue, const std::vector<VkFence>& fences)
+{
+    auto image = depthImage_m;
+    auto allocation = depthImageAllocation_m;
+    auto imageView = depthImageView_m;
+    depthImage_m = VK_NULL_HANDLE;
+    depthImageView_m = VK_NULL_HANDLE;
+    auto* pMemoryAllocator = &memoryAllocator;
+    retireQueue.retire(fences, [device, pMemoryAllocator, image, allocation, imageView]() mutable
+        {
+            vkDestroyImageView(device, imageView, nullptr);
+            pMemoryAllocator->destroyImage(image, allocation);
+        });
+}
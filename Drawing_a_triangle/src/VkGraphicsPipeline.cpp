@@ -1,104 +1,309 @@
-#include <fstream>
 #include <string>
 #include <vector>
 #include <iostream>
+#include <chrono>
+#include <iterator>
+#include <set>
+#include <tuple>
+#include <algorithm>
 #include <VkGraphicsPipeline.hpp>
 #include <VkRenderPass.hpp>
-#include <VkVertexManager.hpp>
+#include <VkShaderReflection.hpp>
+#include <FileUtils.hpp>
+
+bool VkGraphicsPipelineFactory::PipelineVariant::operator<(const PipelineVariant& other) const
+{
+    return std::tie(topology_m, blendMode_m, cullMode_m)
+        < std::tie(other.topology_m, other.blendMode_m, other.cullMode_m);
+}
+
+std::string VkGraphicsPipelineFactory::PipelineVariant::getName() const
+{
+    std::string name;
+    switch (topology_m) {
+        case VK_PRIMITIVE_TOPOLOGY_POINT_LIST:      name = "points";            break;
+        case VK_PRIMITIVE_TOPOLOGY_LINE_LIST:       name = "lines";             break;
+        case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP:      name = "line strip";        break;
+        case VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST:   name = "triangles";         break;
+        case VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP:  name = "triangle strip";    break;
+        default: name = "topology " + std::to_string(topology_m);               break;
+    }
+    switch (blendMode_m) {
+        case BlendMode::OPAQUE:     name += ", opaque";     break;
+        case BlendMode::ALPHA:      name += ", alpha";      break;
+        case BlendMode::ADDITIVE:   name += ", additive";   break;
+    }
+    switch (cullMode_m) {
+        case VK_CULL_MODE_NONE:             name += ", no culling";     break;
+        case VK_CULL_MODE_FRONT_BIT:        name += ", front culling";  break;
+        case VK_CULL_MODE_BACK_BIT:         name += ", back culling";   break;
+        default:                            name += ", culling all";    break;
+    }
+    return name;
+}
 
 const VkRenderPass& VkGraphicsPipelineFactory::getRenderPassRef()
 {
     return renderPass_m;
 }
 
-const VkPipeline& VkGraphicsPipelineFactory::getGraphicsPipelineRef()
+const VkPipeline& VkGraphicsPipelineFactory::getGraphicsPipelineRef(const PipelineVariant& variant)
 {
-    return graphicsPipeline_m;
+    std::lock_guard<std::mutex> lock(variantsMutex_m);
+    auto compiled = variants_m.find(variant);
+    if (compiled != variants_m.end())
+        return compiled->second.pipeline_m;
+    // built from the same code as the others, even if a reload is waiting
+    auto lazyVariant = compileVariants(vertShaderCode_m, fragShaderCode_m, {variant}, nullptr).front();
+    lazyVariant.lazy_m = true;
+    std::cout << "the " << variant.getName() << " pipeline has been compiled on first use! ("
+        << lazyVariant.compileMs_m << " ms)" << std::endl;
+    return variants_m.emplace(variant, lazyVariant).first->second.pipeline_m;
 }
 
-static std::vector<char> readFile(const std::string& filename)
+const VkPipelineLayout& VkGraphicsPipelineFactory::getPipelineLayoutRef()
 {
-    // ate : start reading at the end of the file
-    // binary : read  the file as binary file
-    std::ifstream file(filename, std::ios::ate | std::ios::binary);
-    if (!file.is_open()) {
-        throw std::runtime_error("failed to open file!");
-    }
-    size_t fileSize = (size_t) file.tellg();
-    std::vector<char> buffer(fileSize);
-    file.seekg(0);
-    file.read(buffer.data(), fileSize);
-    file.close();
-    return buffer;
+    return pipelineLayout_m;
+}
+
+const VkShaderReflection::ShaderInterface& VkGraphicsPipelineFactory::getShaderInterfaceRef()
+{
+    return interface_m;
 }
 
-void VkGraphicsPipelineFactory::createRenderPass(const VkDevice& device, const VkFormat& swapChainImageFormat)
+const std::string& VkGraphicsPipelineFactory::getVertShaderPathRef()
+{
+    return vertShaderPath_m;
+}
+
+void VkGraphicsPipelineFactory::createRenderPass(const VkDevice& device, const VkFormat& swapChainImageFormat,
+    const VkImageLayout& finalLayout, const VkFormat& depthFormat)
 {
     // render pass
-    renderPassFactory_m.createRenderPass(device, swapChainImageFormat, &renderPass_m);
+    renderPassFactory_m.createRenderPass(device, swapChainImageFormat, finalLayout, depthFormat, &renderPass_m);
+}
+
+void VkGraphicsPipelineFactory::createGraphicsPipeline(const VkDevice& device, const VkPipelineCache& pipelineCache,
+    VkLayoutCacheManager& layoutCache, uint32_t maxPushConstantsSize,
+    const std::vector<VkVertexInputBindingDescription>& bindingDescriptions,
+    const std::vector<VkVertexInputAttributeDescription>& attributeDescriptions,
+    ThreadPool& threadPool, const std::vector<PipelineVariant>& variants)
+{
+    device_m = device;
+    pipelineCache_m = pipelineCache;
+    layoutCache_m = &layoutCache;
+    maxPushConstantsSize_m = maxPushConstantsSize;
+    bindingDescriptions_m = bindingDescriptions;
+    attributeDescriptions_m = attributeDescriptions;
+    vertShaderPath_m = "./spv/vert.spv";
+    vertShaderCode_m = FileUtils::readFile(vertShaderPath_m);
+    fragShaderCode_m = FileUtils::readFile("./spv/frag.spv");
+    // the shaders may have been reloaded with another interface since the last creation
+    interface_m = reflectInterface(vertShaderCode_m, fragShaderCode_m, attributeDescriptions);
+    const auto& pushConstantRange = interface_m.pushConstantRange_m;
+    if (pushConstantRange.offset + pushConstantRange.size > maxPushConstantsSize) {
+        std::cout << "the push constants of the shaders take " << pushConstantRange.offset + pushConstantRange.size
+            << " bytes out of " << maxPushConstantsSize << ", the per-draw data goes through the uniform ring"
+            << std::endl;
+        vertShaderPath_m = "./spv/vert_draw_uniform.spv";
+        vertShaderCode_m = FileUtils::readFile(vertShaderPath_m);
+        interface_m = reflectInterface(vertShaderCode_m, fragShaderCode_m, attributeDescriptions);
+    }
+    pipelineLayout_m = createPipelineLayout(layoutCache, interface_m, maxPushConstantsSize);
+    // the default variant is the one drawn with until another is requested
+    std::set<PipelineVariant> declaredVariants(variants.begin(), variants.end());
+    declaredVariants.insert(PipelineVariant{});
+    std::vector<PipelineVariant> eagerVariants(declaredVariants.begin(), declaredVariants.end());
+    auto start = std::chrono::steady_clock::now();
+    auto compiled = compileVariants(vertShaderCode_m, fragShaderCode_m, eagerVariants, &threadPool);
+    auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start);
+    std::lock_guard<std::mutex> lock(variantsMutex_m);
+    variants_m.clear();
+    for (size_t i = 0; i < eagerVariants.size(); i++)
+        variants_m.emplace(eagerVariants[i], compiled[i]);
+    std::cout << "the graphics pipelines have been created! (" << eagerVariants.size() << " variants, "
+        << elapsed.count() << " ms)" << std::endl;
+}
+
+VkGraphicsPipelineFactory::PipelineSet VkGraphicsPipelineFactory::buildGraphicsPipelines() const
+{
+    PipelineSet pipelines;
+    pipelines.vertShaderCode_m = FileUtils::readFile(vertShaderPath_m);
+    pipelines.fragShaderCode_m = FileUtils::readFile("./spv/frag.spv");
+    // checked before any module is created, the recorded commands keep using the current layout
+    // and the descriptors written for the current uniform block sizes, which the layout does not include
+    auto interface = reflectInterface(pipelines.vertShaderCode_m, pipelines.fragShaderCode_m, attributeDescriptions_m);
+    auto sameBlockSizes = std::equal(interface.descriptorBindings_m.begin(), interface.descriptorBindings_m.end(),
+        interface_m.descriptorBindings_m.begin(), interface_m.descriptorBindings_m.end(),
+        [](const auto& a, const auto& b) { return a.blockSize_m == b.blockSize_m; });
+    if (createPipelineLayout(*layoutCache_m, interface, maxPushConstantsSize_m) != pipelineLayout_m ||
+        !sameBlockSizes)
+        throw std::runtime_error("failed to reload shaders, their interface changed and needs a restart!");
+    std::vector<PipelineVariant> variants;
+    std::vector<bool> lazy;
+    {
+        std::lock_guard<std::mutex> lock(variantsMutex_m);
+        for (const auto& variant : variants_m) {
+            variants.push_back(variant.first);
+            lazy.push_back(variant.second.lazy_m);
+        }
+    }
+    // the thread pool records the frames meanwhile, so all the variants go in a single batch
+    auto compiled = compileVariants(pipelines.vertShaderCode_m, pipelines.fragShaderCode_m, variants, nullptr);
+    for (size_t i = 0; i < variants.size(); i++) {
+        compiled[i].lazy_m = lazy[i];
+        pipelines.variants_m.emplace(variants[i], compiled[i]);
+    }
+    return pipelines;
 }
 
-void VkGraphicsPipelineFactory::createGraphicsPipeline
-    (const VkDevice& device, const VkExtent2D& swapChainExtent)
+void VkGraphicsPipelineFactory::replaceGraphicsPipelines(PipelineSet& pipelines, VkRetireQueue& retireQueue,
+    const std::vector<VkFence>& fences)
 {
-    auto vertShaderCode = readFile("./spv/vert.spv");
-    auto fragShaderCode = readFile("./spv/frag.spv");
-    vertShaderModule_m  = createShaderModule(vertShaderCode, device);
-    fragShaderModule_m  = createShaderModule(fragShaderCode, device);
+    std::vector<VkPipeline> oldPipelines;
+    std::lock_guard<std::mutex> lock(variantsMutex_m);
+    // a variant compiled on first use while the set was being built is missing from it,
+    // it is retired with the others and compiled again from the new code when used
+    for (const auto& variant : variants_m)
+        oldPipelines.push_back(variant.second.pipeline_m);
+    variants_m = std::move(pipelines.variants_m);
+    vertShaderCode_m = std::move(pipelines.vertShaderCode_m);
+    fragShaderCode_m = std::move(pipelines.fragShaderCode_m);
+    pipelines.variants_m.clear();
+    auto device = device_m;
+    retireQueue.retire(fences, [device, oldPipelines]()
+        {
+            for (auto pipeline : oldPipelines)
+                vkDestroyPipeline(device, pipeline, nullptr);
+        });
+}
+
+void VkGraphicsPipelineFactory::destroyPipelineSet(const VkDevice& device, PipelineSet& pipelines)
+{
+    for (auto& variant : pipelines.variants_m)
+        vkDestroyPipeline(device, variant.second.pipeline_m, nullptr);
+    pipelines.variants_m.clear();
+}
+
+void VkGraphicsPipelineFactory::printStatistics() const
+{
+    std::lock_guard<std::mutex> lock(variantsMutex_m);
+    std::cout << "graphics pipeline variants :" << std::endl;
+    for (const auto& variant : variants_m) {
+        const auto& compiled = variant.second;
+        std::cout << "  " << variant.first.getName() << " : " << compiled.compileMs_m << " ms"
+            << (compiled.lazy_m ? ", compiled on first use" : "");
+        if (compiled.batchSize_m > 1)
+            std::cout << ", in a batch of " << compiled.batchSize_m;
+        std::cout << std::endl;
+    }
+}
+
+std::vector<VkGraphicsPipelineFactory::CompiledVariant> VkGraphicsPipelineFactory::compileVariants(
+    const std::vector<char>& vertShaderCode, const std::vector<char>& fragShaderCode,
+    const std::vector<PipelineVariant>& variants, ThreadPool* threadPool) const
+{
+    // the modules are shared by every batch
+    auto vertShaderModule = createShaderModule(vertShaderCode, device_m);
+    VkShaderModule fragShaderModule;
+    try {
+        fragShaderModule = createShaderModule(fragShaderCode, device_m);
+    } catch (...) {
+        vkDestroyShaderModule(device_m, vertShaderModule, nullptr);
+        throw;
+    }
     // assign these modules to a specific pipeline stage
-    // auto vertShaderStageInfo    = createVertexShaderStageInfo();
-    // auto fragShaderStageInfo    = createFragmentShaderStageInfo();
     VkPipelineShaderStageCreateInfo shaderStages[]
-        = {createVertexShaderStageInfo(), createFragmentShaderStageInfo()};
+        = {createVertexShaderStageInfo(vertShaderModule), createFragmentShaderStageInfo(fragShaderModule)};
     // fixed functions
     auto vertexInputInfo    =   createVertexInputInfo();
     // accept vertex data
-    auto bindingDescription = VkVertexManager::Vertex::getBindingDescription();
-    auto attributeDescriptions = VkVertexManager::Vertex::getAttributeDescriptions();
-    vertexInputInfo.vertexBindingDescriptionCount = 1;
-    vertexInputInfo.pVertexBindingDescriptions = &bindingDescription; //optional
+    vertexInputInfo.vertexBindingDescriptionCount =
+        static_cast<uint32_t>(bindingDescriptions_m.size());
+    vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions_m.data(); //optional
     vertexInputInfo.vertexAttributeDescriptionCount = 
-        static_cast<uint32_t>(attributeDescriptions.size());
-    vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data(); //optional
-    auto inputAssemblyInfo  =   createInputAssemblyInfo();
-    // viewport
-    auto viewport   =           createViewport(swapChainExtent);
-    auto scissor    =           createScissor(swapChainExtent);
-    auto viewportInfo =         createViewportInfo(viewport, scissor);
-    auto rasterizer =           createRasterizer();
+        static_cast<uint32_t>(attributeDescriptions_m.size());
+    vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions_m.data(); //optional
+    // viewport and scissor are dynamic, so the pipeline survives resizes
+    auto viewportInfo =         createViewportInfo();
     auto multisampling =        createMultisampleState();
-    auto colorBlendAttachment = createColorBlendingAttachment();
-    auto colorBlendState =      createColorBlendingState(colorBlendAttachment);
+    auto dynamicState =         createDynamicState();
 
-    // pipeline creation
-    VkGraphicsPipelineCreateInfo pipelineInfo{};
-    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-    // shader stages
-    pipelineInfo.stageCount = 2; // vertex and fragments stage
-    pipelineInfo.pStages = shaderStages;
-    // fixed functions
-    pipelineInfo.pVertexInputState = &vertexInputInfo;
-    pipelineInfo.pInputAssemblyState = &inputAssemblyInfo;
-    pipelineInfo.pViewportState = &viewportInfo;
-    pipelineInfo.pRasterizationState = &rasterizer;
-    pipelineInfo.pMultisampleState = &multisampling;
-    pipelineInfo.pDepthStencilState = nullptr;
-    pipelineInfo.pColorBlendState = &colorBlendState;
-    pipelineInfo.pDynamicState = nullptr;
-    // pipeline layout
-    createPipelineLayout(device);
-    pipelineInfo.layout = pipelineLayout_m;
-    // pass by copy?
-    pipelineInfo.renderPass = renderPass_m;
-    pipelineInfo.subpass = 0;
-    // its possible to create multiple VkPipeline objects in a single call
-    // second parameter means cache objects enables significantly faster creation
-    if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1,
-        &pipelineInfo, nullptr, &graphicsPipeline_m) != VK_SUCCESS)
-        throw std::runtime_error("failed to create graphics pipeline!");
-    std::cout << "the graphics pipeline has been created!" << std::endl;
-    vkDestroyShaderModule(device, vertShaderModule_m, nullptr);
-    vkDestroyShaderModule(device, fragShaderModule_m, nullptr);
+    std::vector<CompiledVariant> compiled(variants.size());
+    // the variants [first, first + count) with a single call, each batch writes its own elements of compiled
+    auto compileBatch = [&](size_t first, size_t count)
+    {
+        // the create infos point into these, so they are sized once
+        std::vector<VkPipelineInputAssemblyStateCreateInfo> inputAssemblyInfos(count);
+        std::vector<VkPipelineRasterizationStateCreateInfo> rasterizers(count);
+        std::vector<VkPipelineDepthStencilStateCreateInfo> depthStencilStates(count);
+        std::vector<VkPipelineColorBlendAttachmentState> colorBlendAttachments(count);
+        std::vector<VkPipelineColorBlendStateCreateInfo> colorBlendStates(count);
+        std::vector<VkGraphicsPipelineCreateInfo> pipelineInfos(count);
+        for (size_t i = 0; i < count; i++) {
+            const auto& variant = variants[first + i];
+            inputAssemblyInfos[i] =     createInputAssemblyInfo(variant.topology_m);
+            rasterizers[i] =            createRasterizer(variant.cullMode_m);
+            depthStencilStates[i] =     createDepthStencilState(variant.blendMode_m);
+            colorBlendAttachments[i] =  createColorBlendingAttachment(variant.blendMode_m);
+            colorBlendStates[i] =       createColorBlendingState(colorBlendAttachments[i]);
+            // pipeline creation
+            auto& pipelineInfo = pipelineInfos[i];
+            pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+            // shader stages
+            pipelineInfo.stageCount = 2; // vertex and fragments stage
+            pipelineInfo.pStages = shaderStages;
+            // fixed functions
+            pipelineInfo.pVertexInputState = &vertexInputInfo;
+            pipelineInfo.pInputAssemblyState = &inputAssemblyInfos[i];
+            pipelineInfo.pViewportState = &viewportInfo;
+            pipelineInfo.pRasterizationState = &rasterizers[i];
+            pipelineInfo.pMultisampleState = &multisampling;
+            pipelineInfo.pDepthStencilState = &depthStencilStates[i];
+            pipelineInfo.pColorBlendState = &colorBlendStates[i];
+            pipelineInfo.pDynamicState = &dynamicState;
+            // pipeline layout
+            pipelineInfo.layout = pipelineLayout_m;
+            pipelineInfo.renderPass = renderPass_m;
+            pipelineInfo.subpass = 0;
+        }
+        // its possible to create multiple VkPipeline objects in a single call
+        // second parameter means cache objects enables significantly faster creation
+        std::vector<VkPipeline> pipelines(count, VK_NULL_HANDLE);
+        auto start = std::chrono::steady_clock::now();
+        auto result = vkCreateGraphicsPipelines(device_m, pipelineCache_m, static_cast<uint32_t>(count),
+            pipelineInfos.data(), nullptr, pipelines.data());
+        auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start);
+        // on failure the pipelines which were created are kept, so they can be destroyed
+        for (size_t i = 0; i < count; i++)
+            compiled[first + i] = {pipelines[i], elapsed.count(), static_cast<uint32_t>(count), false};
+        if (result != VK_SUCCESS)
+            throw std::runtime_error("failed to create graphics pipeline!");
+    };
+    try {
+        auto batchCount = threadPool != nullptr
+            ? std::min<size_t>(threadPool->getThreadCount(), variants.size()) : 1;
+        if (batchCount <= 1) {
+            compileBatch(0, variants.size());
+        } else {
+            for (size_t batch = 0; batch < batchCount; batch++) {
+                auto first = variants.size() * batch / batchCount;
+                auto last = variants.size() * (batch + 1) / batchCount;
+                threadPool->submit([&compileBatch, first, last]() { compileBatch(first, last - first); });
+            }
+            threadPool->wait();
+        }
+    } catch (...) {
+        for (auto& variant : compiled)
+            vkDestroyPipeline(device_m, variant.pipeline_m, nullptr);
+        vkDestroyShaderModule(device_m, vertShaderModule, nullptr);
+        vkDestroyShaderModule(device_m, fragShaderModule, nullptr);
+        throw;
+    }
+    // the modules are only needed to create the pipelines
+    vkDestroyShaderModule(device_m, vertShaderModule, nullptr);
+    vkDestroyShaderModule(device_m, fragShaderModule, nullptr);
+    return compiled;
 }
 
 VkShaderModule VkGraphicsPipelineFactory::createShaderModule
@@ -116,26 +321,26 @@ VkShaderModule VkGraphicsPipelineFactory::createShaderModule
 }
 
 VkPipelineShaderStageCreateInfo 
-    VkGraphicsPipelineFactory::createVertexShaderStageInfo()
+    VkGraphicsPipelineFactory::createVertexShaderStageInfo(const VkShaderModule& module)
 {
     VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
     vertShaderStageInfo.sType = 
         VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-    vertShaderStageInfo.module = vertShaderModule_m;
+    vertShaderStageInfo.module = module;
     // the function to invoke
     vertShaderStageInfo.pName = "main";
     return vertShaderStageInfo;
 }
 
 VkPipelineShaderStageCreateInfo
-    VkGraphicsPipelineFactory::createFragmentShaderStageInfo()
+    VkGraphicsPipelineFactory::createFragmentShaderStageInfo(const VkShaderModule& module)
 {
     VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
     fragShaderStageInfo.sType = 
         VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-    fragShaderStageInfo.module = fragShaderModule_m;
+    fragShaderStageInfo.module = module;
     // the function to invoke
     fragShaderStageInfo.pName = "main";
     return fragShaderStageInfo;
@@ -153,57 +358,33 @@ VkPipelineVertexInputStateCreateInfo
 // what kind of geometry will be drawn from the vertices (topoloby) and
 // if primitive restart should be enabled
 VkPipelineInputAssemblyStateCreateInfo
-    VkGraphicsPipelineFactory::createInputAssemblyInfo()
+    VkGraphicsPipelineFactory::createInputAssemblyInfo(VkPrimitiveTopology topology)
 {
     VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
     inputAssembly.sType = 
         VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    inputAssembly.topology = topology;
     inputAssembly.primitiveRestartEnable = VK_FALSE;
     return inputAssembly;
 }
 
-// transformation of the image
-VkViewport VkGraphicsPipelineFactory::createViewport(const VkExtent2D& extent)
-{
-    // draw entire framebuffer
-    VkViewport viewport{};
-    viewport.x = 0.0f;
-    viewport.y = 0.0f;
-    viewport.width = static_cast<float>(extent.width);
-    viewport.height = static_cast<float>(extent.height);
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
-    return viewport;
-}
-
-// cut the region of the framebuffer(swap chain)
-VkRect2D VkGraphicsPipelineFactory::createScissor(const VkExtent2D& extent)
-{
-    VkRect2D scissor{};
-    scissor.offset = {0, 0};
-    scissor.extent.width = static_cast<float>(extent.width);
-    scissor.extent.height = static_cast<float>(extent.height);
-    return scissor;
-}
-
-VkPipelineViewportStateCreateInfo VkGraphicsPipelineFactory::createViewportInfo
-    (const VkViewport& viewport, const VkRect2D& scissor)
+VkPipelineViewportStateCreateInfo VkGraphicsPipelineFactory::createViewportInfo()
 {
     VkPipelineViewportStateCreateInfo viewportState{};
     viewportState.sType =
         VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
     // by enabling a GPU feature in logical device creation,
     // its possible to use multiple viewports
+    // the viewport and the scissor themselves are set when recording command buffers
     viewportState.viewportCount = 1;
-    viewportState.pViewports = &viewport;
+    viewportState.pViewports = nullptr;
     viewportState.scissorCount = 1;
-    viewportState.pScissors = &scissor;
+    viewportState.pScissors = nullptr;
     return viewportState;
 }
 
 VkPipelineRasterizationStateCreateInfo
-    VkGraphicsPipelineFactory::createRasterizer()
+    VkGraphicsPipelineFactory::createRasterizer(VkCullModeFlags cullMode)
 {
     VkPipelineRasterizationStateCreateInfo rasterizer{};
     rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
@@ -216,7 +397,7 @@ VkPipelineRasterizationStateCreateInfo
     // using any mode other than fill requires GPU feature
     rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
     rasterizer.lineWidth = 1.0f;
-    rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
+    rasterizer.cullMode = cullMode;
     rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
     // consider this when shadow mapping is necessary
     rasterizer.depthBiasEnable = VK_FALSE;
@@ -240,8 +421,26 @@ VkPipelineMultisampleStateCreateInfo VkGraphicsPipelineFactory::createMultisampl
     return multisampling;
 }
 
-// color blending for alpha blending
-VkPipelineColorBlendAttachmentState VkGraphicsPipelineFactory::createColorBlendingAttachment()
+// opaque draws and the instances inside each of them are recorded front to back,
+// so the hidden fragments fail the early depth test
+// every instance has its own depth, so a strict less rejects whatever an earlier instance covers
+// the blended draws must not hide what is drawn behind them after them, they only test
+VkPipelineDepthStencilStateCreateInfo VkGraphicsPipelineFactory::createDepthStencilState(BlendMode blendMode)
+{
+    VkPipelineDepthStencilStateCreateInfo depthStencil{};
+    depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depthStencil.depthTestEnable = VK_TRUE;
+    depthStencil.depthWriteEnable = blendMode == BlendMode::OPAQUE ? VK_TRUE : VK_FALSE;
+    depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
+    depthStencil.depthBoundsTestEnable = VK_FALSE;
+    depthStencil.minDepthBounds = 0.0f; // Optional
+    depthStencil.maxDepthBounds = 1.0f; // Optional
+    depthStencil.stencilTestEnable = VK_FALSE;
+    return depthStencil;
+}
+
+// color blending of the variant, alpha blending by default
+VkPipelineColorBlendAttachmentState VkGraphicsPipelineFactory::createColorBlendingAttachment(BlendMode blendMode)
 {
     // per framebuffer struct
     // in contrast, VkPipelineColcorBlendStateCreateInfo is global color blending settings
@@ -255,9 +454,12 @@ VkPipelineColorBlendAttachmentState VkGraphicsPipelineFactory::createColorBlendi
     colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE; //Optional
     colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO; //Optional
     colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD; 
+    if (blendMode == BlendMode::OPAQUE)
+        return colorBlendAttachment;
     colorBlendAttachment.blendEnable = VK_TRUE;
     colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA; 
-    colorBlendAttachment.dstColorBlendFactor =VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA; 
+    colorBlendAttachment.dstColorBlendFactor = blendMode == BlendMode::ADDITIVE
+        ? VK_BLEND_FACTOR_ONE : VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA; 
     colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD; 
     colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE; 
     colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
@@ -285,30 +487,50 @@ VkPipelineColorBlendStateCreateInfo VkGraphicsPipelineFactory::createColorBlendi
 // a limited amount of the state can be actually be changed without recreating the pipeline
 VkPipelineDynamicStateCreateInfo VkGraphicsPipelineFactory::createDynamicState()
 {
-    VkDynamicState dynamicStates[] = {};
+    // static because the create info only points to it
+    static const VkDynamicState dynamicStates[] =
+    {
+        VK_DYNAMIC_STATE_VIEWPORT,
+        VK_DYNAMIC_STATE_SCISSOR
+    };
     VkPipelineDynamicStateCreateInfo dynamicState{};
     dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-    dynamicState.dynamicStateCount = 0; 
-    dynamicState.pDynamicStates = nullptr;
+    dynamicState.dynamicStateCount = static_cast<uint32_t>(std::size(dynamicStates));
+    dynamicState.pDynamicStates = dynamicStates;
     return dynamicState;
 }
 
-void VkGraphicsPipelineFactory::createPipelineLayout(const VkDevice& device)
+VkShaderReflection::ShaderInterface VkGraphicsPipelineFactory::reflectInterface(
+    const std::vector<char>& vertShaderCode, const std::vector<char>& fragShaderCode,
+    const std::vector<VkVertexInputAttributeDescription>& attributeDescriptions)
+{
+    auto interface = VkShaderReflection::merge(
+        {VkShaderReflection::reflect(vertShaderCode), VkShaderReflection::reflect(fragShaderCode)});
+    if (!VkShaderReflection::isVertexInputCompatible(interface, attributeDescriptions))
+        throw std::runtime_error("failed to match the vertex shader inputs with the vertex layout!");
+    return interface;
+}
+
+VkPipelineLayout VkGraphicsPipelineFactory::createPipelineLayout(VkLayoutCacheManager& layoutCache,
+    VkShaderReflection::ShaderInterface& interface, uint32_t maxPushConstantsSize)
 {
-    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutInfo.setLayoutCount = 0;
-    pipelineLayoutInfo.pSetLayouts = nullptr;
-    pipelineLayoutInfo.pushConstantRangeCount = 0;
-    pipelineLayoutInfo.pPushConstantRanges = nullptr;
-    if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout_m) != VK_SUCCESS)
-        throw std::runtime_error("failed to create pipeline layout!");
+    // the frame set and the draw set point into uniform rings
+    VkShaderReflection::setDynamicUniformBuffers(interface, FRAME_SET);
+    VkShaderReflection::setDynamicUniformBuffers(interface, DRAW_SET);
+    // a single range, the one of the blocks of every stage merged
+    const auto& pushConstantRange = interface.pushConstantRange_m;
+    if (pushConstantRange.offset + pushConstantRange.size > maxPushConstantsSize)
+        throw std::runtime_error("failed to fit the push constants of the shaders in maxPushConstantsSize!");
+    return layoutCache.getPipelineLayout(interface);
 }
 
 void VkGraphicsPipelineFactory::destroyGraphicsPipeline(const VkDevice& device)
 {
-    vkDestroyPipeline       (device, graphicsPipeline_m, nullptr);
-    vkDestroyPipelineLayout (device, pipelineLayout_m, nullptr);
+    std::lock_guard<std::mutex> lock(variantsMutex_m);
+    for (auto& variant : variants_m)
+        vkDestroyPipeline   (device, variant.second.pipeline_m, nullptr);
+    variants_m.clear();
+    // the layout belongs to the layout cache
 }
 
 void VkGraphicsPipelineFactory::destroyRenderPass(const VkDevice& device)
@@ -0,0 +1,99 @@
+#include <VkLayoutCacheManager.hpp>
+#include <algorithm>
+#include <stdexcept>
+
+void VkLayoutCacheManager::createLayoutCache(const VkDevice& device)
+{
+    device_m = device;
+}
+
+void VkLayoutCacheManager::destroyLayoutCache()
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex_m);
+    // the pipeline layouts reference the set layouts, destroy them first
+    for (auto& pipelineLayout : pipelineLayouts_m)
+        vkDestroyPipelineLayout(device_m, pipelineLayout.second, nullptr);
+    for (auto& descriptorSetLayout : descriptorSetLayouts_m)
+        vkDestroyDescriptorSetLayout(device_m, descriptorSetLayout.second, nullptr);
+    pipelineLayouts_m.clear();
+    pipelineSetLayouts_m.clear();
+    setLayoutBindings_m.clear();
+    descriptorSetLayouts_m.clear();
+}
+
+const VkDescriptorSetLayout& VkLayoutCacheManager::getDescriptorSetLayout(
+    const std::vector<VkDescriptorSetLayoutBinding>& bindings)
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex_m);
+    // the order of the bindings does not change the layout
+    auto sortedBindings = bindings;
+    std::sort(sortedBindings.begin(), sortedBindings.end(),
+        [](const auto& a, const auto& b) { return a.binding < b.binding; });
+    LayoutKey key;
+    for (const auto& binding : sortedBindings)
+        key.insert(key.end(), {binding.binding, static_cast<uint64_t>(binding.descriptorType),
+            binding.descriptorCount, binding.stageFlags});
+    auto cached = descriptorSetLayouts_m.find(key);
+    if (cached != descriptorSetLayouts_m.end())
+        return cached->second;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = static_cast<uint32_t>(sortedBindings.size());
+    layoutInfo.pBindings = sortedBindings.data();
+    VkDescriptorSetLayout descriptorSetLayout;
+    if (vkCreateDescriptorSetLayout(device_m, &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS)
+        throw std::runtime_error("failed to create descriptor set layout!");
+    setLayoutBindings_m[descriptorSetLayout] = sortedBindings;
+    return descriptorSetLayouts_m.emplace(key, descriptorSetLayout).first->second;
+}
+
+const VkPipelineLayout& VkLayoutCacheManager::getPipelineLayout(const VkShaderReflection::ShaderInterface& interface)
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex_m);
+    std::vector<VkDescriptorSetLayout> setLayouts;
+    for (uint32_t set = 0; set < VkShaderReflection::getSetCount(interface); set++)
+        setLayouts.push_back(getDescriptorSetLayout(VkShaderReflection::getSetLayoutBindings(interface, set)));
+    const auto& pushConstantRange = interface.pushConstantRange_m;
+    // the set layouts are deduplicated, so their handles identify them
+    LayoutKey key;
+    for (const auto& setLayout : setLayouts)
+        key.push_back(reinterpret_cast<uint64_t>(setLayout));
+    if (pushConstantRange.size > 0)
+        key.insert(key.end(), {pushConstantRange.stageFlags, pushConstantRange.offset, pushConstantRange.size});
+    auto cached = pipelineLayouts_m.find(key);
+    if (cached != pipelineLayouts_m.end())
+        return cached->second;
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+    pipelineLayoutInfo.pSetLayouts = setLayouts.data();
+    pipelineLayoutInfo.pushConstantRangeCount = pushConstantRange.size > 0 ? 1 : 0;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    VkPipelineLayout pipelineLayout;
+    if (vkCreatePipelineLayout(device_m, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
+        throw std::runtime_error("failed to create pipeline layout!");
+    pipelineSetLayouts_m[pipelineLayout] = setLayouts;
+    return pipelineLayouts_m.emplace(key, pipelineLayout).first->second;
+}
+
+const std::vector<VkDescriptorSetLayout>& VkLayoutCacheManager::getSetLayouts(
+    const VkPipelineLayout& pipelineLayout) const
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex_m);
+    auto setLayouts = pipelineSetLayouts_m.find(pipelineLayout);
+    if (setLayouts == pipelineSetLayouts_m.end())
+        throw std::runtime_error("failed to find the set layouts of a pipeline layout!");
+    return setLayouts->second;
+}
+
+const std::vector<VkDescriptorSetLayoutBinding>& VkLayoutCacheManager::getSetLayoutBindings(
+    const VkDescriptorSetLayout& descriptorSetLayout) const
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex_m);
+    auto bindings = setLayoutBindings_m.find(descriptorSetLayout);
+    if (bindings == setLayoutBindings_m.end())
+        throw std::runtime_error("failed to find the bindings of a descriptor set layout!");
+    return bindings->second;
+}
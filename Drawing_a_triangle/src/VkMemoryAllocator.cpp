@@ -0,0 +1,416 @@
+#include <VkMemoryAllocator.hpp>
+#include <VkDeviceManager.hpp>
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+
+// smallest buddy node, keeps the free lists short for tiny buffers
+constexpr VkDeviceSize MIN_NODE_SIZE = 256;
+
+static VkDeviceSize nextPowerOfTwo(VkDeviceSize size)
+{
+    VkDeviceSize power = 1;
+    while (power < size)
+        power <<= 1;
+    return power;
+}
+
+static uint32_t log2OfPowerOfTwo(VkDeviceSize power)
+{
+    uint32_t log = 0;
+    while (power > 1) {
+        power >>= 1;
+        log++;
+    }
+    return log;
+}
+
+static VkDeviceSize alignUp(VkDeviceSize offset, VkDeviceSize alignment)
+{
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+void VkMemoryAllocator::createAllocator(const VkDeviceManager& deviceManager, VkDeviceSize blockSize)
+{
+    deviceManager_m = &deviceManager;
+    vkGetPhysicalDeviceMemoryProperties(deviceManager.getPhysicalDevice(), &memoryProperties_m);
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(deviceManager.getPhysicalDevice(), &properties);
+    bufferImageGranularity_m = std::max<VkDeviceSize>(properties.limits.bufferImageGranularity, 1);
+    maxMemoryAllocationCount_m = properties.limits.maxMemoryAllocationCount;
+    // every node offset is a multiple of its size, so a power of two block keeps them aligned
+    blockSize_m = nextPowerOfTwo(std::max(blockSize, MIN_NODE_SIZE));
+    levelCount_m = log2OfPowerOfTwo(blockSize_m / MIN_NODE_SIZE) + 1;
+    // a pool for each combination of memory type and kind of resources
+    pools_m.resize(memoryProperties_m.memoryTypeCount * POOL_KIND_COUNT);
+    for (uint32_t i = 0; i < pools_m.size(); i++) {
+        pools_m[i].memoryType_m = i / POOL_KIND_COUNT;
+        pools_m[i].lifetime_m = (i % POOL_KIND_COUNT == TRANSIENT_POOL) ?
+            Lifetime::TRANSIENT : Lifetime::PERSISTENT;
+    }
+}
+
+void VkMemoryAllocator::destroyAllocator()
+{
+    std::lock_guard<std::mutex> lock(mutex_m);
+    for (auto& pool : pools_m) {
+        for (auto& block : pool.blocks_m) {
+            if (block.memory_m == VK_NULL_HANDLE)
+                continue;
+            if (block.allocationCount_m != 0)
+                std::cerr << "memory allocator : " << block.allocationCount_m
+                    << " allocations are still alive" << std::endl;
+            destroyBlock(block);
+        }
+    }
+    pools_m.clear();
+}
+
+uint32_t VkMemoryAllocator::getPoolIndex(uint32_t memoryType, Lifetime lifetime, bool linearResource) const
+{
+    PoolKind kind = PERSISTENT_LINEAR;
+    if (lifetime == Lifetime::TRANSIENT)
+        kind = TRANSIENT_POOL;
+    // linear and optimal resources only have to be separated if they could alias a granularity page
+    else if (!linearResource && bufferImageGranularity_m > 1)
+        kind = PERSISTENT_OPTIMAL;
+    return memoryType * POOL_KIND_COUNT + kind;
+}
+
+VkMemoryAllocator::Allocation VkMemoryAllocator::allocate(const VkMemoryRequirements& requirements,
+    VkMemoryPropertyFlags properties, Lifetime lifetime, bool linearResource)
+{
+    std::lock_guard<std::mutex> lock(mutex_m);
+    auto memoryType = VkDeviceManager::findMemoryType(requirements.memoryTypeBits,
+        properties, deviceManager_m->getPhysicalDevice());
+    auto poolIndex = getPoolIndex(memoryType, lifetime, linearResource);
+    auto& pool = pools_m[poolIndex];
+    if (lifetime == Lifetime::TRANSIENT) {
+        // transient optimal images share blocks with buffers, so pad them to whole granularity pages
+        auto padded = requirements;
+        if (!linearResource) {
+            padded.alignment = std::max(padded.alignment, bufferImageGranularity_m);
+            padded.size = alignUp(padded.size, bufferImageGranularity_m);
+        }
+        return allocateTransient(pool, poolIndex, padded);
+    }
+    return allocatePersistent(pool, poolIndex, requirements);
+}
+
+VkMemoryAllocator::Allocation VkMemoryAllocator::allocatePersistent
+    (Pool& pool, uint32_t poolIndex, const VkMemoryRequirements& requirements)
+{
+    Allocation allocation;
+    allocation.poolIndex_m = poolIndex;
+    allocation.size_m = requirements.size;
+    // the node is at least as large as the alignment, so its offset is aligned too
+    auto nodeSize = nextPowerOfTwo(std::max({requirements.size, requirements.alignment, MIN_NODE_SIZE}));
+    // too large to share a block
+    if (nodeSize > blockSize_m) {
+        allocation.blockIndex_m = createBlock(pool, requirements.size, true);
+    }
+    else {
+        allocation.level_m = log2OfPowerOfTwo(blockSize_m / nodeSize);
+        bool found = false;
+        for (uint32_t i = 0; i < pool.blocks_m.size() && !found; i++) {
+            auto& block = pool.blocks_m[i];
+            if (block.memory_m == VK_NULL_HANDLE || block.dedicated_m)
+                continue;
+            if (allocateNode(block, allocation.level_m, allocation.offset_m)) {
+                allocation.blockIndex_m = i;
+                found = true;
+            }
+        }
+        if (!found) {
+            allocation.blockIndex_m = createBlock(pool, blockSize_m, false);
+            allocateNode(pool.blocks_m[allocation.blockIndex_m], allocation.level_m, allocation.offset_m);
+        }
+    }
+    auto& block = pool.blocks_m[allocation.blockIndex_m];
+    block.allocationCount_m++;
+    block.usedBytes_m += requirements.size;
+    allocation.memory_m = block.memory_m;
+    if (block.mapped_m != nullptr)
+        allocation.mapped_m = static_cast<char*>(block.mapped_m) + allocation.offset_m;
+    return allocation;
+}
+
+VkMemoryAllocator::Allocation VkMemoryAllocator::allocateTransient
+    (Pool& pool, uint32_t poolIndex, const VkMemoryRequirements& requirements)
+{
+    Allocation allocation;
+    allocation.poolIndex_m = poolIndex;
+    allocation.size_m = requirements.size;
+    if (requirements.size > blockSize_m) {
+        allocation.blockIndex_m = createBlock(pool, requirements.size, true);
+    }
+    else {
+        bool found = false;
+        for (uint32_t i = 0; i < pool.blocks_m.size() && !found; i++) {
+            auto& block = pool.blocks_m[i];
+            if (block.memory_m == VK_NULL_HANDLE || block.dedicated_m)
+                continue;
+            if (allocateLinear(block, requirements, allocation.offset_m)) {
+                allocation.blockIndex_m = i;
+                found = true;
+            }
+        }
+        if (!found) {
+            allocation.blockIndex_m = createBlock(pool, blockSize_m, false);
+            allocateLinear(pool.blocks_m[allocation.blockIndex_m], requirements, allocation.offset_m);
+        }
+    }
+    auto& block = pool.blocks_m[allocation.blockIndex_m];
+    block.allocationCount_m++;
+    block.usedBytes_m += requirements.size;
+    allocation.memory_m = block.memory_m;
+    if (block.mapped_m != nullptr)
+        allocation.mapped_m = static_cast<char*>(block.mapped_m) + allocation.offset_m;
+    return allocation;
+}
+
+void VkMemoryAllocator::free(Allocation& allocation)
+{
+    if (allocation.memory_m == VK_NULL_HANDLE)
+        return;
+    std::lock_guard<std::mutex> lock(mutex_m);
+    auto& pool = pools_m[allocation.poolIndex_m];
+    auto& block = pool.blocks_m[allocation.blockIndex_m];
+    block.allocationCount_m--;
+    block.usedBytes_m -= allocation.size_m;
+    if (block.dedicated_m) {
+        destroyBlock(block);
+        allocation = Allocation{};
+        return;
+    }
+    if (pool.lifetime_m == Lifetime::TRANSIENT) {
+        // transient memory is reclaimed all at once
+        if (block.allocationCount_m == 0)
+            block.linearOffset_m = 0;
+    }
+    else
+        freeNode(block, allocation.level_m, allocation.offset_m);
+    // release an empty block unless it is the last one of the pool
+    if (block.allocationCount_m == 0) {
+        auto liveBlocks = std::count_if(pool.blocks_m.begin(), pool.blocks_m.end(),
+            [](const Block& b) { return b.memory_m != VK_NULL_HANDLE && !b.dedicated_m; });
+        if (liveBlocks > 1)
+            destroyBlock(block);
+    }
+    allocation = Allocation{};
+}
+
+uint32_t VkMemoryAllocator::createBlock(Pool& pool, VkDeviceSize size, bool dedicated)
+{
+    if (maxMemoryAllocationCount_m != 0 && deviceAllocationCount_m >= maxMemoryAllocationCount_m)
+        throw std::runtime_error("exceeded maxMemoryAllocationCount!");
+    Block block;
+    block.size_m = size;
+    block.dedicated_m = dedicated;
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = size;
+    allocInfo.memoryTypeIndex = pool.memoryType_m;
+    const auto& device = deviceManager_m->getDevice();
+    if (vkAllocateMemory(device, &allocInfo, nullptr, &block.memory_m) != VK_SUCCESS)
+        throw std::runtime_error("failed to allocate memory block!");
+    deviceAllocationCount_m++;
+    // a VkDeviceMemory can be mapped only once, so map the whole block for its lifetime
+    if (memoryProperties_m.memoryTypes[pool.memoryType_m].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+        vkMapMemory(device, block.memory_m, 0, VK_WHOLE_SIZE, 0, &block.mapped_m);
+    if (!dedicated && pool.lifetime_m == Lifetime::PERSISTENT) {
+        block.freeNodes_m.resize(levelCount_m);
+        block.freeNodes_m[0].insert(0);
+    }
+    // reuse a released slot
+    for (uint32_t i = 0; i < pool.blocks_m.size(); i++) {
+        if (pool.blocks_m[i].memory_m == VK_NULL_HANDLE) {
+            pool.blocks_m[i] = std::move(block);
+            return i;
+        }
+    }
+    pool.blocks_m.push_back(std::move(block));
+    return static_cast<uint32_t>(pool.blocks_m.size() - 1);
+}
+
+void VkMemoryAllocator::destroyBlock(Block& block)
+{
+    // freeing the memory unmaps it implicitly
+    vkFreeMemory(deviceManager_m->getDevice(), block.memory_m, nullptr);
+    deviceAllocationCount_m--;
+    block = Block{};
+}
+
+bool VkMemoryAllocator::allocateNode(Block& block, uint32_t level, VkDeviceSize& offset)
+{
+    // find the smallest free node which is large enough
+    int current = static_cast<int>(level);
+    while (current >= 0 && block.freeNodes_m[current].empty())
+        current--;
+    if (current < 0)
+        return false;
+    offset = *block.freeNodes_m[current].begin();
+    block.freeNodes_m[current].erase(block.freeNodes_m[current].begin());
+    // split it until it fits, the upper halves stay free
+    while (static_cast<uint32_t>(current) < level) {
+        current++;
+        block.freeNodes_m[current].insert(offset + (blockSize_m >> current));
+    }
+    return true;
+}
+
+void VkMemoryAllocator::freeNode(Block& block, uint32_t level, VkDeviceSize offset)
+{
+    // merge with the buddy as long as it is free
+    while (level > 0) {
+        auto buddy = offset ^ (blockSize_m >> level);
+        auto it = block.freeNodes_m[level].find(buddy);
+        if (it == block.freeNodes_m[level].end())
+            break;
+        block.freeNodes_m[level].erase(it);
+        offset = std::min(offset, buddy);
+        level--;
+    }
+    block.freeNodes_m[level].insert(offset);
+}
+
+bool VkMemoryAllocator::allocateLinear(Block& block, const VkMemoryRequirements& requirements, VkDeviceSize& offset)
+{
+    auto alignedOffset = alignUp(block.linearOffset_m, std::max<VkDeviceSize>(requirements.alignment, 1));
+    if (alignedOffset + requirements.size > block.size_m)
+        return false;
+    offset = alignedOffset;
+    block.linearOffset_m = alignedOffset + requirements.size;
+    return true;
+}
+
+void VkMemoryAllocator::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
+    VkMemoryPropertyFlags properties, Lifetime lifetime, VkBuffer& buffer, Allocation& allocation)
+{
+    const auto& device = deviceManager_m->getDevice();
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = usage;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS)
+        throw std::runtime_error("failed to create buffer!");
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
+    // callers may retry with other properties, the buffer must not leak
+    try {
+        allocation = allocate(memRequirements, properties, lifetime, true);
+    } catch (...) {
+        vkDestroyBuffer(device, buffer, nullptr);
+        buffer = VK_NULL_HANDLE;
+        throw;
+    }
+    // associate the memory range with the buffer
+    vkBindBufferMemory(device, buffer, allocation.memory_m, allocation.offset_m);
+}
+
+void VkMemoryAllocator::createHostVisibleBuffer(VkDeviceSize size, VkBufferUsageFlags usage, Lifetime lifetime,
+    VkBuffer& buffer, Allocation& allocation, bool preferDeviceLocal)
+{
+    const VkMemoryPropertyFlags hostVisible = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    bool created = false;
+    if (preferDeviceLocal) {
+        try {
+            createBuffer(size, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | hostVisible, lifetime, buffer, allocation);
+            created = true;
+        } catch (const std::runtime_error&) {
+        }
+    }
+    if (!created)
+        createBuffer(size, usage, hostVisible, lifetime, buffer, allocation);
+    if (allocation.mapped_m == nullptr) {
+        destroyBuffer(buffer, allocation);
+        throw std::runtime_error("failed to map host visible buffer!");
+    }
+}
+
+void VkMemoryAllocator::destroyBuffer(VkBuffer& buffer, Allocation& allocation)
+{
+    vkDestroyBuffer(deviceManager_m->getDevice(), buffer, nullptr);
+    buffer = VK_NULL_HANDLE;
+    free(allocation);
+}
+
+void VkMemoryAllocator::createImage(const VkImageCreateInfo& imageInfo, VkMemoryPropertyFlags properties,
+    VkImage& image, Allocation& allocation)
+{
+    const auto& device = deviceManager_m->getDevice();
+    if (vkCreateImage(device, &imageInfo, nullptr, &image) != VK_SUCCESS)
+        throw std::runtime_error("failed to create image!");
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(device, image, &memRequirements);
+    // same as createBuffer, the image must not leak
+    try {
+        allocation = allocate(memRequirements, properties, Lifetime::PERSISTENT,
+            imageInfo.tiling == VK_IMAGE_TILING_LINEAR);
+    } catch (...) {
+        vkDestroyImage(device, image, nullptr);
+        image = VK_NULL_HANDLE;
+        throw;
+    }
+    vkBindImageMemory(device, image, allocation.memory_m, allocation.offset_m);
+}
+
+void VkMemoryAllocator::destroyImage(VkImage& image, Allocation& allocation)
+{
+    vkDestroyImage(deviceManager_m->getDevice(), image, nullptr);
+    image = VK_NULL_HANDLE;
+    free(allocation);
+}
+
+VkMemoryAllocator::Statistics VkMemoryAllocator::getStatistics() const
+{
+    std::lock_guard<std::mutex> lock(mutex_m);
+    Statistics statistics;
+    for (const auto& pool : pools_m) {
+        for (const auto& block : pool.blocks_m) {
+            if (block.memory_m == VK_NULL_HANDLE)
+                continue;
+            statistics.blockCount_m++;
+            statistics.allocationCount_m += block.allocationCount_m;
+            statistics.blockBytes_m += block.size_m;
+            statistics.usedBytes_m += block.usedBytes_m;
+            if (block.dedicated_m)
+                continue;
+            if (pool.lifetime_m == Lifetime::TRANSIENT) {
+                auto freeBytes = block.size_m - block.linearOffset_m;
+                statistics.freeBytes_m += freeBytes;
+                statistics.largestFreeRange_m = std::max(statistics.largestFreeRange_m, freeBytes);
+                continue;
+            }
+            for (uint32_t level = 0; level < block.freeNodes_m.size(); level++) {
+                if (block.freeNodes_m[level].empty())
+                    continue;
+                auto nodeSize = blockSize_m >> level;
+                statistics.freeBytes_m += nodeSize * block.freeNodes_m[level].size();
+                statistics.largestFreeRange_m = std::max(statistics.largestFreeRange_m, nodeSize);
+            }
+        }
+    }
+    if (statistics.freeBytes_m > 0)
+        statistics.fragmentation_m = 1.0f - static_cast<float>(statistics.largestFreeRange_m)
+            / static_cast<float>(statistics.freeBytes_m);
+    return statistics;
+}
+
+void VkMemoryAllocator::printStatistics() const
+{
+    auto statistics = getStatistics();
+    constexpr double MiB = 1024.0 * 1024.0;
+    std::cout << "memory allocator :" << std::endl;
+    std::cout << "\tblocks : " << statistics.blockCount_m << " (" << statistics.blockBytes_m / MiB << " MiB, "
+        << "block size " << blockSize_m / MiB << " MiB)" << std::endl;
+    std::cout << "\tallocations : " << statistics.allocationCount_m << std::endl;
+    std::cout << "\tused : " << statistics.usedBytes_m / MiB << " MiB" << std::endl;
+    std::cout << "\tfree : " << statistics.freeBytes_m / MiB << " MiB (largest range "
+        << statistics.largestFreeRange_m / MiB << " MiB)" << std::endl;
+    // bytes lost to alignment and power of two rounding
+    std::cout << "\tpadding : " << (statistics.blockBytes_m - statistics.usedBytes_m
+        - statistics.freeBytes_m) / MiB << " MiB" << std::endl;
+    std::cout << "\tfragmentation : " << statistics.fragmentation_m << std::endl;
+}
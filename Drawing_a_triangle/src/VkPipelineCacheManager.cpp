@@ -0,0 +1,143 @@
+#include <VkPipelineCacheManager.hpp>
+#include <fstream>
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+
+const VkPipelineCache& VkPipelineCacheManager::getPipelineCacheRef() const
+{
+    return pipelineCache_m;
+}
+
+void VkPipelineCacheManager::createPipelineCache(const VkDeviceManager& deviceManager, const std::string& path)
+{
+    path_m = path;
+    vkGetPhysicalDeviceProperties(deviceManager.getPhysicalDevice(), &properties_m);
+    auto initialData = path_m.empty() ? std::vector<char>() : loadCacheData();
+    VkPipelineCacheCreateInfo cacheInfo{};
+    cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    cacheInfo.initialDataSize = initialData.size();
+    cacheInfo.pInitialData = initialData.empty() ? nullptr : initialData.data();
+    if (vkCreatePipelineCache(deviceManager.getDevice(), &cacheInfo, nullptr, &pipelineCache_m) != VK_SUCCESS)
+        throw std::runtime_error("failed to create pipeline cache!");
+    if (initialData.empty())
+        std::cout << "pipeline cache : created empty" << std::endl;
+    else
+        std::cout << "pipeline cache : loaded " << initialData.size() << " bytes from " << path_m << std::endl;
+}
+
+void VkPipelineCacheManager::destroyPipelineCache(const VkDevice& device)
+{
+    if (pipelineCache_m == VK_NULL_HANDLE)
+        return;
+    // a failed write only costs the next startup time
+    try {
+        savePipelineCache(device);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+    }
+    vkDestroyPipelineCache(device, pipelineCache_m, nullptr);
+    pipelineCache_m = VK_NULL_HANDLE;
+}
+
+void VkPipelineCacheManager::savePipelineCache(const VkDevice& device)
+{
+    if (path_m.empty())
+        return;
+    size_t dataSize = 0;
+    if (vkGetPipelineCacheData(device, pipelineCache_m, &dataSize, nullptr) != VK_SUCCESS)
+        throw std::runtime_error("failed to get pipeline cache data size!");
+    std::vector<char> data(dataSize);
+    if (vkGetPipelineCacheData(device, pipelineCache_m, &dataSize, data.data()) != VK_SUCCESS)
+        throw std::runtime_error("failed to get pipeline cache data!");
+    data.resize(dataSize);
+    auto header = createFileHeader();
+    header.dataSize_m = data.size();
+    header.checksum_m = computeChecksum(data);
+    // write to a temporary file and rename it so that a crash never leaves a torn cache
+    auto tempPath = path_m + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+            throw std::runtime_error("failed to open pipeline cache file!");
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(data.data(), data.size());
+        file.flush();
+        if (!file)
+            throw std::runtime_error("failed to write pipeline cache file!");
+    }
+    if (std::rename(tempPath.c_str(), path_m.c_str()) != 0) {
+        std::remove(tempPath.c_str());
+        throw std::runtime_error("failed to replace pipeline cache file!");
+    }
+    std::cout << "pipeline cache : saved " << data.size() << " bytes to " << path_m << std::endl;
+}
+
+std::vector<char> VkPipelineCacheManager::loadCacheData() const
+{
+    std::ifstream file(path_m, std::ios::ate | std::ios::binary);
+    if (!file.is_open())
+        return {};
+    auto fileSize = static_cast<size_t>(file.tellg());
+    if (fileSize < sizeof(FileHeader)) {
+        std::cout << "pipeline cache : ignored truncated " << path_m << std::endl;
+        return {};
+    }
+    file.seekg(0);
+    FileHeader header{};
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    // the driver would reject a foreign cache anyway, but some drivers crash on it instead
+    auto expected = createFileHeader();
+    if (header.magic_m != expected.magic_m || header.fileVersion_m != expected.fileVersion_m
+        || header.vendorID_m != expected.vendorID_m || header.deviceID_m != expected.deviceID_m
+        || header.driverVersion_m != expected.driverVersion_m
+        || std::memcmp(header.pipelineCacheUUID_m, expected.pipelineCacheUUID_m, VK_UUID_SIZE) != 0) {
+        std::cout << "pipeline cache : ignored " << path_m << " written by another device or driver" << std::endl;
+        return {};
+    }
+    if (header.dataSize_m != fileSize - sizeof(FileHeader)) {
+        std::cout << "pipeline cache : ignored truncated " << path_m << std::endl;
+        return {};
+    }
+    std::vector<char> data(header.dataSize_m);
+    file.read(data.data(), data.size());
+    if (!file || computeChecksum(data) != header.checksum_m) {
+        std::cout << "pipeline cache : ignored corrupted " << path_m << std::endl;
+        return {};
+    }
+    // the header written by the driver must agree as well
+    VkPipelineCacheHeaderVersionOne driverHeader{};
+    if (data.size() < sizeof(driverHeader))
+        return {};
+    std::memcpy(&driverHeader, data.data(), sizeof(driverHeader));
+    if (driverHeader.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+        || driverHeader.vendorID != properties_m.vendorID || driverHeader.deviceID != properties_m.deviceID
+        || std::memcmp(driverHeader.pipelineCacheUUID, properties_m.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+        std::cout << "pipeline cache : ignored " << path_m << " with a mismatched driver header" << std::endl;
+        return {};
+    }
+    return data;
+}
+
+VkPipelineCacheManager::FileHeader VkPipelineCacheManager::createFileHeader() const
+{
+    FileHeader header{};
+    header.magic_m = CACHE_FILE_MAGIC;
+    header.fileVersion_m = CACHE_FILE_VERSION;
+    header.vendorID_m = properties_m.vendorID;
+    header.deviceID_m = properties_m.deviceID;
+    header.driverVersion_m = properties_m.driverVersion;
+    std::memcpy(header.pipelineCacheUUID_m, properties_m.pipelineCacheUUID, VK_UUID_SIZE);
+    return header;
+}
+
+uint64_t VkPipelineCacheManager::computeChecksum(const std::vector<char>& data)
+{
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ull;
+    for (auto byte : data) {
+        hash ^= static_cast<uint8_t>(byte);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
@@ -0,0 +1,27 @@
+#include <VkPresentProfile.hpp>
+#include <stdexcept>
+
+const std::vector<VkPresentProfile>& VkPresentProfile::getProfiles()
+{
+    static const std::vector<VkPresentProfile> profiles =
+    {
+        // triple buffering without tearing, fall back to vsync
+        {"balanced", 2, {VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_FIFO_KHR}},
+        // the CPU never runs ahead, the newest image is shown as soon as possible
+        {"low-latency", 1, {VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_FIFO_KHR}},
+        // keep the GPU busy, every image is shown
+        {"throughput", 3, {VK_PRESENT_MODE_FIFO_KHR}},
+        // vsync, but a late image is shown at once instead of waiting for the next blank
+        {"vsync-relaxed", 2, {VK_PRESENT_MODE_FIFO_RELAXED_KHR, VK_PRESENT_MODE_FIFO_KHR}}
+    };
+    return profiles;
+}
+
+size_t VkPresentProfile::findProfile(const std::string& name)
+{
+    const auto& profiles = getProfiles();
+    for (size_t i = 0; i < profiles.size(); i++)
+        if (name == profiles[i].name_m)
+            return i;
+    throw std::runtime_error("unknown present profile : " + name);
+}
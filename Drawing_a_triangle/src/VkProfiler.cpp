@@ -0,0 +1,222 @@
+#include <VkProfiler.hpp>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+
+void VkProfiler::createProfiler(const VkDeviceManager& deviceManager, size_t framesInFlight,
+    const std::string& csvPath)
+{
+    const auto& physicalDevice = deviceManager.getPhysicalDevice();
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    timestampPeriod_m = properties.limits.timestampPeriod;
+    // timestamps are only supported by queues with valid bits
+    auto queueFamilyIndices =
+        const_cast<VkDeviceManager&>(deviceManager).findQueueFamilies(physicalDevice);
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+    auto validBits = queueFamilies[queueFamilyIndices.graphicsFamily_m.value()].timestampValidBits;
+    timestampsSupported_m = validBits != 0;
+    timestampMask_m = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+    if (!timestampsSupported_m)
+        std::cout << "profiler : timestamps are not supported, only CPU times are measured" << std::endl;
+
+    pendingFrames_m.assign(framesInFlight, PendingFrame{});
+    samples_m.clear();
+    frameNumber_m = 0;
+    hasPreviousFrame_m = false;
+    csvPath_m = csvPath;
+    if (!timestampsSupported_m)
+        return;
+    VkQueryPoolCreateInfo queryPoolInfo{};
+    queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    queryPoolInfo.queryCount = static_cast<uint32_t>(framesInFlight * QUERY_COUNT);
+    if (vkCreateQueryPool(deviceManager.getDevice(), &queryPoolInfo, nullptr, &queryPool_m) != VK_SUCCESS)
+        throw std::runtime_error("failed to create query pool!");
+}
+
+void VkProfiler::destroyProfiler(const VkDevice& device)
+{
+    // the device is idle, so every pending result is available
+    collectPendingResults(device);
+    // a failed write must not stop the rest of the cleanup
+    if (!csvPath_m.empty()) {
+        try {
+            writeCsv(csvPath_m);
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+        }
+    }
+    if (queryPool_m != VK_NULL_HANDLE)
+        vkDestroyQueryPool(device, queryPool_m, nullptr);
+    queryPool_m = VK_NULL_HANDLE;
+}
+
+void VkProfiler::collectPendingResults(const VkDevice& device)
+{
+    std::vector<size_t> frameIndices(pendingFrames_m.size());
+    std::iota(frameIndices.begin(), frameIndices.end(), 0);
+    std::sort(frameIndices.begin(), frameIndices.end(), [this](size_t a, size_t b)
+        { return pendingFrames_m[a].sample_m.frameNumber_m < pendingFrames_m[b].sample_m.frameNumber_m; });
+    for (auto frameIndex : frameIndices)
+        collectResults(device, frameIndex);
+}
+
+void VkProfiler::beginFrame(const VkDevice& device, const VkCommandBuffer& commandBuffer, size_t frameIndex)
+{
+    collectResults(device, frameIndex);
+    auto now = std::chrono::steady_clock::now();
+    auto& frame = pendingFrames_m[frameIndex];
+    frame.pending_m = true;
+    frame.sample_m = FrameSample{};
+    frame.sample_m.frameNumber_m = frameNumber_m++;
+    // time since the previous frame began
+    if (hasPreviousFrame_m)
+        frame.sample_m.cpuFrameMs_m = std::chrono::duration<double, std::milli>(now - previousFrameTime_m).count();
+    previousFrameTime_m = now;
+    hasPreviousFrame_m = true;
+    if (!timestampsSupported_m)
+        return;
+    // queries must be reset before they are written again
+    vkCmdResetQueryPool(commandBuffer, queryPool_m, static_cast<uint32_t>(frameIndex * QUERY_COUNT), QUERY_COUNT);
+    writeTimestamp(commandBuffer, frameIndex, FRAME_BEGIN);
+}
+
+void VkProfiler::writeTimestamp(const VkCommandBuffer& commandBuffer, size_t frameIndex, Query query)
+{
+    if (!timestampsSupported_m)
+        return;
+    // begin timestamps are written as soon as the commands start, end timestamps once everything has finished
+    auto stage = (query == FRAME_BEGIN || query == RENDER_PASS_BEGIN) ?
+        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+    vkCmdWriteTimestamp(commandBuffer, stage, queryPool_m, static_cast<uint32_t>(frameIndex * QUERY_COUNT + query));
+}
+
+void VkProfiler::collectResults(const VkDevice& device, size_t frameIndex)
+{
+    auto& frame = pendingFrames_m[frameIndex];
+    if (!frame.pending_m)
+        return;
+    frame.pending_m = false;
+    auto& sample = frame.sample_m;
+    if (timestampsSupported_m) {
+        // value and availability of every query
+        uint64_t results[QUERY_COUNT * 2] = {};
+        // no VK_QUERY_RESULT_WAIT_BIT : unavailable results are dropped instead of stalling
+        auto result = vkGetQueryPoolResults(device, queryPool_m, static_cast<uint32_t>(frameIndex * QUERY_COUNT),
+            QUERY_COUNT, sizeof(results), results, sizeof(uint64_t) * 2,
+            VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+        auto available = [&](Query query) { return results[query * 2 + 1] != 0; };
+        auto elapsedMs = [&](Query begin, Query end)
+            {
+                auto ticks = (results[end * 2] - results[begin * 2]) & timestampMask_m;
+                return static_cast<double>(ticks) * timestampPeriod_m / 1e6;
+            };
+        if (result == VK_SUCCESS || result == VK_NOT_READY) {
+            if (available(FRAME_BEGIN) && available(FRAME_END))
+                sample.gpuFrameMs_m = elapsedMs(FRAME_BEGIN, FRAME_END);
+            if (available(RENDER_PASS_BEGIN) && available(RENDER_PASS_END))
+                sample.gpuRenderPassMs_m = elapsedMs(RENDER_PASS_BEGIN, RENDER_PASS_END);
+        }
+    }
+    samples_m.push_back(sample);
+    if (csvPath_m.empty() && samples_m.size() > ROLLING_WINDOW)
+        samples_m.pop_front();
+}
+
+VkProfiler::Statistics VkProfiler::computeStatistics(std::vector<double> values)
+{
+    Statistics statistics;
+    statistics.sampleCount_m = values.size();
+    if (values.empty())
+        return statistics;
+    std::sort(values.begin(), values.end());
+    // nearest rank
+    auto percentile = [&](double p)
+        {
+            auto rank = static_cast<size_t>(p * (values.size() - 1) + 0.5);
+            return values[std::min(rank, values.size() - 1)];
+        };
+    statistics.min_m = values.front();
+    statistics.max_m = values.back();
+    statistics.avg_m = std::accumulate(values.begin(), values.end(), 0.0) / values.size();
+    statistics.p50_m = percentile(0.50);
+    statistics.p95_m = percentile(0.95);
+    statistics.p99_m = percentile(0.99);
+    return statistics;
+}
+
+VkProfiler::Statistics VkProfiler::getCpuFrameStatistics() const
+{
+    std::vector<double> values;
+    auto first = samples_m.size() > ROLLING_WINDOW ? samples_m.size() - ROLLING_WINDOW : 0;
+    for (auto i = first; i < samples_m.size(); i++)
+        // the first frame has nothing to be measured from
+        if (samples_m[i].frameNumber_m != 0)
+            values.push_back(samples_m[i].cpuFrameMs_m);
+    return computeStatistics(values);
+}
+
+VkProfiler::Statistics VkProfiler::getGpuFrameStatistics() const
+{
+    std::vector<double> values;
+    auto first = samples_m.size() > ROLLING_WINDOW ? samples_m.size() - ROLLING_WINDOW : 0;
+    for (auto i = first; i < samples_m.size(); i++)
+        if (samples_m[i].gpuFrameMs_m >= 0.0)
+            values.push_back(samples_m[i].gpuFrameMs_m);
+    return computeStatistics(values);
+}
+
+VkProfiler::Statistics VkProfiler::getGpuRenderPassStatistics() const
+{
+    std::vector<double> values;
+    auto first = samples_m.size() > ROLLING_WINDOW ? samples_m.size() - ROLLING_WINDOW : 0;
+    for (auto i = first; i < samples_m.size(); i++)
+        if (samples_m[i].gpuRenderPassMs_m >= 0.0)
+            values.push_back(samples_m[i].gpuRenderPassMs_m);
+    return computeStatistics(values);
+}
+
+void VkProfiler::printStatistics(const char* name, const Statistics& statistics)
+{
+    std::cout << "\t" << name << " : ";
+    if (statistics.sampleCount_m == 0) {
+        std::cout << "no samples" << std::endl;
+        return;
+    }
+    std::cout << "min " << statistics.min_m << " / avg " << statistics.avg_m
+        << " / p50 " << statistics.p50_m << " / p95 " << statistics.p95_m
+        << " / p99 " << statistics.p99_m << " / max " << statistics.max_m
+        << " ms (" << statistics.sampleCount_m << " frames)" << std::endl;
+}
+
+void VkProfiler::printStatistics() const
+{
+    std::cout << "profiler (last " << ROLLING_WINDOW << " frames) :" << std::endl;
+    printStatistics("cpu frame", getCpuFrameStatistics());
+    printStatistics("gpu frame", getGpuFrameStatistics());
+    printStatistics("gpu render pass", getGpuRenderPassStatistics());
+}
+
+void VkProfiler::writeCsv(const std::string& path) const
+{
+    std::ofstream file(path, std::ios::trunc);
+    if (!file.is_open())
+        throw std::runtime_error("failed to open profiler csv file!");
+    file << "frame,cpu_frame_ms,gpu_frame_ms,gpu_render_pass_ms" << std::endl;
+    for (const auto& sample : samples_m) {
+        file << sample.frameNumber_m << "," << sample.cpuFrameMs_m << ",";
+        // empty fields for unavailable GPU times
+        if (sample.gpuFrameMs_m >= 0.0)
+            file << sample.gpuFrameMs_m;
+        file << ",";
+        if (sample.gpuRenderPassMs_m >= 0.0)
+            file << sample.gpuRenderPassMs_m;
+        file << std::endl;
+    }
+    std::cout << "profiler : wrote " << samples_m.size() << " frames to " << path << std::endl;
+}
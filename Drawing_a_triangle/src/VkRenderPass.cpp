@@ -2,7 +2,7 @@
 #include <iostream>
 
 void VkRenderPassFactory::createAttachmentDescription
-    (const VkFormat& swapChainImageFormat)
+    (const VkFormat& swapChainImageFormat, const VkImageLayout& finalLayout, const VkFormat& depthFormat)
 {
     colorAttachment_m.format = swapChainImageFormat;
     colorAttachment_m.samples = VK_SAMPLE_COUNT_1_BIT;
@@ -13,7 +13,17 @@ void VkRenderPassFactory::createAttachmentDescription
     colorAttachment_m.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     colorAttachment_m.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     colorAttachment_m.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    colorAttachment_m.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    // PRESENT_SRC_KHR for a swap chain, TRANSFER_SRC_OPTIMAL for offscreen images
+    colorAttachment_m.finalLayout = finalLayout;
+    // depth is cleared to the far plane and only needed during the render pass
+    depthAttachment_m.format = depthFormat;
+    depthAttachment_m.samples = VK_SAMPLE_COUNT_1_BIT;
+    depthAttachment_m.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depthAttachment_m.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment_m.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    depthAttachment_m.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment_m.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    depthAttachment_m.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 }
 
 void VkRenderPassFactory::createSubPass()
@@ -27,18 +37,25 @@ void VkRenderPassFactory::createSubPass()
     subpass_m.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
     subpass_m.colorAttachmentCount = 1;
     subpass_m.pColorAttachments = &colorAttachmentRef_m;
+    // a subpass has a single depth attachment
+    depthAttachmentRef_m.attachment = 1;
+    depthAttachmentRef_m.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    subpass_m.pDepthStencilAttachment = &depthAttachmentRef_m;
 }
 
 void VkRenderPassFactory::createRenderPass
-    (const VkDevice& device, const VkFormat& swapChainImageFormat, VkRenderPass* pRenderPass)
+    (const VkDevice& device, const VkFormat& swapChainImageFormat,
+    const VkImageLayout& finalLayout, const VkFormat& depthFormat, VkRenderPass* pRenderPass)
 {
-    createAttachmentDescription(swapChainImageFormat);
+    createAttachmentDescription(swapChainImageFormat, finalLayout, depthFormat);
     createSubPass();
     VkRenderPassCreateInfo renderPassInfo{};
     renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
     // attachment and subpass can be array of those;
-    renderPassInfo.attachmentCount = 1;
-    renderPassInfo.pAttachments = &colorAttachment_m;
+    // the indices are the ones of the attachment references
+    VkAttachmentDescription attachments[] = {colorAttachment_m, depthAttachment_m};
+    renderPassInfo.attachmentCount = 2;
+    renderPassInfo.pAttachments = attachments;
     renderPassInfo.subpassCount = 1;
     renderPassInfo.pSubpasses = &subpass_m;
     // subpass dependency
@@ -59,12 +76,13 @@ VkSubpassDependency VkRenderPassFactory::createSubpassDependency()
     // dstSubpass souhld be higher than srcSubpass to prevent cycles
     dependency.dstSubpass = 0;
     // the operations to wait on and the stages in which these operations occur
+    // the depth buffer is shared by the frames in flight, the clear waits for the depth writes of the previous one
     dependency.srcStageMask = 
-        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependency.srcAccessMask = 0;
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependency.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
     dependency.dstStageMask = 
-        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
     dependency.dstAccessMask = 
-        VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
     return dependency;
 }
\ No newline at end of file
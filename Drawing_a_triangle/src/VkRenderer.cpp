@@ -1,14 +1,59 @@
 #include <VkRenderer.hpp>
 #include <iostream>
+#include <algorithm>
 
-// how many frames should be processed concurrently
-constexpr size_t MAX_FRAMES_IN_FIGHT = 2;
+size_t VkRenderer::getCurrentFrame() const
+{
+    return currentFrame_m;
+}
+
+const std::vector<VkFence>& VkRenderer::getInFlightFencesRef() const
+{
+    return inFlightFences_m;
+}
+
+bool VkRenderer::isSuboptimal() const
+{
+    return suboptimal_m;
+}
+
+void VkRenderer::resetImagesInFlight(size_t imagesNum)
+{
+    // the image count of the new swap chain may differ
+    imagesInFlight_m.assign(imagesNum, VK_NULL_HANDLE);
+    suboptimal_m = false;
+}
 
-void VkRenderer::createSyncObjects(const VkDevice& device, size_t imagesNum)
+size_t VkRenderer::getFramesInFlight() const
 {
-    imageAvailableSemaphores_m.resize(MAX_FRAMES_IN_FIGHT);
-    renderFinishedSemaphores_m.resize(MAX_FRAMES_IN_FIGHT);
-    inFlightFences_m.resize(MAX_FRAMES_IN_FIGHT);
+    return framesInFlight_m;
+}
+
+double VkRenderer::getLastLatencyMs() const
+{
+    return lastLatencyMs_m;
+}
+
+void VkRenderer::setFramesInFlight(const VkDevice& device, size_t framesInFlight)
+{
+    // the frame slots are renumbered, so nothing may still use them
+    vkWaitForFences(device, static_cast<uint32_t>(inFlightFences_m.size()), inFlightFences_m.data(),
+        VK_TRUE, UINT64_MAX);
+    framesInFlight_m = std::min(std::max(framesInFlight, size_t(1)), MAX_FRAMES_IN_FLIGHT);
+    currentFrame_m = 0;
+    framesPending_m.assign(MAX_FRAMES_IN_FLIGHT, false);
+    lastLatencyMs_m = -1.0;
+}
+
+void VkRenderer::createSyncObjects(const VkDevice& device, size_t imagesNum, size_t framesInFlight)
+{
+    framesInFlight_m = std::min(std::max(framesInFlight, size_t(1)), MAX_FRAMES_IN_FLIGHT);
+    currentFrame_m = 0;
+    frameStartTimes_m.resize(MAX_FRAMES_IN_FLIGHT);
+    framesPending_m.assign(MAX_FRAMES_IN_FLIGHT, false);
+    imageAvailableSemaphores_m.resize(MAX_FRAMES_IN_FLIGHT);
+    renderFinishedSemaphores_m.resize(MAX_FRAMES_IN_FLIGHT);
+    inFlightFences_m.resize(MAX_FRAMES_IN_FLIGHT);
     // initially not a single framce is using an image, so initialize it to no fence
     imagesInFlight_m.resize(imagesNum, VK_NULL_HANDLE);
 
@@ -19,7 +64,7 @@ void VkRenderer::createSyncObjects(const VkDevice& device, size_t imagesNum)
     // initialize fences in the signaled state as if they had been rendered an initial frame
     fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
  
-    for (size_t i = 0; i < MAX_FRAMES_IN_FIGHT; i++) {
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
         // future version of the vulkan api may add functionality for other parameters
         if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &imageAvailableSemaphores_m[i]) != VK_SUCCESS ||
             vkCreateSemaphore(device, &semaphoreInfo, nullptr, &renderFinishedSemaphores_m[i]) != VK_SUCCESS ||
@@ -30,41 +75,68 @@ void VkRenderer::createSyncObjects(const VkDevice& device, size_t imagesNum)
 
 void VkRenderer::destroyRenderer(const VkDevice& device)
 {
-    for (size_t i = 0; i < MAX_FRAMES_IN_FIGHT; i++) {
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
         vkDestroySemaphore(device, renderFinishedSemaphores_m[i], nullptr);
         vkDestroySemaphore(device, imageAvailableSemaphores_m[i], nullptr);
         vkDestroyFence(device, inFlightFences_m[i], nullptr);
     }
 }
 // true : up to date, false : out of date
-bool VkRenderer::drawFrame(const VkDeviceManager& deviceManager, 
-    const VkSwapchainKHR& swapChain, const std::vector<VkCommandBuffer>& commandBuffers)
+bool VkRenderer::beginFrame(const VkDeviceManager& deviceManager,
+    const VkSwapchainKHR& swapChain, uint32_t& imageIndex)
 {
     const auto& device = deviceManager.getDevice();
-    // Acquiring an image from the swap chain
-    // index of the aquired image (VkImage in swapChainImages array)
-    uint32_t imageIndex;
     // specify a timeout in nanoseconds for an image
     auto timeout = UINT64_MAX;
+    // the input of this frame has just been polled
+    auto startTime = std::chrono::steady_clock::now();
 
     // wait for the frame to be finished
     vkWaitForFences(device, 1, &inFlightFences_m[currentFrame_m], VK_TRUE, timeout);
+    lastLatencyMs_m = -1.0;
+    if (framesPending_m[currentFrame_m]) {
+        lastLatencyMs_m = std::chrono::duration<double, std::milli>
+            (std::chrono::steady_clock::now() - frameStartTimes_m[currentFrame_m]).count();
+        framesPending_m[currentFrame_m] = false;
+    }
+    frameStartTimes_m[currentFrame_m] = startTime;
 
-    // after acquiring image, the imageSemaphore is signaled
-    VkResult result = vkAcquireNextImageKHR(device, swapChain, timeout,
-        imageAvailableSemaphores_m[currentFrame_m], VK_NULL_HANDLE, &imageIndex);
-    // figure out when swap chain recreation is necessary
-    if(result == VK_ERROR_OUT_OF_DATE_KHR)
-        return false;
-    // VK_SUBOPTIMAL_KHR is still able to present to it
-    else if(result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
-        throw std::runtime_error("failed to aquire swap chain image!");
+    if (deviceManager.isHeadless()) {
+        // offscreen images are used in round robin order
+        imageIndex = offscreenImageIndex_m;
+        offscreenImageIndex_m = (offscreenImageIndex_m + 1) % static_cast<uint32_t>(imagesInFlight_m.size());
+    }
+    else {
+        // Acquiring an image from the swap chain
+        // after acquiring image, the imageSemaphore is signaled
+        VkResult result = vkAcquireNextImageKHR(device, swapChain, timeout,
+            imageAvailableSemaphores_m[currentFrame_m], VK_NULL_HANDLE, &imageIndex);
+        // figure out when swap chain recreation is necessary
+        if(result == VK_ERROR_OUT_OF_DATE_KHR)
+            return false;
+        // VK_SUBOPTIMAL_KHR is still able to present to it
+        else if(result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
+            throw std::runtime_error("failed to aquire swap chain image!");
+        if (result == VK_SUBOPTIMAL_KHR)
+            suboptimal_m = true;
+    }
 
     // check if a previous frame is using this image
     if(imagesInFlight_m[imageIndex] != VK_NULL_HANDLE)
         vkWaitForFences(device, 1, &imagesInFlight_m[imageIndex], VK_TRUE, timeout);
     // mark the image as now being in use by this frame
     imagesInFlight_m[imageIndex] = inFlightFences_m[currentFrame_m];
+    // index of the aquired image (VkImage in swapChainImages array)
+    imageIndex_m = imageIndex;
+    return true;
+}
+
+bool VkRenderer::endFrame(const VkDeviceManager& deviceManager,
+    const VkSwapchainKHR& swapChain, const VkCommandBuffer& commandBuffer)
+{
+    if (deviceManager.isHeadless())
+        return endFrameOffscreen(deviceManager, commandBuffer);
+    const auto& device = deviceManager.getDevice();
 
     //submitting the command buffer
     const auto& graphicsQueue = deviceManager.getGraphicsQueueRef();
@@ -82,7 +154,7 @@ bool VkRenderer::drawFrame(const VkDeviceManager& deviceManager,
     // should submit the command buffer that binds the swap chain image 
     // we just acquired as color attachiment.
     submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &commandBuffers[imageIndex];
+    submitInfo.pCommandBuffers = &commandBuffer;
     // specify which semaphores to signal once the comand buffer have finished execution
     VkSemaphore signalSemaphores[] = {renderFinishedSemaphores_m[currentFrame_m]};
     submitInfo.signalSemaphoreCount = 1;
@@ -94,6 +166,7 @@ bool VkRenderer::drawFrame(const VkDeviceManager& deviceManager,
     // submit the command buffer to the graphics queue with fence
     if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences_m[currentFrame_m]) != VK_SUCCESS)
         throw std::runtime_error("failed to submit draw command buffer!");
+    framesPending_m[currentFrame_m] = true;
 
     // configure subpass dependencies in VkRenderPassFacotry::createRenderPass
 
@@ -106,18 +179,37 @@ bool VkRenderer::drawFrame(const VkDeviceManager& deviceManager,
     VkSwapchainKHR swapChains[] = {swapChain};
     presentInfo.swapchainCount = 1;
     presentInfo.pSwapchains = swapChains;
-    presentInfo.pImageIndices = &imageIndex;
+    presentInfo.pImageIndices = &imageIndex_m;
     // necessary for multi swap chain
     presentInfo.pResults = nullptr; // optional
     const auto& presentQueue = deviceManager.getPresentQueueRef();
-    result = vkQueuePresentKHR(presentQueue, &presentInfo);
+    auto result = vkQueuePresentKHR(presentQueue, &presentInfo);
+    // use the next pair of semaphores and fence whether or not the swap chain is up to date
+    currentFrame_m = (currentFrame_m + 1) % framesInFlight_m;
     
-    if(result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || framebufferResized) {
-        framebufferResized = false;
-        currentFrame_m = (currentFrame_m + 1) % MAX_FRAMES_IN_FIGHT;
+    // a suboptimal swap chain is recreated when the application finds it convenient
+    if(result == VK_ERROR_OUT_OF_DATE_KHR)
         return false;
-    }
+    else if(result == VK_SUBOPTIMAL_KHR)
+        suboptimal_m = true;
     else if(result != VK_SUCCESS)
         throw std::runtime_error("failed to present swap chain image!");
     return true;
-}
\ No newline at end of file
+}
+
+// there is nothing to present, so the acquire and present semaphores are unnecessary
+bool VkRenderer::endFrameOffscreen(const VkDeviceManager& deviceManager, const VkCommandBuffer& commandBuffer)
+{
+    const auto& device = deviceManager.getDevice();
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+
+    vkResetFences(device, 1, &inFlightFences_m[currentFrame_m]);
+    if (vkQueueSubmit(deviceManager.getGraphicsQueueRef(), 1, &submitInfo, inFlightFences_m[currentFrame_m]) != VK_SUCCESS)
+        throw std::runtime_error("failed to submit draw command buffer!");
+    framesPending_m[currentFrame_m] = true;
+    currentFrame_m = (currentFrame_m + 1) % framesInFlight_m;
+    return true;
+}
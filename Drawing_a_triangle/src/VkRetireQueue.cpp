@@ -0,0 +1,38 @@
+#include <VkRetireQueue.hpp>
+#include <algorithm>
+
+void VkRetireQueue::retire(const std::vector<VkFence>& fences, std::function<void(void)> destroy)
+{
+    retired_m.push_back(Retired{fences, std::move(destroy)});
+}
+
+void VkRetireQueue::collect(const VkDevice& device)
+{
+    for (auto& retired : retired_m) {
+        // a frame fence is only reset after it has been waited on, so once it has been seen
+        // signaled, the frame submitted with it before retire has finished
+        auto& fences = retired.fences_m;
+        fences.erase(std::remove_if(fences.begin(), fences.end(), [&](const VkFence& fence)
+            { return vkGetFenceStatus(device, fence) == VK_SUCCESS; }), fences.end());
+    }
+    // destroy in retire order
+    while (!retired_m.empty() && retired_m.front().fences_m.empty()) {
+        auto destroy = std::move(retired_m.front().destroy_m);
+        retired_m.pop_front();
+        destroy();
+    }
+}
+
+void VkRetireQueue::flush()
+{
+    while (!retired_m.empty()) {
+        auto destroy = std::move(retired_m.front().destroy_m);
+        retired_m.pop_front();
+        destroy();
+    }
+}
+
+size_t VkRetireQueue::size() const
+{
+    return retired_m.size();
+}
@@ -0,0 +1,529 @@
+#include <VkShaderReflection.hpp>
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+#include <unordered_map>
+
+// values of the SPIR-V specification, only those needed to read the interface
+static constexpr uint32_t SPIRV_MAGIC = 0x07230203;
+static constexpr uint32_t SPIRV_HEADER_WORDS = 5;
+enum SpirvOp : uint32_t
+{
+    OP_ENTRY_POINT = 15,
+    OP_TYPE_INT = 21,
+    OP_TYPE_FLOAT = 22,
+    OP_TYPE_VECTOR = 23,
+    OP_TYPE_MATRIX = 24,
+    OP_TYPE_IMAGE = 25,
+    OP_TYPE_SAMPLER = 26,
+    OP_TYPE_SAMPLED_IMAGE = 27,
+    OP_TYPE_ARRAY = 28,
+    OP_TYPE_RUNTIME_ARRAY = 29,
+    OP_TYPE_STRUCT = 30,
+    OP_TYPE_POINTER = 32,
+    OP_CONSTANT = 43,
+    OP_VARIABLE = 59,
+    OP_DECORATE = 71,
+    OP_MEMBER_DECORATE = 72
+};
+enum SpirvDecoration : uint32_t
+{
+    DECORATION_BLOCK = 2,
+    DECORATION_BUFFER_BLOCK = 3,
+    DECORATION_ARRAY_STRIDE = 6,
+    DECORATION_MATRIX_STRIDE = 7,
+    DECORATION_BUILT_IN = 11,
+    DECORATION_LOCATION = 30,
+    DECORATION_BINDING = 33,
+    DECORATION_DESCRIPTOR_SET = 34,
+    DECORATION_OFFSET = 35
+};
+enum SpirvStorageClass : uint32_t
+{
+    STORAGE_CLASS_UNIFORM_CONSTANT = 0,
+    STORAGE_CLASS_INPUT = 1,
+    STORAGE_CLASS_UNIFORM = 2,
+    STORAGE_CLASS_PUSH_CONSTANT = 9,
+    STORAGE_CLASS_STORAGE_BUFFER = 12
+};
+// Dim operand of OpTypeImage
+static constexpr uint32_t SPIRV_DIM_BUFFER = 5;
+static constexpr uint32_t SPIRV_DIM_SUBPASS_DATA = 6;
+static constexpr uint32_t NOT_DECORATED = UINT32_MAX;
+
+namespace
+{
+    // the operands following the result id of a type instruction
+    struct SpirvType
+    {
+        uint32_t opcode_m;
+        std::vector<uint32_t> operands_m;
+    };
+    struct SpirvDecorations
+    {
+        bool block_m = false;
+        bool bufferBlock_m = false;
+        bool builtIn_m = false;
+        uint32_t location_m = NOT_DECORATED;
+        uint32_t binding_m = NOT_DECORATED;
+        uint32_t set_m = NOT_DECORATED;
+        uint32_t arrayStride_m = NOT_DECORATED;
+        // struct members only
+        uint32_t offset_m = NOT_DECORATED;
+        uint32_t matrixStride_m = NOT_DECORATED;
+    };
+    struct SpirvVariable
+    {
+        uint32_t id_m;
+        uint32_t pointerType_m;
+        uint32_t storageClass_m;
+    };
+
+    class SpirvModule
+    {
+    public:
+        explicit SpirvModule(const std::vector<char>& code);
+        VkShaderReflection::ShaderInterface getInterface() const;
+    private:
+        void decorate(SpirvDecorations& decorations, uint32_t decoration, uint32_t literal);
+        const SpirvType& getType(uint32_t id) const;
+        const SpirvDecorations& getDecorations(uint32_t id) const;
+        const SpirvDecorations& getMemberDecorations(uint32_t structId, uint32_t member) const;
+        uint32_t getConstant(uint32_t id) const;
+        // bytes taken by a value of the type in a buffer
+        uint32_t getTypeSize(uint32_t id) const;
+        VkFormat getInputFormat(uint32_t id) const;
+        void addInputs(uint32_t typeId, uint32_t location, std::vector<VkShaderReflection::Input>& inputs) const;
+        VkShaderReflection::DescriptorBinding getDescriptorBinding(const SpirvVariable& variable) const;
+        VkPushConstantRange getPushConstantRange(uint32_t structId) const;
+
+        VkShaderStageFlags stage_m = 0;
+        std::unordered_map<uint32_t, SpirvType> types_m;
+        std::unordered_map<uint32_t, uint32_t> constants_m;
+        std::unordered_map<uint32_t, SpirvDecorations> decorations_m;
+        std::unordered_map<uint32_t, std::vector<SpirvDecorations>> memberDecorations_m;
+        std::vector<SpirvVariable> variables_m;
+    };
+}
+
+// operands, result id included, read from an instruction
+static uint32_t getMinimumOperandCount(uint32_t opcode)
+{
+    switch (opcode) {
+    case OP_ENTRY_POINT:            return 2;
+    case OP_TYPE_INT:               return 3;
+    case OP_TYPE_FLOAT:             return 2;
+    case OP_TYPE_VECTOR:            return 3;
+    case OP_TYPE_MATRIX:            return 3;
+    case OP_TYPE_IMAGE:             return 8;
+    case OP_TYPE_SAMPLED_IMAGE:     return 2;
+    case OP_TYPE_ARRAY:             return 3;
+    case OP_TYPE_RUNTIME_ARRAY:     return 2;
+    case OP_TYPE_POINTER:           return 3;
+    case OP_CONSTANT:               return 3;
+    case OP_VARIABLE:               return 3;
+    case OP_DECORATE:               return 2;
+    case OP_MEMBER_DECORATE:        return 3;
+    default:                        return 0;
+    }
+}
+
+SpirvModule::SpirvModule(const std::vector<char>& code)
+{
+    if (code.size() % sizeof(uint32_t) != 0 || code.size() < SPIRV_HEADER_WORDS * sizeof(uint32_t))
+        throw std::runtime_error("failed to reflect shader, invalid SPIR-V size!");
+    // the char buffer may not be aligned for uint32_t
+    std::vector<uint32_t> words(code.size() / sizeof(uint32_t));
+    std::memcpy(words.data(), code.data(), code.size());
+    if (words[0] != SPIRV_MAGIC)
+        throw std::runtime_error("failed to reflect shader, invalid SPIR-V magic number!");
+    size_t position = SPIRV_HEADER_WORDS;
+    while (position < words.size()) {
+        uint32_t wordCount = words[position] >> 16;
+        uint32_t opcode = words[position] & 0xFFFF;
+        if (wordCount == 0 || position + wordCount > words.size() || wordCount - 1 < getMinimumOperandCount(opcode))
+            throw std::runtime_error("failed to reflect shader, truncated SPIR-V instruction!");
+        const uint32_t* operands = &words[position + 1];
+        uint32_t operandCount = wordCount - 1;
+        switch (opcode) {
+        case OP_ENTRY_POINT:
+            // the first entry point, the shaders are compiled one stage per file
+            if (stage_m == 0) {
+                static const VkShaderStageFlagBits stages[] =
+                {
+                    VK_SHADER_STAGE_VERTEX_BIT,
+                    VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT,
+                    VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT,
+                    VK_SHADER_STAGE_GEOMETRY_BIT,
+                    VK_SHADER_STAGE_FRAGMENT_BIT,
+                    VK_SHADER_STAGE_COMPUTE_BIT
+                };
+                if (operands[0] >= std::size(stages))
+                    throw std::runtime_error("failed to reflect shader, unsupported execution model!");
+                stage_m = stages[operands[0]];
+            }
+            break;
+        case OP_TYPE_INT:
+        case OP_TYPE_FLOAT:
+        case OP_TYPE_VECTOR:
+        case OP_TYPE_MATRIX:
+        case OP_TYPE_IMAGE:
+        case OP_TYPE_SAMPLER:
+        case OP_TYPE_SAMPLED_IMAGE:
+        case OP_TYPE_ARRAY:
+        case OP_TYPE_RUNTIME_ARRAY:
+        case OP_TYPE_STRUCT:
+        case OP_TYPE_POINTER:
+            types_m[operands[0]] = SpirvType{opcode, std::vector<uint32_t>(operands + 1, operands + operandCount)};
+            break;
+        case OP_CONSTANT:
+            // result type, result id, low word of the value
+            constants_m[operands[1]] = operands[2];
+            break;
+        case OP_VARIABLE:
+            variables_m.push_back(SpirvVariable{operands[1], operands[0], operands[2]});
+            break;
+        case OP_DECORATE:
+            decorate(decorations_m[operands[0]], operands[1], operandCount > 2 ? operands[2] : 0);
+            break;
+        case OP_MEMBER_DECORATE: {
+            auto& members = memberDecorations_m[operands[0]];
+            if (members.size() <= operands[1])
+                members.resize(operands[1] + 1);
+            decorate(members[operands[1]], operands[2], operandCount > 3 ? operands[3] : 0);
+            break;
+        }
+        default:
+            break;
+        }
+        position += wordCount;
+    }
+    if (stage_m == 0)
+        throw std::runtime_error("failed to reflect shader, no entry point!");
+}
+
+void SpirvModule::decorate(SpirvDecorations& decorations, uint32_t decoration, uint32_t literal)
+{
+    switch (decoration) {
+    case DECORATION_BLOCK:          decorations.block_m = true; break;
+    case DECORATION_BUFFER_BLOCK:   decorations.bufferBlock_m = true; break;
+    case DECORATION_BUILT_IN:       decorations.builtIn_m = true; break;
+    case DECORATION_LOCATION:       decorations.location_m = literal; break;
+    case DECORATION_BINDING:        decorations.binding_m = literal; break;
+    case DECORATION_DESCRIPTOR_SET: decorations.set_m = literal; break;
+    case DECORATION_ARRAY_STRIDE:   decorations.arrayStride_m = literal; break;
+    case DECORATION_OFFSET:         decorations.offset_m = literal; break;
+    case DECORATION_MATRIX_STRIDE:  decorations.matrixStride_m = literal; break;
+    default: break;
+    }
+}
+
+const SpirvType& SpirvModule::getType(uint32_t id) const
+{
+    auto type = types_m.find(id);
+    if (type == types_m.end())
+        throw std::runtime_error("failed to reflect shader, unknown type!");
+    return type->second;
+}
+
+const SpirvDecorations& SpirvModule::getDecorations(uint32_t id) const
+{
+    static const SpirvDecorations none;
+    auto decorations = decorations_m.find(id);
+    return decorations == decorations_m.end() ? none : decorations->second;
+}
+
+const SpirvDecorations& SpirvModule::getMemberDecorations(uint32_t structId, uint32_t member) const
+{
+    static const SpirvDecorations none;
+    auto members = memberDecorations_m.find(structId);
+    if (members == memberDecorations_m.end() || member >= members->second.size())
+        return none;
+    return members->second[member];
+}
+
+uint32_t SpirvModule::getConstant(uint32_t id) const
+{
+    auto constant = constants_m.find(id);
+    // specialization constants are not resolved
+    if (constant == constants_m.end())
+        throw std::runtime_error("failed to reflect shader, array size is not a constant!");
+    return constant->second;
+}
+
+uint32_t SpirvModule::getTypeSize(uint32_t id) const
+{
+    const auto& type = getType(id);
+    switch (type.opcode_m) {
+    case OP_TYPE_INT:
+    case OP_TYPE_FLOAT:
+        return type.operands_m[0] / 8;
+    case OP_TYPE_VECTOR:
+    case OP_TYPE_MATRIX:
+        return type.operands_m[1] * getTypeSize(type.operands_m[0]);
+    case OP_TYPE_ARRAY: {
+        auto stride = getDecorations(id).arrayStride_m;
+        if (stride == NOT_DECORATED)
+            stride = getTypeSize(type.operands_m[0]);
+        return getConstant(type.operands_m[1]) * stride;
+    }
+    case OP_TYPE_RUNTIME_ARRAY:
+        // sized by the buffer bound to it
+        return 0;
+    case OP_TYPE_STRUCT: {
+        uint32_t size = 0;
+        for (uint32_t member = 0; member < type.operands_m.size(); member++) {
+            const auto& decorations = getMemberDecorations(id, member);
+            auto memberType = type.operands_m[member];
+            auto memberSize = getTypeSize(memberType);
+            // a column may be padded, with std140 a mat3 column takes 16 bytes
+            if (getType(memberType).opcode_m == OP_TYPE_MATRIX && decorations.matrixStride_m != NOT_DECORATED)
+                memberSize = getType(memberType).operands_m[1] * decorations.matrixStride_m;
+            auto offset = decorations.offset_m == NOT_DECORATED ? size : decorations.offset_m;
+            size = std::max(size, offset + memberSize);
+        }
+        return size;
+    }
+    default:
+        throw std::runtime_error("failed to reflect shader, type has no size!");
+    }
+}
+
+VkFormat SpirvModule::getInputFormat(uint32_t id) const
+{
+    const auto& type = getType(id);
+    uint32_t componentCount = 1;
+    auto componentType = &type;
+    if (type.opcode_m == OP_TYPE_VECTOR) {
+        componentCount = type.operands_m[1];
+        componentType = &getType(type.operands_m[0]);
+    }
+    if (componentType->operands_m[0] != 32 || componentCount < 1 || componentCount > 4)
+        throw std::runtime_error("failed to reflect shader, unsupported vertex input type!");
+    static const VkFormat floatFormats[] = {VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT,
+        VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT};
+    static const VkFormat intFormats[] = {VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT,
+        VK_FORMAT_R32G32B32_SINT, VK_FORMAT_R32G32B32A32_SINT};
+    static const VkFormat uintFormats[] = {VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT,
+        VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32A32_UINT};
+    if (componentType->opcode_m == OP_TYPE_FLOAT)
+        return floatFormats[componentCount - 1];
+    if (componentType->opcode_m == OP_TYPE_INT)
+        // the second operand of OpTypeInt is the signedness
+        return componentType->operands_m[1] ? intFormats[componentCount - 1] : uintFormats[componentCount - 1];
+    throw std::runtime_error("failed to reflect shader, unsupported vertex input type!");
+}
+
+void SpirvModule::addInputs(uint32_t typeId, uint32_t location, std::vector<VkShaderReflection::Input>& inputs) const
+{
+    const auto& type = getType(typeId);
+    if (type.opcode_m == OP_TYPE_MATRIX) {
+        // one location per column
+        for (uint32_t column = 0; column < type.operands_m[1]; column++)
+            inputs.push_back({location + column, getInputFormat(type.operands_m[0])});
+    }
+    else if (type.opcode_m == OP_TYPE_ARRAY) {
+        auto length = getConstant(type.operands_m[1]);
+        const auto& elementType = getType(type.operands_m[0]);
+        uint32_t locationsPerElement = elementType.opcode_m == OP_TYPE_MATRIX ? elementType.operands_m[1] : 1;
+        for (uint32_t element = 0; element < length; element++)
+            addInputs(type.operands_m[0], location + element * locationsPerElement, inputs);
+    }
+    else
+        inputs.push_back({location, getInputFormat(typeId)});
+}
+
+VkShaderReflection::DescriptorBinding SpirvModule::getDescriptorBinding(const SpirvVariable& variable) const
+{
+    const auto& decorations = getDecorations(variable.id_m);
+    if (decorations.binding_m == NOT_DECORATED)
+        throw std::runtime_error("failed to reflect shader, resource without binding!");
+    VkShaderReflection::DescriptorBinding binding{};
+    // set 0 when the shader does not give it
+    binding.set_m = decorations.set_m == NOT_DECORATED ? 0 : decorations.set_m;
+    binding.binding_m = decorations.binding_m;
+    binding.descriptorCount_m = 1;
+    binding.stageFlags_m = stage_m;
+    // arrays of descriptors
+    auto typeId = getType(variable.pointerType_m).operands_m[1];
+    while (getType(typeId).opcode_m == OP_TYPE_ARRAY || getType(typeId).opcode_m == OP_TYPE_RUNTIME_ARRAY) {
+        if (getType(typeId).opcode_m == OP_TYPE_RUNTIME_ARRAY)
+            throw std::runtime_error("failed to reflect shader, unsized descriptor arrays are not supported!");
+        binding.descriptorCount_m *= getConstant(getType(typeId).operands_m[1]);
+        typeId = getType(typeId).operands_m[0];
+    }
+    const auto& type = getType(typeId);
+    switch (type.opcode_m) {
+    case OP_TYPE_STRUCT:
+        // before SPIR-V 1.3 storage buffers are Uniform blocks decorated with BufferBlock
+        binding.descriptorType_m = variable.storageClass_m == STORAGE_CLASS_STORAGE_BUFFER
+            || getDecorations(typeId).bufferBlock_m ?
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        if (binding.descriptorType_m == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER)
+            binding.blockSize_m = getTypeSize(typeId);
+        break;
+    case OP_TYPE_SAMPLER:
+        binding.descriptorType_m = VK_DESCRIPTOR_TYPE_SAMPLER;
+        break;
+    case OP_TYPE_SAMPLED_IMAGE:
+        binding.descriptorType_m = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        break;
+    case OP_TYPE_IMAGE: {
+        // sampled type, dim, depth, arrayed, multisampled, sampled (1 with a sampler, 2 for storage)
+        auto dim = type.operands_m[1];
+        auto sampled = type.operands_m[5];
+        if (dim == SPIRV_DIM_BUFFER)
+            binding.descriptorType_m = sampled == 2 ?
+                VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+        else if (dim == SPIRV_DIM_SUBPASS_DATA)
+            binding.descriptorType_m = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+        else
+            binding.descriptorType_m = sampled == 2 ?
+                VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+        break;
+    }
+    default:
+        throw std::runtime_error("failed to reflect shader, unsupported resource type!");
+    }
+    return binding;
+}
+
+VkPushConstantRange SpirvModule::getPushConstantRange(uint32_t structId) const
+{
+    const auto& type = getType(structId);
+    VkPushConstantRange range{};
+    range.stageFlags = stage_m;
+    // a block shared by several stages may start after the members another stage uses
+    range.offset = UINT32_MAX;
+    for (uint32_t member = 0; member < type.operands_m.size(); member++) {
+        auto offset = getMemberDecorations(structId, member).offset_m;
+        range.offset = std::min(range.offset, offset == NOT_DECORATED ? 0 : offset);
+    }
+    if (range.offset == UINT32_MAX)
+        range.offset = 0;
+    range.size = getTypeSize(structId) - range.offset;
+    return range;
+}
+
+VkShaderReflection::ShaderInterface SpirvModule::getInterface() const
+{
+    VkShaderReflection::ShaderInterface interface;
+    interface.stageFlags_m = stage_m;
+    for (const auto& variable : variables_m) {
+        const auto& pointer = getType(variable.pointerType_m);
+        if (pointer.opcode_m != OP_TYPE_POINTER)
+            throw std::runtime_error("failed to reflect shader, variable is not a pointer!");
+        auto typeId = pointer.operands_m[1];
+        switch (variable.storageClass_m) {
+        case STORAGE_CLASS_INPUT: {
+            // gl_VertexIndex and the like are not fed by vertex attributes
+            const auto& decorations = getDecorations(variable.id_m);
+            if (stage_m != VK_SHADER_STAGE_VERTEX_BIT || decorations.builtIn_m)
+                break;
+            if (decorations.location_m == NOT_DECORATED)
+                throw std::runtime_error("failed to reflect shader, vertex input without location!");
+            addInputs(typeId, decorations.location_m, interface.inputs_m);
+            break;
+        }
+        case STORAGE_CLASS_UNIFORM_CONSTANT:
+        case STORAGE_CLASS_UNIFORM:
+        case STORAGE_CLASS_STORAGE_BUFFER:
+            interface.descriptorBindings_m.push_back(getDescriptorBinding(variable));
+            break;
+        case STORAGE_CLASS_PUSH_CONSTANT:
+            interface.pushConstantRange_m = getPushConstantRange(typeId);
+            break;
+        default:
+            break;
+        }
+    }
+    std::sort(interface.inputs_m.begin(), interface.inputs_m.end(),
+        [](const auto& a, const auto& b) { return a.location_m < b.location_m; });
+    std::sort(interface.descriptorBindings_m.begin(), interface.descriptorBindings_m.end(),
+        [](const auto& a, const auto& b) { return a.set_m != b.set_m ? a.set_m < b.set_m : a.binding_m < b.binding_m; });
+    return interface;
+}
+
+VkShaderReflection::ShaderInterface VkShaderReflection::reflect(const std::vector<char>& code)
+{
+    return SpirvModule(code).getInterface();
+}
+
+VkShaderReflection::ShaderInterface VkShaderReflection::merge(const std::vector<ShaderInterface>& interfaces)
+{
+    ShaderInterface merged;
+    uint32_t pushConstantEnd = 0;
+    for (const auto& interface : interfaces) {
+        merged.stageFlags_m |= interface.stageFlags_m;
+        if (interface.stageFlags_m & VK_SHADER_STAGE_VERTEX_BIT)
+            merged.inputs_m = interface.inputs_m;
+        for (const auto& binding : interface.descriptorBindings_m) {
+            auto existing = std::find_if(merged.descriptorBindings_m.begin(), merged.descriptorBindings_m.end(),
+                [&](const auto& other) { return other.set_m == binding.set_m && other.binding_m == binding.binding_m; });
+            if (existing == merged.descriptorBindings_m.end())
+                merged.descriptorBindings_m.push_back(binding);
+            else if (existing->descriptorType_m != binding.descriptorType_m
+                || existing->descriptorCount_m != binding.descriptorCount_m)
+                throw std::runtime_error("failed to merge shader interfaces, a binding differs between stages!");
+            else {
+                existing->stageFlags_m |= binding.stageFlags_m;
+                // each stage may only declare the members it reads
+                existing->blockSize_m = std::max(existing->blockSize_m, binding.blockSize_m);
+            }
+        }
+        const auto& range = interface.pushConstantRange_m;
+        if (range.size == 0)
+            continue;
+        // a single range visible to every stage using push constants
+        auto& mergedRange = merged.pushConstantRange_m;
+        mergedRange.offset = mergedRange.size == 0 ? range.offset : std::min(mergedRange.offset, range.offset);
+        pushConstantEnd = std::max(pushConstantEnd, range.offset + range.size);
+        mergedRange.size = pushConstantEnd - mergedRange.offset;
+        mergedRange.stageFlags |= range.stageFlags;
+    }
+    std::sort(merged.descriptorBindings_m.begin(), merged.descriptorBindings_m.end(),
+        [](const auto& a, const auto& b) { return a.set_m != b.set_m ? a.set_m < b.set_m : a.binding_m < b.binding_m; });
+    return merged;
+}
+
+void VkShaderReflection::setDynamicUniformBuffers(ShaderInterface& interface, uint32_t set)
+{
+    for (auto& binding : interface.descriptorBindings_m)
+        if (binding.set_m == set && binding.descriptorType_m == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER)
+            binding.descriptorType_m = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+}
+
+std::vector<VkDescriptorSetLayoutBinding> VkShaderReflection::getSetLayoutBindings(const ShaderInterface& interface,
+    uint32_t set)
+{
+    std::vector<VkDescriptorSetLayoutBinding> bindings;
+    for (const auto& binding : interface.descriptorBindings_m) {
+        if (binding.set_m != set)
+            continue;
+        VkDescriptorSetLayoutBinding layoutBinding{};
+        layoutBinding.binding = binding.binding_m;
+        layoutBinding.descriptorType = binding.descriptorType_m;
+        layoutBinding.descriptorCount = binding.descriptorCount_m;
+        layoutBinding.stageFlags = binding.stageFlags_m;
+        bindings.push_back(layoutBinding);
+    }
+    return bindings;
+}
+
+uint32_t VkShaderReflection::getSetCount(const ShaderInterface& interface)
+{
+    // sorted by set
+    return interface.descriptorBindings_m.empty() ? 0 : interface.descriptorBindings_m.back().set_m + 1;
+}
+
+bool VkShaderReflection::isVertexInputCompatible(const ShaderInterface& interface,
+    const std::vector<VkVertexInputAttributeDescription>& attributeDescriptions)
+{
+    // the format of an attribute may differ from the input, normalized formats are read as floats
+    return std::all_of(interface.inputs_m.begin(), interface.inputs_m.end(), [&](const Input& input)
+        {
+            return std::any_of(attributeDescriptions.begin(), attributeDescriptions.end(),
+                [&](const auto& attribute) { return attribute.location == input.location_m; });
+        });
+}
@@ -1,6 +1,7 @@
 #include <VKSwapChainManager.hpp>
 #include <VkDeviceManager.hpp>
 #include <iostream>
+#include <algorithm>
 
 const VkExtent2D& VkSwapChainManager::getSwapChainExtentRef() const
     { return swapChainExtent_m; }
@@ -12,16 +13,51 @@ const VkSwapchainKHR& VkSwapChainManager::getSwapChainRef() const
     { return swapChain_m; }
 const size_t VkSwapChainManager::getSwapChainImagesNum() const
     { return swapChainImages_m.size(); }
+VkPresentModeKHR VkSwapChainManager::getPresentMode() const
+    { return presentMode_m; }
+void VkSwapChainManager::setPresentProfile(const VkPresentProfile& profile)
+    { presentProfile_m = profile; }
+VkImageLayout VkSwapChainManager::getImageFinalLayout() const
+{
+    // offscreen images are kept ready for a readback instead of presentation
+    if (deviceManagerRef_m.isHeadless())
+        return VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    return VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+}
+
+static const char* getPresentModeName(VkPresentModeKHR presentMode)
+{
+    switch (presentMode) {
+    case VK_PRESENT_MODE_IMMEDIATE_KHR: return "immediate";
+    case VK_PRESENT_MODE_MAILBOX_KHR: return "mailbox";
+    case VK_PRESENT_MODE_FIFO_KHR: return "fifo";
+    case VK_PRESENT_MODE_FIFO_RELAXED_KHR: return "fifo relaxed";
+    default: return "unknown";
+    }
+}
+
+// how many offscreen images to rotate through in headless mode
+constexpr uint32_t OFFSCREEN_IMAGE_COUNT = 3;
 
 void VkSwapChainManager::createSwapChain(const uint32_t width, const uint32_t height)
 {
+    // there is no surface to present to
+    if (deviceManagerRef_m.isHeadless()) {
+        createOffscreenImages(width, height);
+        return;
+    }
     // dangerous cast
     auto swapChainSupport = deviceManagerRef_m.querySwapChainSupport(deviceManagerRef_m.physicalDevice_m);
     auto surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats_m);
     auto presentMode = chooseSwapPresentMode(swapChainSupport.presentModes_m);
     auto extent = chooseSwapExtent(swapChainSupport.capabilities_m);
     // how many images id like to have in the swap chain
-    uint32_t imageCount = swapChainSupport.capabilities_m.minImageCount + 1;
+    // one image per frame in flight plus the one being presented, so acquiring does not block
+    // mailbox needs a spare image to replace the queued one
+    uint32_t imageCount = presentProfile_m.framesInFlight_m + 1;
+    if (presentMode == VK_PRESENT_MODE_MAILBOX_KHR)
+        imageCount = std::max(imageCount, 3u);
+    imageCount = std::max(imageCount, swapChainSupport.capabilities_m.minImageCount);
     // make sure to not exceed the maximum number of images
     if (swapChainSupport.capabilities_m.maxImageCount > 0 && 
         imageCount > swapChainSupport.capabilities_m.maxImageCount) {
@@ -60,8 +96,10 @@ void VkSwapChainManager::createSwapChain(const uint32_t width, const uint32_t he
     createInfo.presentMode = presentMode;
     // ignore the color of obscured pixels
     createInfo.clipped = VK_TRUE;
-    // invalid or unoptimized swap chain should be reacreated from scratch
-    createInfo.oldSwapchain = VK_NULL_HANDLE;
+    // the retired swap chain lets the driver reuse its resources and keep presenting
+    // the images which are already queued, it is destroyed by the retire queue
+    createInfo.oldSwapchain = swapChain_m;
+    swapChain_m = VK_NULL_HANDLE;
     // create swap chain
     if (vkCreateSwapchainKHR(deviceManagerRef_m.device_m, &createInfo, nullptr, &swapChain_m) != VK_SUCCESS) {
         throw std::runtime_error("failed to create swap chain!");
@@ -72,6 +110,9 @@ void VkSwapChainManager::createSwapChain(const uint32_t width, const uint32_t he
     vkGetSwapchainImagesKHR(deviceManagerRef_m.device_m, swapChain_m, &imageCount, swapChainImages_m.data());
     swapChainImageFormat_m = surfaceFormat.format;
     swapChainExtent_m = extent;
+    presentMode_m = presentMode;
+    std::cout << "swap chain : " << presentProfile_m.name_m << " profile, present mode " << getPresentModeName(presentMode)
+        << ", " << imageCount << " images" << std::endl;
 }
 
 void VkSwapChainManager::createImageViews()
@@ -108,11 +149,94 @@ void VkSwapChainManager::destroyImageViews()
     for (auto& imageView : swapChainImageViews_m) {
         vkDestroyImageView(deviceManagerRef_m.getDevice(), imageView, nullptr);
     }
+    swapChainImageViews_m.clear();
 }
 
 void VkSwapChainManager::destroySwapChain()
 {
+    if (deviceManagerRef_m.isHeadless()) {
+        destroyOffscreenImages();
+        return;
+    }
     vkDestroySwapchainKHR(deviceManagerRef_m.getDevice(), swapChain_m, nullptr);
+    swapChain_m = VK_NULL_HANDLE;
+}
+
+void VkSwapChainManager::retireSwapChain(VkRetireQueue& retireQueue, const std::vector<VkFence>& fences)
+{
+    // swapChain_m is kept, it becomes the oldSwapchain of the next swap chain
+    auto device = deviceManagerRef_m.getDevice();
+    auto imageViews = std::move(swapChainImageViews_m);
+    swapChainImageViews_m.clear();
+    auto swapChain = swapChain_m;
+    retireQueue.retire(fences, [device, imageViews, swapChain]()
+        {
+            for (const auto& imageView : imageViews)
+                vkDestroyImageView(device, imageView, nullptr);
+            vkDestroySwapchainKHR(device, swapChain, nullptr);
+        });
+}
+
+// create the images a swap chain would own, so that image views, framebuffers
+// and command buffers can be created exactly the same way
+void VkSwapChainManager::createOffscreenImages(const uint32_t width, const uint32_t height)
+{
+    swapChainImageFormat_m = chooseOffscreenImageFormat();
+    swapChainExtent_m = {width, height};
+    swapChainImages_m.resize(OFFSCREEN_IMAGE_COUNT);
+    offscreenImageAllocations_m.resize(OFFSCREEN_IMAGE_COUNT);
+    for (size_t i = 0; i < swapChainImages_m.size(); i++) {
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.format = swapChainImageFormat_m;
+        imageInfo.extent = {width, height, 1};
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        // rendered by the render pass and possibly read back to the host
+        imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        memoryAllocatorRef_m.createImage(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            swapChainImages_m[i], offscreenImageAllocations_m[i]);
+    }
+    swapChain_m = VK_NULL_HANDLE;
+}
+
+void VkSwapChainManager::destroyOffscreenImages()
+{
+    for (size_t i = 0; i < swapChainImages_m.size(); i++)
+        memoryAllocatorRef_m.destroyImage(swapChainImages_m[i], offscreenImageAllocations_m[i]);
+    swapChainImages_m.clear();
+    offscreenImageAllocations_m.clear();
+}
+
+VkFormat VkSwapChainManager::chooseImageFormat()
+{
+    if (deviceManagerRef_m.isHeadless())
+        return chooseOffscreenImageFormat();
+    auto swapChainSupport = deviceManagerRef_m.querySwapChainSupport(deviceManagerRef_m.physicalDevice_m);
+    return chooseSwapSurfaceFormat(swapChainSupport.formats_m).format;
+}
+
+// same preference as chooseSwapSurfaceFormat, limited to what can be rendered to
+VkFormat VkSwapChainManager::chooseOffscreenImageFormat()
+{
+    const VkFormat candidates[] = {
+        VK_FORMAT_B8G8R8A8_SRGB,
+        VK_FORMAT_R8G8B8A8_SRGB,
+        VK_FORMAT_B8G8R8A8_UNORM,
+        VK_FORMAT_R8G8B8A8_UNORM
+    };
+    for (const auto& format : candidates) {
+        VkFormatProperties properties;
+        vkGetPhysicalDeviceFormatProperties(deviceManagerRef_m.getPhysicalDevice(), format, &properties);
+        if (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT)
+            return format;
+    }
+    throw std::runtime_error("failed to find a format for offscreen images!");
 }
 
 VkSurfaceFormatKHR VkSwapChainManager::chooseSwapSurfaceFormat
@@ -131,12 +255,13 @@ VkSurfaceFormatKHR VkSwapChainManager::chooseSwapSurfaceFormat
 VkPresentModeKHR VkSwapChainManager::chooseSwapPresentMode
     (const std::vector<VkPresentModeKHR>& availablePresentModes)
 {
-    for (const auto& availablePresentMode : availablePresentModes) {
-        // prefer triple buffering
-        if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
-            return availablePresentMode;
-        }
+    // in the order of preference of the profile
+    for (const auto& presentMode : presentProfile_m.presentModes_m) {
+        if (std::find(availablePresentModes.begin(), availablePresentModes.end(), presentMode)
+            != availablePresentModes.end())
+            return presentMode;
     }
+    // always available
     return VK_PRESENT_MODE_FIFO_KHR;
 }
 
@@ -0,0 +1,83 @@
+#include <VkUniformManager.hpp>
+#include <algorithm>
+#include <stdexcept>
+
+void VkUniformManager::createUniformManager(const VkDeviceManager& deviceManager,
+    VkMemoryAllocator& memoryAllocator, VkLayoutCacheManager& layoutCache, VkDescriptorAllocator& descriptorAllocator,
+    const VkShaderReflection::ShaderInterface& interface, uint32_t set, size_t framesInFlight,
+    VkDeviceSize regionSize)
+{
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(deviceManager.getPhysicalDevice(), &properties);
+    alignment_m = std::max<VkDeviceSize>(properties.limits.minUniformBufferOffsetAlignment, 1);
+    // every region starts on an aligned offset, so the offsets within it stay aligned
+    regionSize_m = (regionSize + alignment_m - 1) / alignment_m * alignment_m;
+    std::vector<VkShaderReflection::DescriptorBinding> bindings;
+    for (const auto& binding : interface.descriptorBindings_m)
+        if (binding.set_m == set)
+            bindings.push_back(binding);
+    for (const auto& binding : bindings) {
+        if (binding.descriptorType_m != VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC || binding.descriptorCount_m != 1)
+            throw std::runtime_error("failed to match the uniform ring with the descriptors of its set!");
+        // the range of a dynamic descriptor must fit in the region at any offset
+        if (binding.blockSize_m > regionSize_m || binding.blockSize_m > properties.limits.maxUniformBufferRange)
+            throw std::runtime_error("failed to fit a uniform block in the uniform ring!");
+    }
+
+    VkDeviceSize bufferSize = regionSize_m * framesInFlight;
+    // written by the CPU every frame and read once or twice by the GPU, like the instances
+    memoryAllocator.createHostVisibleBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+        VkMemoryAllocator::Lifetime::PERSISTENT, ringBuffer_m, ringBufferAllocation_m);
+    regionBegin_m = 0;
+    head_m = 0;
+    // the same layout as the one of the pipeline layouts, it comes from the cache
+    const auto& setLayout = layoutCache.getDescriptorSetLayout(VkShaderReflection::getSetLayoutBindings(interface, set));
+    createDescriptorSet(descriptorAllocator, setLayout, bindings);
+}
+
+void VkUniformManager::createDescriptorSet(VkDescriptorAllocator& descriptorAllocator,
+    const VkDescriptorSetLayout& setLayout, const std::vector<VkShaderReflection::DescriptorBinding>& bindings)
+{
+    descriptorSet_m = descriptorAllocator.allocate(setLayout, VkDescriptorAllocator::Lifetime::PERSISTENT);
+    // every binding sees one block at the start of the ring, the dynamic offsets move it
+    // the bindings are sorted like the ones of the set layout
+    std::vector<VkDescriptorAllocator::DescriptorInfo> infos(bindings.size());
+    for (size_t i = 0; i < bindings.size(); i++)
+        infos[i].buffer_m = {ringBuffer_m, 0, bindings[i].blockSize_m};
+    descriptorAllocator.write(descriptorSet_m, setLayout, infos);
+}
+
+void VkUniformManager::destroyUniformManager(VkMemoryAllocator& memoryAllocator)
+{
+    // the set goes with the pools of the descriptor allocator, the layout belongs to the layout cache
+    descriptorSet_m = VK_NULL_HANDLE;
+    memoryAllocator.destroyBuffer(ringBuffer_m, ringBufferAllocation_m);
+}
+
+void VkUniformManager::beginFrame(size_t frameIndex)
+{
+    std::lock_guard<std::mutex> lock(mutex_m);
+    regionBegin_m = regionSize_m * frameIndex;
+    head_m = regionBegin_m;
+}
+
+VkUniformManager::Allocation VkUniformManager::allocate(VkDeviceSize size)
+{
+    std::lock_guard<std::mutex> lock(mutex_m);
+    if (head_m + size > regionBegin_m + regionSize_m)
+        throw std::runtime_error("failed to allocate uniform ring space, the frame region is full!");
+    Allocation allocation;
+    allocation.mapped_m = static_cast<char*>(ringBufferAllocation_m.mapped_m) + head_m;
+    allocation.offset_m = static_cast<uint32_t>(head_m);
+    head_m += (size + alignment_m - 1) / alignment_m * alignment_m;
+    return allocation;
+}
+
+const VkDescriptorSet& VkUniformManager::getDescriptorSetRef() const
+    { return descriptorSet_m; }
+
+VkDeviceSize VkUniformManager::getUsedBytes() const
+{
+    std::lock_guard<std::mutex> lock(mutex_m);
+    return head_m - regionBegin_m;
+}
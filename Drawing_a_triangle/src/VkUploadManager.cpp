@@ -0,0 +1,339 @@
+#include <VkUploadManager.hpp>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+// staged data offsets
+constexpr VkDeviceSize RING_ALIGNMENT = 16;
+
+static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+void VkUploadManager::createUploadManager(const VkDeviceManager& deviceManager, VkMemoryAllocator& memoryAllocator,
+    VkDeviceSize ringSize, VkDeviceSize frameBudget)
+{
+    deviceManager_m = &deviceManager;
+    memoryAllocator_m = &memoryAllocator;
+    ringSize_m = alignUp(ringSize, RING_ALIGNMENT);
+    // a chunk of a frame always fits in the ring
+    frameBudget_m = std::min(std::max(frameBudget, RING_ALIGNMENT), ringSize_m);
+    const auto& device = deviceManager.getDevice();
+
+    // the ring lives as long as the manager, so it is mapped once
+    memoryAllocator.createBuffer(ringSize_m, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        VkMemoryAllocator::Lifetime::PERSISTENT, ringBuffer_m, ringAllocation_m);
+
+    auto queueFamilyIndices =
+        const_cast<VkDeviceManager&>(deviceManager).findQueueFamilies(deviceManager.getPhysicalDevice());
+    transferFamily_m = queueFamilyIndices.transferFamily_m.value();
+    graphicsFamily_m = queueFamilyIndices.graphicsFamily_m.value();
+    ownershipTransfer_m = transferFamily_m != graphicsFamily_m;
+    if (ownershipTransfer_m)
+        std::cout << "upload manager : using transfer queue family " << transferFamily_m << std::endl;
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.queueFamilyIndex = transferFamily_m;
+    // each batch resets its own command buffer when it is reused
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool_m) != VK_SUCCESS)
+        throw std::runtime_error("failed to create upload command pool!");
+    if (ownershipTransfer_m) {
+        poolInfo.queueFamilyIndex = graphicsFamily_m;
+        if (vkCreateCommandPool(device, &poolInfo, nullptr, &acquirePool_m) != VK_SUCCESS)
+            throw std::runtime_error("failed to create upload acquire command pool!");
+    }
+
+    batches_m.resize(MAX_BATCHES);
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = 1;
+    VkFenceCreateInfo fenceInfo{};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    VkSemaphoreCreateInfo semaphoreInfo{};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    for (auto& batch : batches_m) {
+        allocInfo.commandPool = commandPool_m;
+        if (vkAllocateCommandBuffers(device, &allocInfo, &batch.commandBuffer_m) != VK_SUCCESS)
+            throw std::runtime_error("failed to allocate upload command buffer!");
+        if (vkCreateFence(device, &fenceInfo, nullptr, &batch.fence_m) != VK_SUCCESS)
+            throw std::runtime_error("failed to create upload fence!");
+        if (!ownershipTransfer_m)
+            continue;
+        allocInfo.commandPool = acquirePool_m;
+        if (vkAllocateCommandBuffers(device, &allocInfo, &batch.acquireCommandBuffer_m) != VK_SUCCESS)
+            throw std::runtime_error("failed to allocate upload acquire command buffer!");
+        if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &batch.semaphore_m) != VK_SUCCESS)
+            throw std::runtime_error("failed to create upload semaphore!");
+    }
+    ringHead_m = ringTail_m = ringUsed_m = 0;
+    nextBatch_m = 0;
+}
+
+void VkUploadManager::destroyUploadManager()
+{
+    const auto& device = deviceManager_m->getDevice();
+    for (auto& batch : batches_m) {
+        if (batch.inFlight_m)
+            vkWaitForFences(device, 1, &batch.fence_m, VK_TRUE, UINT64_MAX);
+        vkDestroyFence(device, batch.fence_m, nullptr);
+        if (batch.semaphore_m != VK_NULL_HANDLE)
+            vkDestroySemaphore(device, batch.semaphore_m, nullptr);
+    }
+    batches_m.clear();
+    // destroying the pool frees its command buffers
+    vkDestroyCommandPool(device, commandPool_m, nullptr);
+    if (acquirePool_m != VK_NULL_HANDLE)
+        vkDestroyCommandPool(device, acquirePool_m, nullptr);
+    acquirePool_m = VK_NULL_HANDLE;
+    memoryAllocator_m->destroyBuffer(ringBuffer_m, ringAllocation_m);
+    if (!requests_m.empty())
+        std::cout << "upload manager : dropped " << requests_m.size() << " pending uploads" << std::endl;
+    requests_m.clear();
+}
+
+VkUploadManager::Ticket VkUploadManager::uploadBuffer(const void* data, VkDeviceSize size,
+    const VkBuffer& dstBuffer, VkDeviceSize dstOffset, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess)
+{
+    std::lock_guard<std::mutex> lock(mutex_m);
+    Request request{};
+    request.ticket_m = nextTicket_m++;
+    request.data_m = static_cast<const char*>(data);
+    request.size_m = size;
+    request.dstBuffer_m = dstBuffer;
+    request.dstOffset_m = dstOffset;
+    request.dstStage_m = dstStage;
+    request.dstAccess_m = dstAccess;
+    requests_m.push_back(request);
+    return request.ticket_m;
+}
+
+bool VkUploadManager::isUploadSubmitted(Ticket ticket) const
+{
+    std::lock_guard<std::mutex> lock(mutex_m);
+    return ticket <= submittedTicket_m;
+}
+
+bool VkUploadManager::isUploadComplete(Ticket ticket) const
+{
+    std::lock_guard<std::mutex> lock(mutex_m);
+    return ticket <= completedTicket_m;
+}
+
+void VkUploadManager::reclaimBatches()
+{
+    const auto& device = deviceManager_m->getDevice();
+    // batches finish in submission order, starting from the oldest one
+    for (size_t i = 0; i < batches_m.size(); i++) {
+        auto& batch = batches_m[(nextBatch_m + i) % batches_m.size()];
+        if (!batch.inFlight_m)
+            continue;
+        if (vkGetFenceStatus(device, batch.fence_m) != VK_SUCCESS)
+            break;
+        batch.inFlight_m = false;
+        ringTail_m = batch.ringEnd_m;
+        ringUsed_m -= batch.ringBytes_m;
+        completedTicket_m = std::max(completedTicket_m, batch.lastTicket_m);
+    }
+}
+
+bool VkUploadManager::allocateRing(VkDeviceSize size, VkDeviceSize& offset, VkDeviceSize& consumed)
+{
+    if (ringUsed_m == 0)
+        ringHead_m = ringTail_m = 0;
+    auto alignedHead = alignUp(ringHead_m, RING_ALIGNMENT);
+    if (ringUsed_m == 0 || ringHead_m > ringTail_m) {
+        // free space is [head, end) and [0, tail)
+        if (alignedHead + size <= ringSize_m)
+            offset = alignedHead;
+        else if (size <= ringTail_m)
+            offset = 0;
+        else
+            return false;
+    }
+    else {
+        // free space is [head, tail)
+        if (alignedHead + size > ringTail_m)
+            return false;
+        offset = alignedHead;
+    }
+    // the bytes skipped at the end of the ring are released with this allocation
+    consumed = offset >= ringHead_m ? offset + size - ringHead_m : ringSize_m - ringHead_m + size;
+    ringHead_m = offset + size;
+    ringUsed_m += consumed;
+    return true;
+}
+
+VkDeviceSize VkUploadManager::stageRequests(Batch& batch, VkDeviceSize budget)
+{
+    VkDeviceSize staged = 0;
+    auto mapped = static_cast<char*>(ringAllocation_m.mapped_m);
+    while (!requests_m.empty()) {
+        auto& request = requests_m.front();
+        auto remaining = request.size_m - request.stagedSize_m;
+        // nothing to copy
+        if (remaining == 0) {
+            batch.lastTicket_m = request.ticket_m;
+            requests_m.pop_front();
+            continue;
+        }
+        auto chunk = std::min(remaining, budget - staged);
+        VkDeviceSize ringOffset, consumed;
+        if (chunk == 0 || !allocateRing(chunk, ringOffset, consumed))
+            break;
+        std::memcpy(mapped + ringOffset, request.data_m + request.stagedSize_m, static_cast<size_t>(chunk));
+        recordBufferCopy(batch, request, ringOffset, chunk);
+        request.stagedSize_m += chunk;
+        batch.ringBytes_m += consumed;
+        staged += chunk;
+        if (request.stagedSize_m < request.size_m)
+            break;
+        batch.lastTicket_m = request.ticket_m;
+        requests_m.pop_front();
+    }
+    batch.ringEnd_m = ringHead_m;
+    return staged;
+}
+
+void VkUploadManager::recordBufferCopy(Batch& batch, const Request& request,
+    VkDeviceSize ringOffset, VkDeviceSize size)
+{
+    VkBufferCopy copyRegion{};
+    copyRegion.srcOffset = ringOffset;
+    copyRegion.dstOffset = request.dstOffset_m + request.stagedSize_m;
+    copyRegion.size = size;
+    vkCmdCopyBuffer(batch.commandBuffer_m, ringBuffer_m, request.dstBuffer_m, 1, &copyRegion);
+    if (request.stagedSize_m + size < request.size_m)
+        return;
+    // make the whole range visible once the last chunk has been copied
+    // the barrier also covers the chunks copied by earlier batches on the same queue
+    VkBufferMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = request.dstAccess_m;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = request.dstBuffer_m;
+    barrier.offset = request.dstOffset_m;
+    barrier.size = request.size_m;
+    if (!ownershipTransfer_m) {
+        vkCmdPipelineBarrier(batch.commandBuffer_m, VK_PIPELINE_STAGE_TRANSFER_BIT, request.dstStage_m, 0,
+            0, nullptr, 1, &barrier, 0, nullptr);
+        return;
+    }
+    // release on the transfer queue, the destination access is ignored by a release
+    barrier.dstAccessMask = 0;
+    barrier.srcQueueFamilyIndex = transferFamily_m;
+    barrier.dstQueueFamilyIndex = graphicsFamily_m;
+    vkCmdPipelineBarrier(batch.commandBuffer_m, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+    // matching acquire on the graphics queue, the source access is ignored by an acquire
+    // it starts at the stages which wait for the semaphore
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = request.dstAccess_m;
+    vkCmdPipelineBarrier(batch.acquireCommandBuffer_m, request.dstStage_m, request.dstStage_m, 0,
+        0, nullptr, 1, &barrier, 0, nullptr);
+    batch.acquireStages_m |= request.dstStage_m;
+}
+
+void VkUploadManager::beginBatch(Batch& batch)
+{
+    batch.ringBytes_m = 0;
+    batch.lastTicket_m = submittedTicket_m;
+    batch.acquireStages_m = 0;
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if (vkBeginCommandBuffer(batch.commandBuffer_m, &beginInfo) != VK_SUCCESS)
+        throw std::runtime_error("failed to begin recording upload command buffer!");
+    if (ownershipTransfer_m && vkBeginCommandBuffer(batch.acquireCommandBuffer_m, &beginInfo) != VK_SUCCESS)
+        throw std::runtime_error("failed to begin recording upload acquire command buffer!");
+}
+
+void VkUploadManager::submitBatch(Batch& batch)
+{
+    if (vkEndCommandBuffer(batch.commandBuffer_m) != VK_SUCCESS)
+        throw std::runtime_error("failed to record upload command buffer!");
+    if (ownershipTransfer_m && vkEndCommandBuffer(batch.acquireCommandBuffer_m) != VK_SUCCESS)
+        throw std::runtime_error("failed to record upload acquire command buffer!");
+    const auto& device = deviceManager_m->getDevice();
+    vkResetFences(device, 1, &batch.fence_m);
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &batch.commandBuffer_m;
+    if (!ownershipTransfer_m) {
+        // the frames submitted later on the same queue are ordered after it by the barriers
+        if (vkQueueSubmit(deviceManager_m->getGraphicsQueueRef(), 1, &submitInfo, batch.fence_m) != VK_SUCCESS)
+            throw std::runtime_error("failed to submit upload command buffer!");
+    }
+    else {
+        // the copies run on the transfer queue while the graphics queue keeps rendering
+        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pSignalSemaphores = &batch.semaphore_m;
+        if (vkQueueSubmit(deviceManager_m->getTransferQueueRef(), 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+            throw std::runtime_error("failed to submit upload command buffer!");
+        // only the stages which use the uploaded data wait for the copies,
+        // the frames submitted later on the graphics queue are ordered after the acquire barriers
+        VkSubmitInfo acquireInfo{};
+        acquireInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        acquireInfo.waitSemaphoreCount = 1;
+        acquireInfo.pWaitSemaphores = &batch.semaphore_m;
+        // a batch which only contains partial buffer chunks has nothing to acquire yet
+        VkPipelineStageFlags waitStages =
+            batch.acquireStages_m != 0 ? batch.acquireStages_m : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+        acquireInfo.pWaitDstStageMask = &waitStages;
+        acquireInfo.commandBufferCount = 1;
+        acquireInfo.pCommandBuffers = &batch.acquireCommandBuffer_m;
+        // the fence signals once the data is visible on the graphics queue,
+        // which also means that the copies, the semaphore and both command buffers are done
+        if (vkQueueSubmit(deviceManager_m->getGraphicsQueueRef(), 1, &acquireInfo, batch.fence_m) != VK_SUCCESS)
+            throw std::runtime_error("failed to submit upload acquire command buffer!");
+    }
+    batch.inFlight_m = true;
+    submittedTicket_m = batch.lastTicket_m;
+    nextBatch_m = (nextBatch_m + 1) % batches_m.size();
+}
+
+void VkUploadManager::processUploads()
+{
+    std::lock_guard<std::mutex> lock(mutex_m);
+    reclaimBatches();
+    auto& batch = batches_m[nextBatch_m];
+    // every batch is still in flight, try again next frame
+    if (requests_m.empty() || batch.inFlight_m)
+        return;
+    beginBatch(batch);
+    // zero-size requests stage nothing but are retired by submitting the batch anyway,
+    // its fence signals once everything submitted before it has finished
+    if (stageRequests(batch, frameBudget_m) == 0 && batch.lastTicket_m == submittedTicket_m) {
+        // the ring is full, nothing has been recorded
+        vkEndCommandBuffer(batch.commandBuffer_m);
+        if (ownershipTransfer_m)
+            vkEndCommandBuffer(batch.acquireCommandBuffer_m);
+        return;
+    }
+    submitBatch(batch);
+}
+
+void VkUploadManager::flush()
+{
+    const auto& device = deviceManager_m->getDevice();
+    while (true) {
+        processUploads();
+        std::lock_guard<std::mutex> lock(mutex_m);
+        if (requests_m.empty())
+            return;
+        // out of batches or ring space, wait for the oldest batch to free them
+        for (size_t i = 0; i < batches_m.size(); i++) {
+            auto& batch = batches_m[(nextBatch_m + i) % batches_m.size()];
+            if (batch.inFlight_m) {
+                vkWaitForFences(device, 1, &batch.fence_m, VK_TRUE, UINT64_MAX);
+                break;
+            }
+        }
+    }
+}
@@ -1,8 +1,11 @@
 #include <VkVertexManager.hpp>
 #include <iostream>
 #include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <chrono>
 
-void VkVertexManager::createVerticesData() 
+void VkVertexManager::createVerticesData(VertexFormat format)
 {
     vertices_m=
     {
@@ -10,167 +13,249 @@ void VkVertexManager::createVerticesData()
         {{0.5f, 0.5f},  {0.0f, 1.0f, 0.0f}},
         {{-0.5f, 0.5f},  {0.0f, 0.0f, 1.0f}}
     };
+    optimizeMesh();
+    computeBoundingSphere();
+    vertexFormat_m = VertexFormat::FLOAT;
+    dequantization_m = VertexQuantizer::Dequantization{};
+    vertexData_m = vertices_m.data();
+    vertexDataSize_m = sizeof(vertices_m[0]) * vertices_m.size();
+    if (format == VertexFormat::QUANTIZED)
+        quantizeVertices(vertices_m.data(), vertices_m.size());
+    indexData_m = indices_m.data();
+    indexDataSize_m = sizeof(indices_m[0]) * indices_m.size();
+    if (indexType_m == VK_INDEX_TYPE_UINT16) {
+        indexData_m = indices16_m.data();
+        indexDataSize_m = sizeof(indices16_m[0]) * indices16_m.size();
+    }
+    vertexCount_m = vertices_m.size();
+    indexCount_m = indices_m.size();
 };
 
-VkVertexInputBindingDescription VkVertexManager::Vertex::getBindingDescription()
+void VkVertexManager::loadMesh(const std::string& path, VertexFormat format)
+{
+    auto start = std::chrono::steady_clock::now();
+    meshFile_m.open(path);
+    const auto& header = meshFile_m.getHeader();
+    // the pipeline is built for the vertex format of the mesh
+    if (MeshVertices::matchesFileAttributes<Vertex>(meshFile_m))
+        vertexFormat_m = VertexFormat::FLOAT;
+    else if (MeshVertices::matchesFileAttributes<QuantizedVertex>(meshFile_m))
+        vertexFormat_m = VertexFormat::QUANTIZED;
+    else {
+        meshFile_m.close();
+        throw std::runtime_error("unsupported vertex layout in mesh file!");
+    }
+    vertices_m.clear();
+    indices_m.clear();
+    indices16_m.clear();
+    quantizedVertices_m.clear();
+    // only the indices have been read by the validation, the vertex pages are faulted in by the staging copies
+    vertexData_m = meshFile_m.getVertexData();
+    vertexDataSize_m = meshFile_m.getVertexDataSize();
+    indexData_m = meshFile_m.getIndexData();
+    indexDataSize_m = meshFile_m.getIndexDataSize();
+    vertexCount_m = static_cast<size_t>(header.vertexCount_m);
+    indexCount_m = static_cast<size_t>(header.indexCount_m);
+    indexType_m = header.indexSize_m == 2 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+    boundingSphere_m = glm::vec4(header.boundingSphere_m[0], header.boundingSphere_m[1],
+        header.boundingSphere_m[2], header.boundingSphere_m[3]);
+    dequantization_m.scale_m = header.positionScale_m;
+    std::copy(header.positionOffset_m, header.positionOffset_m + 3, dequantization_m.offset_m);
+    // better converted offline with obj2mesh --quantize, encoding reads the whole vertex blob
+    if (vertexFormat_m == VertexFormat::FLOAT && format == VertexFormat::QUANTIZED)
+        quantizeVertices(static_cast<const Vertex*>(vertexData_m), vertexCount_m);
+    std::cout << "mesh : mapped " << path << ", " << vertexCount_m
+        << (vertexFormat_m == VertexFormat::QUANTIZED ? " quantized" : "") << " vertices, " << indexCount_m
+        << (indexType_m == VK_INDEX_TYPE_UINT16 ? " 16" : " 32") << "-bit indices in "
+        << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count()
+        << " ms" << std::endl;
+}
+
+void VkVertexManager::quantizeVertices(const Vertex* vertices, size_t vertexCount)
+{
+    // the dequantization of the float vertices themselves is the identity
+    dequantization_m = MeshVertices::quantize(vertices, vertexCount, quantizedVertices_m);
+    boundingSphere_m = MeshVertices::quantizeBoundingSphere(boundingSphere_m, dequantization_m);
+    vertexFormat_m = VertexFormat::QUANTIZED;
+    vertexData_m = quantizedVertices_m.data();
+    vertexDataSize_m = sizeof(quantizedVertices_m[0]) * quantizedVertices_m.size();
+    std::cout << "mesh : quantized " << vertexCount << " vertices, " << sizeof(Vertex) << " -> "
+        << sizeof(QuantizedVertex) << " bytes per vertex" << std::endl;
+}
+
+void VkVertexManager::releaseVerticesData()
 {
-    VkVertexInputBindingDescription bindingDescription{};
-    // per-vertex data is packed together in one array, so the index of the 
-    // binding in the array is always 0
-    bindingDescription.binding   = 0;
-    // number of bytes from one entry to the next
-    bindingDescription.stride    = sizeof(Vertex);
-    bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-    return bindingDescription;
+    meshFile_m.close();
+    vertices_m.clear();
+    vertices_m.shrink_to_fit();
+    indices_m.clear();
+    indices_m.shrink_to_fit();
+    indices16_m.clear();
+    indices16_m.shrink_to_fit();
+    quantizedVertices_m.clear();
+    quantizedVertices_m.shrink_to_fit();
+    vertexData_m = nullptr;
+    indexData_m = nullptr;
 }
 
-std::array<VkVertexInputAttributeDescription, 2> 
-    VkVertexManager::Vertex::getAttributeDescriptions()
+void VkVertexManager::optimizeMesh()
 {
-    // how to extract a vertex attribute from a chunk of vertex data
-    std::array<VkVertexInputAttributeDescription,2> attributeDescriptions{};
-    attributeDescriptions[0].binding = 0;
-    // the location directive of the input in the vertex shader.
-    attributeDescriptions[0].location = 0;
-    // same enumeration as color formats
-    // 2-component vector of 32-bit float
-    attributeDescriptions[0].format = VK_FORMAT_R32G32_SFLOAT;
-    // the offset parameter specifies the number of bytes since the start of the per-vertex data to read from
-    // the binding loads one Vertex at a time and the position attribute is at an offset of 0 bytes
-    // Vertex::glm::vec2 position_m
-    attributeDescriptions[0].offset = offsetof(Vertex, position_m);
-
-    attributeDescriptions[1].binding = 0;
-    attributeDescriptions[1].location = 1;
-    attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-    attributeDescriptions[1].offset = offsetof(Vertex, color_m);
-    return attributeDescriptions;
+    auto statistics = MeshVertices::optimize(vertices_m, indices_m);
+    auto vertexCount = vertices_m.size();
+
+    // 0xFFFF is kept free, it restarts primitives when primitive restart is enabled
+    indexType_m = vertexCount < UINT16_MAX ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+    indices16_m.clear();
+    if (indexType_m == VK_INDEX_TYPE_UINT16)
+        indices16_m.assign(indices_m.begin(), indices_m.end());
+    std::cout << "mesh : " << statistics.inputVertexCount_m << " -> " << vertexCount << " vertices, "
+        << indices_m.size() << (indexType_m == VK_INDEX_TYPE_UINT16 ? " 16" : " 32") << "-bit indices, ACMR "
+        << statistics.acmrBefore_m << " -> " << statistics.acmrAfter_m << std::endl;
+}
+
+// the locations read by shader.vert
+static_assert(VkVertexManager::FloatVertexInput::getAttributeDescriptions()[2].location == 2
+    && VkVertexManager::FloatVertexInput::getAttributeDescriptions()[6].location == 6,
+    "the instance attributes must follow the two vertex attributes");
+static_assert(VkVertexManager::FloatVertexInput::ATTRIBUTE_COUNT
+    == VkVertexManager::QuantizedVertexInput::ATTRIBUTE_COUNT,
+    "both vertex formats must feed the same shader inputs");
+
+// the descriptions are constants, only the choice between them is made at run time
+std::vector<VkVertexInputBindingDescription> VkVertexManager::getBindingDescriptions() const
+{
+    if (vertexFormat_m == VertexFormat::QUANTIZED) {
+        constexpr auto bindingDescriptions = QuantizedVertexInput::getBindingDescriptions();
+        return {bindingDescriptions.begin(), bindingDescriptions.end()};
+    }
+    constexpr auto bindingDescriptions = FloatVertexInput::getBindingDescriptions();
+    return {bindingDescriptions.begin(), bindingDescriptions.end()};
 }
 
-uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties, 
-    const VkPhysicalDevice& physicalDevice)
+std::vector<VkVertexInputAttributeDescription> VkVertexManager::getAttributeDescriptions() const
 {
-    // available types of memory
-    VkPhysicalDeviceMemoryProperties memProperties;
-    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
-    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
-        // check if the result of the bitwise AND is not just non-zero, 
-        // but equal to the desired properties bit field
-        if (typeFilter & (i << i) && 
-            (memProperties.memoryTypes[i].propertyFlags & properties) == properties) 
-            return i;
+    if (vertexFormat_m == VertexFormat::QUANTIZED) {
+        constexpr auto attributeDescriptions = QuantizedVertexInput::getAttributeDescriptions();
+        return {attributeDescriptions.begin(), attributeDescriptions.end()};
     }
-    throw std::runtime_error("failed to find suitable memory type!");
+    constexpr auto attributeDescriptions = FloatVertexInput::getAttributeDescriptions();
+    return {attributeDescriptions.begin(), attributeDescriptions.end()};
 }
 
-void VkVertexManager::createBuffer(const VkDevice& device, const VkPhysicalDevice& physicalDevice, VkDeviceSize size, 
-    VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory)
+VkVertexManager::VertexFormat VkVertexManager::getVertexFormat() const
+    { return vertexFormat_m; }
+
+glm::mat4 VkVertexManager::getDequantizationMatrix() const
 {
-    // buffer creation
-    VkBufferCreateInfo bufferInfo{};
-    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    bufferInfo.size = size;
-    bufferInfo.usage = usage;
-    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    if(vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS)
-        throw std::runtime_error("failed to create buffer!");
-    // memory allocation
-    VkMemoryRequirements memRequirements;
-    vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = 
-        findMemoryType(memRequirements.memoryTypeBits, properties, physicalDevice);
-    if(vkAllocateMemory(device, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS)
-        throw std::runtime_error("failed to allocate buffer memory!");
-    // associate the memory with the buffer
-    vkBindBufferMemory(device, buffer, bufferMemory, 0);
+    // column major, uniform scale followed by the translation
+    glm::mat4 dequantization(1.0f);
+    dequantization[0] = glm::vec4(dequantization_m.scale_m, 0.0f, 0.0f, 0.0f);
+    dequantization[1] = glm::vec4(0.0f, dequantization_m.scale_m, 0.0f, 0.0f);
+    dequantization[2] = glm::vec4(0.0f, 0.0f, dequantization_m.scale_m, 0.0f);
+    dequantization[3] = glm::vec4(dequantization_m.offset_m[0], dequantization_m.offset_m[1],
+        dequantization_m.offset_m[2], 1.0f);
+    return dequantization;
 }
 
-void VkVertexManager::createVertexBuffer
-    (const VkDeviceManager& deviceManager, VkCommandPool& commandPool)
+void VkVertexManager::createVertexBuffer(VkMemoryAllocator& memoryAllocator, VkUploadManager& uploadManager)
 {
-    auto& device = deviceManager.getDevice();
-    auto& physicalDevice = deviceManager.getPhysicalDevice();
-    auto& graphicsQueue = deviceManager.getGraphicsQueueRef();
-    // use a host visible buffer as temporary buffer, use a device local buffer as actual vertex buffer
-    VkDeviceSize bufferSize = sizeof(vertices_m[0]) * vertices_m.size();
-    // temporary buffer
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    createBuffer(device, physicalDevice, bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
-    // filling in the data
-    void* data;
-    vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-    memcpy(data, vertices_m.data(), static_cast<size_t>(bufferSize));
-    vkUnmapMemory(device, stagingBufferMemory);
-
-    createBuffer(device, physicalDevice, bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, vertexBuffer_m, vertexBufferMemory_m);
-    // copy the vertex data to the buffer
-    copyBuffer(device, commandPool, graphicsQueue, stagingBuffer, vertexBuffer_m, bufferSize);
-
-    vkDestroyBuffer(device, stagingBuffer, nullptr);
-    vkFreeMemory(device, stagingBufferMemory, nullptr);
+    // device local memory is not host visible, the data goes through the staging ring
+    memoryAllocator.createBuffer(vertexDataSize_m, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VkMemoryAllocator::Lifetime::PERSISTENT,
+        vertexBuffer_m, vertexBufferAllocation_m);
+    uploadManager.uploadBuffer(vertexData_m, vertexDataSize_m, vertexBuffer_m, 0,
+        VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+    memoryAllocator.createBuffer(indexDataSize_m, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VkMemoryAllocator::Lifetime::PERSISTENT,
+        indexBuffer_m, indexBufferAllocation_m);
+    uploadManager.uploadBuffer(indexData_m, indexDataSize_m, indexBuffer_m, 0,
+        VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT);
 }
 
-void VkVertexManager::fillVertexBuffer(const VkDevice& device)
+void VkVertexManager::destroyVertexBuffer(VkMemoryAllocator& memoryAllocator)
 {
-    // handle of the memory
-    void* data;
-    vkMapMemory(device, vertexBufferMemory_m, 0, sizeof(vertices_m[0]) * vertices_m.size(), 0, &data);
-    std::memcpy(data, vertices_m.data(), sizeof(vertices_m[0]) * vertices_m.size());
-    vkUnmapMemory(device, vertexBufferMemory_m);
+    memoryAllocator.destroyBuffer(indexBuffer_m, indexBufferAllocation_m);
+    memoryAllocator.destroyBuffer(vertexBuffer_m, vertexBufferAllocation_m);
 }
 
-void VkVertexManager::copyBuffer(const VkDevice& device, VkCommandPool& commandPool, const VkQueue& graphicsQueue,
-    VkBuffer& srcBuffer, VkBuffer& dstBuffer, VkDeviceSize size)
+void VkVertexManager::createInstanceBuffer(VkMemoryAllocator& memoryAllocator, size_t maxInstanceCount,
+    size_t framesInFlight)
 {
-    // command buffer for memory transfer operations
-    VkCommandBufferAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    allocInfo.commandPool = commandPool;
-    allocInfo.commandBufferCount = 1;
-
-    VkCommandBuffer commandBuffer;
-    vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer);
-    // record the command buffer
-    VkCommandBufferBeginInfo beginInfo{};
-    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-    vkBeginCommandBuffer(commandBuffer, &beginInfo);
-
-    VkBufferCopy copyRegion{};
-    copyRegion.srcOffset = 0; // optional
-    copyRegion.dstOffset = 0; // optional
-    copyRegion.size = size;
-    // transfer the contents of buffers
-    vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
-    // end recording
-    vkEndCommandBuffer(commandBuffer);
-    // execute the commnad buffer to complete the transfer
-    VkSubmitInfo submitInfo{};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &commandBuffer;
-
-    vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-    vkQueueWaitIdle(graphicsQueue);
-    vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
+    maxInstanceCount_m = maxInstanceCount;
+    VkDeviceSize bufferSize = sizeof(Instance) * maxInstanceCount * framesInFlight;
+    // the culling shader reads the model matrices as a storage buffer
+    VkBufferUsageFlags usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    // device local memory the host can write (integrated GPUs, resizable BAR) is written in place
+    try {
+        memoryAllocator.createBuffer(bufferSize, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT |
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            VkMemoryAllocator::Lifetime::PERSISTENT, instanceBuffer_m, instanceBufferAllocation_m);
+        if (instanceBufferAllocation_m.mapped_m != nullptr)
+            return;
+        memoryAllocator.destroyBuffer(instanceBuffer_m, instanceBufferAllocation_m);
+    } catch (const std::runtime_error&) {
+    }
+    // otherwise the vertex stage would read host memory every frame,
+    // so the instances are copied to device local memory through the staging ring
+    memoryAllocator.createBuffer(bufferSize, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VkMemoryAllocator::Lifetime::PERSISTENT,
+        instanceBuffer_m, instanceBufferAllocation_m);
+    std::cout << "instance buffer : device local, written through the staging ring" << std::endl;
 }
 
+void VkVertexManager::destroyInstanceBuffer(VkMemoryAllocator& memoryAllocator)
+{
+    memoryAllocator.destroyBuffer(instanceBuffer_m, instanceBufferAllocation_m);
+}
 
-void VkVertexManager::destroyVertexBuffer(const VkDevice& device)
+void VkVertexManager::updateInstances(VkUploadManager& uploadManager, size_t frameIndex,
+    const std::vector<Instance>& instances)
 {
-    vkDestroyBuffer(device, vertexBuffer_m, nullptr);
-    vkFreeMemory(device, vertexBufferMemory_m, nullptr);
+    if (instances.size() > maxInstanceCount_m)
+        throw std::runtime_error("too many instances for the instance buffer!");
+    auto size = sizeof(Instance) * instances.size();
+    if (instanceBufferAllocation_m.mapped_m != nullptr) {
+        // host coherent, the writes are visible to the frame submitted afterwards
+        std::memcpy(static_cast<char*>(instanceBufferAllocation_m.mapped_m) + getInstanceBufferOffset(frameIndex),
+            instances.data(), size);
+        return;
+    }
+    // read as vertex attributes, and as a storage buffer by the culling shader
+    auto ticket = uploadManager.uploadBuffer(instances.data(), size, instanceBuffer_m,
+        getInstanceBufferOffset(frameIndex),
+        VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_SHADER_READ_BIT);
+    // the frame being recorded reads them, they cannot wait for the budget of a later frame
+    uploadManager.processUploads();
+    if (!uploadManager.isUploadSubmitted(ticket))
+        uploadManager.flush();
 }
 
 VkBuffer& VkVertexManager::getVertexBufferRef()
     { return vertexBuffer_m; }
 
+VkBuffer& VkVertexManager::getIndexBufferRef()
+    { return indexBuffer_m; }
+
+VkBuffer& VkVertexManager::getInstanceBufferRef()
+    { return instanceBuffer_m; }
+
+VkDeviceSize VkVertexManager::getInstanceBufferOffset(size_t frameIndex) const
+    { return sizeof(Instance) * maxInstanceCount_m * frameIndex; }
+
+VkIndexType VkVertexManager::getIndexType() const
+    { return indexType_m; }
+
+size_t VkVertexManager::getIndicesSize()
+    { return indexCount_m; }
+
+void VkVertexManager::computeBoundingSphere()
+{
+    boundingSphere_m = MeshVertices::computeBoundingSphere(vertices_m);
+}
+
+glm::vec4 VkVertexManager::getBoundingSphere() const
+    { return boundingSphere_m; }
+
 size_t VkVertexManager::getVerticesSize()
-    { return vertices_m.size(); }
\ No newline at end of file
+    { return vertexCount_m; }
\ No newline at end of file
@@ -1,11 +1,117 @@
 #include "Application.hpp"
 #include <iostream>
+#include <string>
+#include <algorithm>
+#include <cstdlib>
+#include <stdexcept>
 
-int main()
+// --headless : render offscreen without a window
+// --frames N : number of frames to render in headless mode
+// --warmup N : number of frames rendered before measuring in headless mode
+// --baseline PATH : fail if the headless results regressed against this file
+// --threshold X : allowed regression against the baseline (0.1 = 10%)
+// --bench-output PATH : write the headless results, usable as a baseline
+// --block-size N : size of device memory blocks in MiB
+// --staging-size N : size of the staging ring in MiB
+// --upload-budget N : bytes uploaded per frame at most in KiB
+// --pipeline-cache PATH : pipeline cache file
+// --no-pipeline-cache : neither load nor save the pipeline cache
+// --threads N : number of threads recording command buffers
+// --draws N : number of draw calls per frame
+// --mesh PATH : draw a mesh file converted with tools/obj2mesh instead of the triangle
+// --quantize : store the vertices with 16-bit positions and 8-bit colors
+// --instances N : number of instances of the mesh
+// --gpu-culling : cull the instances on the GPU and draw them with indirect draws, without the depth sort
+// --blend NAME : opaque, alpha or additive, opaque by default, only opaque draws are sorted front to back
+// --watch-shaders : recompile src/shader when a file changes and reload the pipelines
+// --glslc PATH : shader compiler used by --watch-shaders, $GLSLC or glslc by default
+// --profile-csv PATH : write per frame CPU and GPU times on exit
+// --present-profile NAME : balanced, low-latency, throughput or vsync-relaxed
+Application::Settings parseSettings(int argc, char* argv[])
 {
-    auto app = std::make_unique<Application>();
+    Application::Settings settings;
+    // same variable as compile.sh
+    if (const char* compilerPath = std::getenv("GLSLC"))
+        settings.shaderCompilerPath_m = compilerPath;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        // std::stoul and the like throw without naming the option
+        try {
+            if (arg == "--headless")
+                settings.headless_m = true;
+            else if (arg == "--frames" && i + 1 < argc)
+                settings.frameCount_m = static_cast<uint32_t>(std::stoul(argv[++i]));
+            else if (arg == "--warmup" && i + 1 < argc)
+                settings.warmupFrameCount_m = static_cast<uint32_t>(std::stoul(argv[++i]));
+            else if (arg == "--baseline" && i + 1 < argc)
+                settings.baselinePath_m = argv[++i];
+            else if (arg == "--threshold" && i + 1 < argc)
+                settings.regressionThreshold_m = std::stod(argv[++i]);
+            else if (arg == "--bench-output" && i + 1 < argc)
+                settings.benchOutputPath_m = argv[++i];
+            else if (arg == "--block-size" && i + 1 < argc)
+                settings.memoryBlockSize_m = std::stoull(argv[++i]) * 1024 * 1024;
+            else if (arg == "--staging-size" && i + 1 < argc)
+                settings.stagingRingSize_m = std::stoull(argv[++i]) * 1024 * 1024;
+            else if (arg == "--upload-budget" && i + 1 < argc)
+                settings.uploadBudget_m = std::stoull(argv[++i]) * 1024;
+            else if (arg == "--pipeline-cache" && i + 1 < argc)
+                settings.pipelineCachePath_m = argv[++i];
+            else if (arg == "--no-pipeline-cache")
+                settings.pipelineCachePath_m.clear();
+            else if (arg == "--threads" && i + 1 < argc)
+                settings.recordThreadCount_m = std::max(1u, static_cast<uint32_t>(std::stoul(argv[++i])));
+            else if (arg == "--draws" && i + 1 < argc)
+                settings.drawCount_m = static_cast<uint32_t>(std::stoul(argv[++i]));
+            else if (arg == "--mesh" && i + 1 < argc)
+                settings.meshPath_m = argv[++i];
+            else if (arg == "--quantize")
+                settings.quantizeVertices_m = true;
+            else if (arg == "--instances" && i + 1 < argc)
+                settings.instanceCount_m = static_cast<uint32_t>(std::stoul(argv[++i]));
+            else if (arg == "--gpu-culling")
+                settings.gpuCulling_m = true;
+            else if (arg == "--blend" && i + 1 < argc) {
+                using BlendMode = VkGraphicsPipelineFactory::BlendMode;
+                std::string name = argv[++i];
+                if (name == "opaque")
+                    settings.blendMode_m = BlendMode::OPAQUE;
+                else if (name == "alpha")
+                    settings.blendMode_m = BlendMode::ALPHA;
+                else if (name == "additive")
+                    settings.blendMode_m = BlendMode::ADDITIVE;
+                else
+                    throw std::invalid_argument(name);
+            }
+            else if (arg == "--watch-shaders")
+                settings.watchShaders_m = true;
+            else if (arg == "--glslc" && i + 1 < argc)
+                settings.shaderCompilerPath_m = argv[++i];
+            else if (arg == "--profile-csv" && i + 1 < argc)
+                settings.profileCsvPath_m = argv[++i];
+            else if (arg == "--present-profile" && i + 1 < argc) {
+                // an unknown name keeps the default like an unknown option
+                try {
+                    settings.presentProfile_m = VkPresentProfile::findProfile(argv[++i]);
+                } catch (const std::exception& e) {
+                    std::cerr << e.what() << std::endl;
+                }
+            }
+            else
+                std::cerr << "unknown option : " << arg << std::endl;
+        } catch (const std::invalid_argument&) {
+            throw std::runtime_error("invalid value for " + arg);
+        } catch (const std::out_of_range&) {
+            throw std::runtime_error("invalid value for " + arg);
+        }
+    }
+    return settings;
+}
 
+int main(int argc, char* argv[])
+{
     try {
+        auto app = std::make_unique<Application>(parseSettings(argc, argv));
         app->run();
     } catch (const std::exception& e) {
         std::cerr << e.what() << std::endl;
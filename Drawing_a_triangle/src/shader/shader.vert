@@ -5,11 +5,33 @@
 
 layout(location = 0) in vec2 inPosition;
 layout(location = 1) in vec3 inColor;
+// per-instance attributes, a mat4 takes the locations 2 to 5
+layout(location = 2) in mat4 inModel;
+layout(location = 6) in vec4 inInstanceColor;
 
 layout(location = 0) out vec3 fragColor;
 
+// per-frame camera, read from the uniform ring at the dynamic offset of the frame
+layout(set = 0, binding = 0) uniform Camera
+{
+    mat4 viewProjection;
+};
+
+// per-draw data, pushed before each draw call
+// compiled with DRAW_DATA_UNIFORM for the devices whose push constants cannot hold it,
+// it is then read from the uniform ring at the dynamic offset of the draw
+#ifdef DRAW_DATA_UNIFORM
+layout(set = 1, binding = 0) uniform DrawData
+#else
+layout(push_constant) uniform DrawData
+#endif
+{
+    mat4 transform;
+    vec4 tint;
+} draw;
+
 void main()
 {
-    gl_Position = vec4(inPosition, 0.0, 1.0);
-    fragColor = inColor;
-}
\ No newline at end of file
+    gl_Position = viewProjection * draw.transform * inModel * vec4(inPosition, 0.0, 1.0);
+    fragColor = inColor * inInstanceColor.rgb * draw.tint.rgb;
+}
@@ -0,0 +1,133 @@
+// offline converter from Wavefront OBJ to the mesh file format of MeshFile
+// usage : obj2mesh [--quantize] input.obj output.mesh
+// the vertices are written as MeshVertex (position xy, color rgb) or as QuantizedMeshVertex
+// with --quantize, the formats and their processing are the ones of the renderer, see MeshVertices.hpp
+// positions are projected on the xy plane, colors come from the "v x y z r g b" extension
+// and default to white, polygons are triangulated as fans
+// the mesh is welded and reordered with MeshOptimizer, so loading it does no processing
+#include <MeshFile.hpp>
+#include <MeshVertices.hpp>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct ObjPosition
+{
+    float position_m[3];
+    float color_m[3];
+};
+
+// 1-based or negative index of the position of a "v/vt/vn" face token
+static size_t parsePositionIndex(const std::string& token, size_t positionCount)
+{
+    auto value = std::stol(token.substr(0, token.find('/')));
+    auto index = value < 0 ? static_cast<long>(positionCount) + value : value - 1;
+    if (index < 0 || static_cast<size_t>(index) >= positionCount)
+        throw std::runtime_error("invalid face index in obj file!");
+    return static_cast<size_t>(index);
+}
+
+// unindexed triangle list
+static std::vector<MeshVertex> readObj(const std::string& path)
+{
+    std::ifstream file(path);
+    if (!file.is_open())
+        throw std::runtime_error("failed to open obj file!");
+    std::vector<ObjPosition> positions;
+    std::vector<MeshVertex> vertices;
+    std::string line;
+    std::vector<size_t> polygon;
+    while (std::getline(file, line)) {
+        std::istringstream stream(line);
+        std::string keyword;
+        stream >> keyword;
+        if (keyword == "v") {
+            ObjPosition position{{0.0f, 0.0f, 0.0f}, {1.0f, 1.0f, 1.0f}};
+            stream >> position.position_m[0] >> position.position_m[1] >> position.position_m[2];
+            float r, g, b;
+            if (stream >> r >> g >> b) {
+                position.color_m[0] = r;
+                position.color_m[1] = g;
+                position.color_m[2] = b;
+            }
+            positions.push_back(position);
+        }
+        else if (keyword == "f") {
+            polygon.clear();
+            std::string token;
+            while (stream >> token)
+                polygon.push_back(parsePositionIndex(token, positions.size()));
+            for (size_t i = 1; i + 1 < polygon.size(); i++) {
+                for (auto index : {polygon[0], polygon[i], polygon[i + 1]}) {
+                    const auto& position = positions[index];
+                    vertices.push_back(MeshVertex{{position.position_m[0], position.position_m[1]},
+                        {position.color_m[0], position.color_m[1], position.color_m[2]}});
+                }
+            }
+        }
+        // normals, texture coordinates, groups and materials are not used by the renderer
+    }
+    return vertices;
+}
+
+int main(int argc, char* argv[])
+{
+    bool quantize = argc == 4 && std::string(argv[1]) == "--quantize";
+    if (argc != 3 && !quantize) {
+        std::cerr << "usage : " << argv[0] << " [--quantize] input.obj output.mesh" << std::endl;
+        return EXIT_FAILURE;
+    }
+    const char* inputPath = argv[argc - 2];
+    const char* outputPath = argv[argc - 1];
+    try {
+        auto start = std::chrono::steady_clock::now();
+        auto vertices = readObj(inputPath);
+        if (vertices.empty())
+            throw std::runtime_error("no triangles in obj file!");
+        auto triangleCount = vertices.size() / 3;
+
+        // the same processing as VkVertexManager::optimizeMesh
+        std::vector<uint32_t> indices;
+        auto statistics = MeshVertices::optimize(vertices, indices);
+        auto vertexCount = vertices.size();
+
+        auto attributes = MeshVertices::getFileAttributes<MeshVertex>();
+        auto boundingSphere = MeshVertices::computeBoundingSphere(vertices);
+        const void* vertexData = vertices.data();
+        uint32_t vertexStride = sizeof(MeshVertex);
+        VertexQuantizer::Dequantization dequantization;
+        std::vector<QuantizedMeshVertex> quantizedVertices;
+        if (quantize) {
+            // the same encoding as VkVertexManager::quantizeVertices
+            dequantization = MeshVertices::quantize(vertices.data(), vertices.size(), quantizedVertices);
+            attributes = MeshVertices::getFileAttributes<QuantizedMeshVertex>();
+            // the bounding sphere is stored in the space of the quantized positions
+            boundingSphere = MeshVertices::quantizeBoundingSphere(boundingSphere, dequantization);
+            vertexData = quantizedVertices.data();
+            vertexStride = sizeof(QuantizedMeshVertex);
+        }
+        // 0xFFFF is kept free for primitive restart
+        if (vertexCount < UINT16_MAX) {
+            std::vector<uint16_t> indices16(indices.begin(), indices.end());
+            MeshFile::write(outputPath, vertexStride, attributes, vertexData, vertices.size(),
+                indices16.data(), indices16.size(), sizeof(uint16_t), &boundingSphere[0],
+                dequantization.scale_m, dequantization.offset_m);
+        }
+        else
+            MeshFile::write(outputPath, vertexStride, attributes, vertexData, vertices.size(),
+                indices.data(), indices.size(), sizeof(uint32_t), &boundingSphere[0],
+                dequantization.scale_m, dequantization.offset_m);
+        std::cout << outputPath << " : " << triangleCount << " triangles, " << vertexCount
+            << " vertices, ACMR " << statistics.acmrBefore_m << " -> " << statistics.acmrAfter_m
+            << ", " << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count()
+            << " s" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}